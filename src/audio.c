@@ -6,352 +6,611 @@
 #include <gtk/gtk.h>
 #include <gdk-pixbuf/gdk-pixbuf.h>
 
-#ifdef __APPLE__
-#include <AudioToolbox/AudioToolbox.h>
-#else
-#include <pulse/simple.h>
-#include <pulse/error.h>
-#endif
-
 #include "audio.h"
 #include "effects.h"
+#include "playback.h"
 #include "visualizer_types.h"
+#include "sample_convert.h"
+#include "mixer.h"
+#include "effect_chain.h"
+#include "history.h"
+#include "rng.h"
+#include "oscillator.h"
 
-// Platform-specific audio callback/stream handling
-#ifdef __APPLE__
-static OSStatus playbackCallback(void *inRefCon, 
-                               AudioUnitRenderActionFlags *ioActionFlags,
-                               const AudioTimeStamp *inTimeStamp,
-                               UInt32 inBusNumber,
-                               UInt32 inNumberFrames,
-                               AudioBufferList *ioData) {
-    // Mark unused parameters to silence warnings
-    (void)ioActionFlags;
-    (void)inTimeStamp;
-    (void)inBusNumber;
-    
-    AudioPlayer *player = (AudioPlayer *)inRefCon;
-    if (!player || !player->active_mix) {
-        // Fill with silence if no audio
-        for (UInt32 i = 0; i < ioData->mNumberBuffers; i++) {
-            memset(ioData->mBuffers[i].mData, 0, ioData->mBuffers[i].mDataByteSize);
+// Frames converted per pass when streaming through a scratch buffer
+#define CONVERT_CHUNK 1024
+
+// Every chunk carries a min/max/sum-of-squares pyramid over its samples for
+// drawing: PEAK_BLOCK frames per entry at the bottom, PEAK_FANOUT entries
+// per entry above, up to one entry for the whole chunk. It is built on first
+// use and dropped whenever the chunk is written, and clones share it along
+// with the samples, so after an effect only the chunks it touched are
+// scanned again.
+#define PEAK_BLOCK 64
+#define PEAK_FANOUT 4
+#define PEAK_LEVELS 5           // 64, 256, 1024, 4096 and 16384 frames an entry
+#define PEAK_ENTRIES (256 + 64 + 16 + 4 + 1)
+
+typedef struct {
+    float min;
+    float max;
+    float sum_squares;
+} PeakEntry;
+
+// A chunk header shares its allocation with the samples, which start on
+// the next cache line and are followed by the pyramid
+struct AudioChunk {
+    float* samples;
+    PeakEntry* peaks;           // Level by level, finest first
+    gint refcount;
+    gint peak_frames;           // Frames the pyramid covers; 0 until built
+};
+
+// Above the chunks each channel has a pyramid of its own: one entry per
+// chunk, PEAK_FANOUT entries per entry above. A span covering many chunks
+// then costs a few entries per level instead of a visit to every chunk's
+// pyramid. It belongs to one AudioData, is built on first use and is
+// rebuilt whole after any write, which only re-scans the chunks written.
+#define PEAK_INDEX_LEVELS 32    // Enough for any chunk_count
+
+typedef struct {
+    float min;
+    float max;
+    double sum_squares;         // An entry can cover hours
+} IndexEntry;
+
+struct AudioPeakIndex {
+    gint generation;            // AudioData.peak_generation it was built at
+    int levels;
+    size_t offset[PEAK_INDEX_LEVELS];   // Where each level starts in a channel
+    size_t stride;              // Entries per channel
+    IndexEntry entries[];
+};
+
+#define CHUNK_HEADER AUDIO_PLANE_ALIGN
+// aligned_alloc wants a whole number of alignments
+#define CHUNK_PEAK_BYTES ((PEAK_ENTRIES * sizeof(PeakEntry) + AUDIO_PLANE_ALIGN - 1) & ~(size_t)(AUDIO_PLANE_ALIGN - 1))
+
+static AudioChunk* chunk_new(void) {
+    AudioChunk* chunk = aligned_alloc(AUDIO_PLANE_ALIGN, CHUNK_HEADER + AUDIO_CHUNK_FRAMES * sizeof(float) +
+                                      CHUNK_PEAK_BYTES);
+    if (!chunk) return NULL;
+    chunk->samples = (float*)((uint8_t*)chunk + CHUNK_HEADER);
+    chunk->peaks = (PeakEntry*)(chunk->samples + AUDIO_CHUNK_FRAMES);
+    chunk->refcount = 1;
+    chunk->peak_frames = 0;
+    return chunk;
+}
+
+static void chunk_unref(AudioChunk* chunk) {
+    if (chunk && g_atomic_int_dec_and_test(&chunk->refcount)) {
+        free(chunk);
+    }
+}
+
+static AudioChunk** chunk_slot(const AudioData* audio, uint16_t channel, size_t index) {
+    return &audio->chunks[(size_t)channel * audio->chunk_count + index];
+}
+
+AudioData* audio_data_new(uint32_t sample_rate, uint16_t channels, size_t frames) {
+    if (channels == 0 || channels > AUDIO_MAX_CHANNELS) return NULL;
+
+    AudioData* audio = calloc(1, sizeof(AudioData));
+    if (!audio) return NULL;
+
+    audio->sample_rate = sample_rate;
+    audio->channels = channels;
+    audio->bits_per_sample = 32;
+    audio->mix_volume = 1.0f;
+    audio->frames = frames;
+    audio->chunk_count = MAX((frames + AUDIO_CHUNK_FRAMES - 1) / AUDIO_CHUNK_FRAMES, 1);
+    audio->chunks = calloc(channels * audio->chunk_count, sizeof(AudioChunk*));
+    if (!audio->chunks) {
+        free(audio);
+        return NULL;
+    }
+
+    for (size_t i = 0; i < channels * audio->chunk_count; i++) {
+        audio->chunks[i] = chunk_new();
+        if (!audio->chunks[i]) {
+            free_audio_data(audio);
+            return NULL;
         }
-        return noErr;
+        memset(audio->chunks[i]->samples, 0, AUDIO_CHUNK_FRAMES * sizeof(float));
     }
 
-    float *buffer = (float *)ioData->mBuffers[0].mData;
-    size_t channels = player->active_mix->channels;
-    
-    // Fill the output buffer
-    for (UInt32 frame = 0; frame < inNumberFrames; frame++) {
-        for (size_t channel = 0; channel < channels; channel++) {
-            int16_t sample = player->active_mix->buffer[player->ring_buffer_pos * channels + channel];
-            buffer[frame * channels + channel] = sample / 32768.0f;
+    return audio;
+}
+
+size_t audio_data_chunk_frames(const AudioData* audio, size_t index) {
+    size_t first = index * AUDIO_CHUNK_FRAMES;
+    if (first >= audio->frames) return 0;
+    return MIN(AUDIO_CHUNK_FRAMES, audio->frames - first);
+}
+
+const float* audio_data_chunk(const AudioData* audio, uint16_t channel, size_t index) {
+    return (*chunk_slot(audio, channel, index))->samples;
+}
+
+// Copy on write: a chunk still shared with a snapshot is duplicated first.
+// Only the UI thread takes or drops references, so the count is exact here.
+float* audio_data_chunk_mut(AudioData* audio, uint16_t channel, size_t index) {
+    AudioChunk** slot = chunk_slot(audio, channel, index);
+    AudioChunk* chunk = *slot;
+    if (g_atomic_int_get(&chunk->refcount) > 1) {
+        AudioChunk* copy = chunk_new();
+        if (!copy) return NULL;
+        memcpy(copy->samples, chunk->samples, AUDIO_CHUNK_FRAMES * sizeof(float));
+        *slot = copy;
+        chunk_unref(chunk);
+        chunk = copy;
+    }
+    // The caller is about to write
+    g_atomic_int_set(&chunk->peak_frames, 0);
+    g_atomic_int_inc(&audio->peak_generation);
+    return chunk->samples;
+}
+
+gboolean audio_data_shares_channel(const AudioData* a, const AudioData* b, uint16_t channel) {
+    if (!a || !b || !a->chunks || !b->chunks || a->frames != b->frames || a->chunk_count != b->chunk_count ||
+        channel >= a->channels || channel >= b->channels) {
+        return FALSE;
+    }
+    for (size_t i = 0; i < a->chunk_count; i++) {
+        if (*chunk_slot(a, channel, i) != *chunk_slot(b, channel, i)) return FALSE;
+    }
+    return TRUE;
+}
+
+float audio_data_sample(const AudioData* audio, uint16_t channel, size_t frame) {
+    return audio_data_chunk(audio, channel, frame / AUDIO_CHUNK_FRAMES)[frame % AUDIO_CHUNK_FRAMES];
+}
+
+static size_t peak_level_size(int level) {
+    return AUDIO_CHUNK_FRAMES / PEAK_BLOCK >> (2 * level);
+}
+
+static PeakEntry* peak_level(AudioChunk* chunk, int level) {
+    PeakEntry* entries = chunk->peaks;
+    for (int l = 0; l < level; l++) {
+        entries += peak_level_size(l);
+    }
+    return entries;
+}
+
+static void peak_add(PeakEntry* acc, const PeakEntry* entry) {
+    acc->min = MIN(acc->min, entry->min);
+    acc->max = MAX(acc->max, entry->max);
+    acc->sum_squares += entry->sum_squares;
+}
+
+static const PeakEntry empty_peak = { INFINITY, -INFINITY, 0.0f };
+
+// Only the first `frames` samples count; entries past them stay empty
+static void build_peaks(AudioChunk* chunk, size_t frames) {
+    PeakEntry* level = peak_level(chunk, 0);
+    for (size_t i = 0; i < peak_level_size(0); i++) {
+        PeakEntry entry = empty_peak;
+        size_t first = i * PEAK_BLOCK;
+        size_t end = MIN(first + PEAK_BLOCK, frames);
+        for (size_t j = first; j < end; j++) {
+            float sample = chunk->samples[j];
+            entry.min = MIN(entry.min, sample);
+            entry.max = MAX(entry.max, sample);
+            entry.sum_squares += sample * sample;
         }
-        
-        player->ring_buffer_pos++;
-        if (player->ring_buffer_pos >= player->active_mix->buffer_size / (channels * sizeof(int16_t))) {
-            player->ring_buffer_pos = 0;
+        level[i] = entry;
+    }
+
+    for (int l = 1; l < PEAK_LEVELS; l++) {
+        const PeakEntry* below = level;
+        level += peak_level_size(l - 1);
+        for (size_t i = 0; i < peak_level_size(l); i++) {
+            level[i] = empty_peak;
+            for (size_t k = 0; k < PEAK_FANOUT; k++) {
+                peak_add(&level[i], &below[i * PEAK_FANOUT + k]);
+            }
         }
     }
-    
-    return noErr;
+    g_atomic_int_set(&chunk->peak_frames, (gint)frames);
 }
 
-static void setup_audio_unit(AudioPlayer* player) {
-    AudioComponentDescription desc = {
-        .componentType = kAudioUnitType_Output,
-        .componentSubType = kAudioUnitSubType_DefaultOutput,
-        .componentManufacturer = kAudioUnitManufacturer_Apple,
-        .componentFlags = 0,
-        .componentFlagsMask = 0
-    };
+// Frames [first, end) of one chunk: whole entries from the coarsest level
+// that fits, raw samples only for the ragged ends
+static void peak_chunk_range(AudioChunk* chunk, size_t first, size_t end, PeakEntry* acc) {
+    while (first < end && first % PEAK_BLOCK != 0) {
+        PeakEntry sample = { chunk->samples[first], chunk->samples[first], 0.0f };
+        sample.sum_squares = sample.min * sample.min;
+        peak_add(acc, &sample);
+        first++;
+    }
+    while (end > first && end % PEAK_BLOCK != 0) {
+        end--;
+        PeakEntry sample = { chunk->samples[end], chunk->samples[end], 0.0f };
+        sample.sum_squares = sample.min * sample.min;
+        peak_add(acc, &sample);
+    }
+
+    size_t lo = first / PEAK_BLOCK, hi = end / PEAK_BLOCK;
+    for (int l = 0; lo < hi; l++) {
+        const PeakEntry* level = peak_level(chunk, l);
+        if (l == PEAK_LEVELS - 1) {
+            for (; lo < hi; lo++) peak_add(acc, &level[lo]);
+            break;
+        }
+        while (lo < hi && lo % PEAK_FANOUT != 0) peak_add(acc, &level[lo++]);
+        while (hi > lo && hi % PEAK_FANOUT != 0) peak_add(acc, &level[--hi]);
+        lo /= PEAK_FANOUT;
+        hi /= PEAK_FANOUT;
+    }
+}
 
-    AudioComponent comp = AudioComponentFindNext(NULL, &desc);
-    if (!comp) return;
+static void index_add(IndexEntry* acc, float min, float max, double sum_squares) {
+    acc->min = MIN(acc->min, min);
+    acc->max = MAX(acc->max, max);
+    acc->sum_squares += sum_squares;
+}
 
-    AudioUnit audioUnit;
-    OSStatus status = AudioComponentInstanceNew(comp, &audioUnit);
-    if (status != noErr) return;
+static const IndexEntry empty_index_entry = { INFINITY, -INFINITY, 0.0 };
 
-    AURenderCallbackStruct callback = {
-        .inputProc = playbackCallback,
-        .inputProcRefCon = player
-    };
+static AudioChunk* chunk_with_peaks(const AudioData* audio, uint16_t channel, size_t index) {
+    AudioChunk* chunk = *chunk_slot(audio, channel, index);
+    size_t valid = audio_data_chunk_frames(audio, index);
+    if ((size_t)g_atomic_int_get(&chunk->peak_frames) != valid) build_peaks(chunk, valid);
+    return chunk;
+}
 
-    status = AudioUnitSetProperty(audioUnit,
-                                kAudioUnitProperty_SetRenderCallback,
-                                kAudioUnitScope_Input,
-                                0,
-                                &callback,
-                                sizeof(callback));
-    if (status != noErr) {
-        AudioComponentInstanceDispose(audioUnit);
-        return;
+static AudioPeakIndex* build_peak_index(const AudioData* audio) {
+    size_t sizes[PEAK_INDEX_LEVELS];
+    int levels = 0;
+    size_t stride = 0;
+    for (size_t n = audio->chunk_count; ; n = (n + PEAK_FANOUT - 1) / PEAK_FANOUT) {
+        sizes[levels++] = n;
+        stride += n;
+        if (n == 1) break;
     }
 
-    AudioStreamBasicDescription format = {
-        .mSampleRate = player->target_sample_rate,
-        .mFormatID = kAudioFormatLinearPCM,
-        .mFormatFlags = kAudioFormatFlagIsFloat | kAudioFormatFlagIsPacked,
-        .mFramesPerPacket = 1,
-        .mChannelsPerFrame = player->active_mix->channels,
-        .mBitsPerChannel = 32,
-        .mBytesPerPacket = 4 * player->active_mix->channels,
-        .mBytesPerFrame = 4 * player->active_mix->channels
-    };
+    AudioPeakIndex* index = malloc(sizeof(AudioPeakIndex) + audio->channels * stride * sizeof(IndexEntry));
+    if (!index) return NULL;
+    index->generation = g_atomic_int_get(&audio->peak_generation);
+    index->levels = levels;
+    index->stride = stride;
+    index->offset[0] = 0;
+    for (int l = 1; l < levels; l++) {
+        index->offset[l] = index->offset[l - 1] + sizes[l - 1];
+    }
 
-    status = AudioUnitSetProperty(audioUnit,
-                                kAudioUnitProperty_StreamFormat,
-                                kAudioUnitScope_Input,
-                                0,
-                                &format,
-                                sizeof(format));
-    if (status != noErr) {
-        AudioComponentInstanceDispose(audioUnit);
-        return;
+    for (uint16_t ch = 0; ch < audio->channels; ch++) {
+        IndexEntry* level = index->entries + ch * stride;
+        for (size_t i = 0; i < audio->chunk_count; i++) {
+            const PeakEntry* top = peak_level(chunk_with_peaks(audio, ch, i), PEAK_LEVELS - 1);
+            level[i] = empty_index_entry;
+            index_add(&level[i], top->min, top->max, top->sum_squares);
+        }
+        for (int l = 1; l < levels; l++) {
+            const IndexEntry* below = level;
+            level += sizes[l - 1];
+            for (size_t i = 0; i < sizes[l]; i++) {
+                level[i] = empty_index_entry;
+                for (size_t k = i * PEAK_FANOUT; k < MIN((i + 1) * PEAK_FANOUT, sizes[l - 1]); k++) {
+                    index_add(&level[i], below[k].min, below[k].max, below[k].sum_squares);
+                }
+            }
+        }
     }
+    return index;
+}
 
-    status = AudioUnitInitialize(audioUnit);
-    if (status != noErr) {
-        AudioComponentInstanceDispose(audioUnit);
-        return;
+// The index is a cache, so building it through a const buffer is fine; the
+// UI thread is the only one that draws
+static const AudioPeakIndex* peak_index(const AudioData* audio) {
+    AudioData* owner = (AudioData*)audio;
+    if (owner->peak_index && owner->peak_index->generation == g_atomic_int_get(&audio->peak_generation)) {
+        return owner->peak_index;
     }
+    free(owner->peak_index);
+    owner->peak_index = build_peak_index(audio);
+    return owner->peak_index;
+}
 
-    status = AudioOutputUnitStart(audioUnit);
-    if (status != noErr) {
-        AudioUnitUninitialize(audioUnit);
-        AudioComponentInstanceDispose(audioUnit);
+// Whole chunks [lo, hi) of one channel, coarsest level that fits first
+static void peak_index_range(const AudioPeakIndex* index, uint16_t channel, size_t lo, size_t hi,
+                             IndexEntry* acc) {
+    const IndexEntry* entries = index->entries + channel * index->stride;
+    for (int l = 0; lo < hi; l++) {
+        const IndexEntry* level = entries + index->offset[l];
+        if (l == index->levels - 1) {
+            for (; lo < hi; lo++) index_add(acc, level[lo].min, level[lo].max, level[lo].sum_squares);
+            break;
+        }
+        for (; lo < hi && lo % PEAK_FANOUT != 0; lo++) {
+            index_add(acc, level[lo].min, level[lo].max, level[lo].sum_squares);
+        }
+        for (; hi > lo && hi % PEAK_FANOUT != 0; hi--) {
+            index_add(acc, level[hi - 1].min, level[hi - 1].max, level[hi - 1].sum_squares);
+        }
+        lo /= PEAK_FANOUT;
+        hi /= PEAK_FANOUT;
+    }
+}
+
+// Frames [first, end) chunk by chunk, through each chunk's own pyramid
+static void peak_chunks(const AudioData* audio, uint16_t channel, size_t first, size_t end, IndexEntry* acc) {
+    while (first < end) {
+        size_t index = first / AUDIO_CHUNK_FRAMES;
+        size_t offset = first % AUDIO_CHUNK_FRAMES;
+        size_t n = MIN(end - first, AUDIO_CHUNK_FRAMES - offset);
+
+        // Per chunk, so long spans keep their precision
+        PeakEntry part = empty_peak;
+        peak_chunk_range(chunk_with_peaks(audio, channel, index), offset, offset + n, &part);
+        index_add(acc, part.min, part.max, part.sum_squares);
+        first += n;
+    }
+}
+
+AudioPeak audio_data_peak(const AudioData* audio, uint16_t channel, size_t first, size_t frames) {
+    AudioPeak peak = { 0.0f, 0.0f, 0.0f };
+    if (!audio || !audio->chunks || channel >= audio->channels || first >= audio->frames) return peak;
+    frames = MIN(frames, audio->frames - first);
+    if (frames == 0) return peak;
+
+    // Chunks [lo, hi) lie wholly inside the span; the last one counts as
+    // whole when the span runs to the end of the audio
+    IndexEntry acc = empty_index_entry;
+    size_t end = first + frames;
+    size_t lo = (first + AUDIO_CHUNK_FRAMES - 1) / AUDIO_CHUNK_FRAMES;
+    size_t hi = end == audio->frames ? audio->chunk_count : end / AUDIO_CHUNK_FRAMES;
+    const AudioPeakIndex* index = lo < hi ? peak_index(audio) : NULL;
+    if (index) {
+        peak_chunks(audio, channel, first, lo * AUDIO_CHUNK_FRAMES, &acc);
+        peak_index_range(index, channel, lo, hi, &acc);
+        peak_chunks(audio, channel, MIN(hi * AUDIO_CHUNK_FRAMES, end), end, &acc);
+    } else {
+        peak_chunks(audio, channel, first, end, &acc);
+    }
+
+    peak.min = acc.min;
+    peak.max = acc.max;
+    peak.rms = (float)sqrt(acc.sum_squares / frames);
+    return peak;
+}
+
+// Read frames [frame, frame + frames) into dst planes, decoding file-backed
+// sources straight out of their mapping
+void audio_data_read(const AudioData* audio, size_t frame, size_t frames, float* const* dst) {
+    if (!audio->chunks) {
+        const uint8_t* src = (const uint8_t*)audio->source->data;
+        sample_decode_planar(audio->source_format, src + frame * audio->source->block_align,
+                             audio->channels, frames, dst);
         return;
     }
+
+    size_t done = 0;
+    while (done < frames) {
+        size_t pos = frame + done;
+        size_t offset = pos % AUDIO_CHUNK_FRAMES;
+        size_t n = MIN(frames - done, AUDIO_CHUNK_FRAMES - offset);
+        for (uint16_t ch = 0; ch < audio->channels; ch++) {
+            memcpy(dst[ch] + done, audio_data_chunk(audio, ch, pos / AUDIO_CHUNK_FRAMES) + offset,
+                   n * sizeof(float));
+        }
+        done += n;
+    }
 }
-#else
-// Linux PulseAudio stream
-static pa_simple *pa_stream = NULL;
-
-static void init_pulseaudio(AudioPlayer* player) {
-    pa_sample_spec ss = {
-        .format = PA_SAMPLE_S16LE,
-        .rate = player->target_sample_rate,
-        .channels = player->active_mix->channels
-    };
-    
-    int error;
-    pa_stream = pa_simple_new(NULL,               // Use default server
-                             "TasteWarp",         // Application name
-                             PA_STREAM_PLAYBACK,   // Stream direction
-                             NULL,                // Use default device
-                             "Music",             // Stream description
-                             &ss,                 // Sample format
-                             NULL,                // Use default channel map
-                             NULL,                // Use default buffering attributes
-                             &error);             // Error code
-    
-    if (!pa_stream) {
-        fprintf(stderr, "pa_simple_new() failed: %s\n", pa_strerror(error));
-        exit(1);
+
+void audio_data_write(AudioData* audio, size_t frame, size_t frames, const float* const* src) {
+    if (!audio->chunks) return;
+
+    size_t done = 0;
+    while (done < frames) {
+        size_t pos = frame + done;
+        size_t offset = pos % AUDIO_CHUNK_FRAMES;
+        size_t n = MIN(frames - done, AUDIO_CHUNK_FRAMES - offset);
+        for (uint16_t ch = 0; ch < audio->channels; ch++) {
+            float* dst = audio_data_chunk_mut(audio, ch, pos / AUDIO_CHUNK_FRAMES);
+            if (dst) memcpy(dst + offset, src[ch] + done, n * sizeof(float));
+        }
+        done += n;
+    }
+}
+
+// In-memory audio is cloned by sharing its chunks, so this costs nothing
+// until one side writes. File-backed sources are decoded.
+AudioData* audio_data_clone(const AudioData* audio) {
+    if (!audio) return NULL;
+
+    if (!audio->chunks) {
+        AudioData* copy = audio_data_new(audio->sample_rate, audio->channels, audio->frames);
+        if (!copy) return NULL;
+
+        float* planes[AUDIO_MAX_CHANNELS];
+        for (size_t i = 0; i < copy->chunk_count; i++) {
+            for (uint16_t ch = 0; ch < copy->channels; ch++) {
+                planes[ch] = audio_data_chunk_mut(copy, ch, i);
+            }
+            audio_data_read(audio, i * AUDIO_CHUNK_FRAMES, audio_data_chunk_frames(copy, i), planes);
+        }
+        copy->mix_volume = audio->mix_volume;
+        return copy;
+    }
+
+    AudioData* copy = calloc(1, sizeof(AudioData));
+    if (!copy) return NULL;
+
+    *copy = *audio;
+    copy->peak_index = NULL;
+    copy->filename = audio->filename ? strdup(audio->filename) : NULL;
+    copy->source = audio->source ? wav_file_ref(audio->source) : NULL;
+    copy->chunks = malloc(audio->channels * audio->chunk_count * sizeof(AudioChunk*));
+    if (!copy->chunks) {
+        free_audio_data(copy);
+        return NULL;
     }
+    for (size_t i = 0; i < audio->channels * audio->chunk_count; i++) {
+        copy->chunks[i] = audio->chunks[i];
+        g_atomic_int_inc(&copy->chunks[i]->refcount);
+    }
+    return copy;
 }
 
-static void cleanup_pulseaudio(void) {
-    if (pa_stream) {
-        pa_simple_free(pa_stream);
-        pa_stream = NULL;
+void free_audio_data(AudioData* audio) {
+    if (!audio) return;
+
+    if (audio->chunks) {
+        for (size_t i = 0; i < audio->channels * audio->chunk_count; i++) {
+            chunk_unref(audio->chunks[i]);
+        }
+        free(audio->chunks);
     }
+    wav_file_unref(audio->source);
+    free(audio->peak_index);
+    free(audio->filename);
+    free(audio);
 }
-#endif
 
-// Platform-independent functions
-AudioData* load_wav_file(const char* filename) {
 #ifdef __APPLE__
-    AudioData* audio = malloc(sizeof(AudioData));
-    if (!audio) return NULL;
-    
-    // Store filename
-    audio->filename = strdup(filename);
-    audio->mix_volume = 1.0f;
-    
-    // Open the audio file
-    AudioFileID audioFile;
-    CFURLRef fileURL = CFURLCreateFromFileSystemRepresentation(NULL, 
+// Non-RIFF files (AIFF, CAF, ...) go through Core Audio, which converts
+// straight into our planar float layout
+static AudioData* load_audio_file_coreaudio(const char* filename) {
+    CFURLRef fileURL = CFURLCreateFromFileSystemRepresentation(NULL,
                                                            (const UInt8*)filename,
-                                                           strlen(filename), 
+                                                           strlen(filename),
                                                            false);
-    
-    OSStatus status = AudioFileOpenURL(fileURL, kAudioFileReadPermission, 0, &audioFile);
+    ExtAudioFileRef file;
+    OSStatus status = ExtAudioFileOpenURL(fileURL, &file);
     CFRelease(fileURL);
-    
-    if (status != noErr) {
-        free(audio->filename);
-        free(audio);
-        return NULL;
+    if (status != noErr) return NULL;
+
+    AudioStreamBasicDescription file_format;
+    SInt64 file_frames = 0;
+    UInt32 propSize = sizeof(file_format);
+    status = ExtAudioFileGetProperty(file, kExtAudioFileProperty_FileDataFormat,
+                                     &propSize, &file_format);
+    if (status == noErr) {
+        propSize = sizeof(file_frames);
+        status = ExtAudioFileGetProperty(file, kExtAudioFileProperty_FileLengthFrames,
+                                         &propSize, &file_frames);
     }
-    
-    // Get audio file properties
-    AudioStreamBasicDescription asbd;
-    UInt32 propSize = sizeof(asbd);
-    status = AudioFileGetProperty(audioFile, 
-                             kAudioFilePropertyDataFormat,
-                             &propSize, 
-                             &asbd);
-    
-    if (status != noErr) {
-        AudioFileClose(audioFile);
-        free(audio->filename);
-        free(audio);
-        return NULL;
+
+    AudioStreamBasicDescription client = {0};
+    client.mSampleRate = file_format.mSampleRate;
+    client.mFormatID = kAudioFormatLinearPCM;
+    client.mFormatFlags = kAudioFormatFlagIsFloat | kAudioFormatFlagIsPacked |
+                          kAudioFormatFlagIsNonInterleaved | kAudioFormatFlagsNativeEndian;
+    client.mChannelsPerFrame = file_format.mChannelsPerFrame;
+    client.mBitsPerChannel = 32;
+    client.mFramesPerPacket = 1;
+    client.mBytesPerFrame = sizeof(float);
+    client.mBytesPerPacket = sizeof(float);
+
+    if (status == noErr) {
+        status = ExtAudioFileSetProperty(file, kExtAudioFileProperty_ClientDataFormat,
+                                         sizeof(client), &client);
     }
-    
-    // Get file size
-    UInt64 fileSize = 0;
-    propSize = sizeof(fileSize);
-    status = AudioFileGetProperty(audioFile,
-                             kAudioFilePropertyAudioDataByteCount,
-                             &propSize,
-                             &fileSize);
-    
-    if (status != noErr) {
-        AudioFileClose(audioFile);
-        free(audio->filename);
-        free(audio);
-        return NULL;
+
+    AudioData* audio = NULL;
+    if (status == noErr && file_frames > 0) {
+        audio = audio_data_new((uint32_t)file_format.mSampleRate,
+                               file_format.mChannelsPerFrame, (size_t)file_frames);
     }
-    
-    // Allocate buffer and read audio data
-    audio->buffer = malloc(fileSize);
-    audio->buffer_size = fileSize;
-    audio->sample_rate = asbd.mSampleRate;
-    audio->channels = asbd.mChannelsPerFrame;
-    audio->bits_per_sample = asbd.mBitsPerChannel;
-    
-    UInt32 bytesToRead = fileSize;
-    status = AudioFileReadBytes(audioFile,
-                           false,
-                           0,
-                           &bytesToRead,
-                           audio->buffer);
-    
-    AudioFileClose(audioFile);
-    
-    if (status != noErr) {
-        free(audio->buffer);
-        free(audio->filename);
-        free(audio);
+    if (!audio) {
+        ExtAudioFileDispose(file);
         return NULL;
     }
-    
-    return audio;
-#else
-    // Linux WAV loading implementation
-    AudioData* audio = malloc(sizeof(AudioData));
-    if (!audio) return NULL;
-    
-    // Store filename
-    audio->filename = strdup(filename);
-    audio->mix_volume = 1.0f;
-    
-    FILE* file = fopen(filename, "rb");
-    if (!file) {
-        free(audio->filename);
-        free(audio);
-        return NULL;
+
+    AudioBufferList* list = malloc(offsetof(AudioBufferList, mBuffers) +
+                                   audio->channels * sizeof(AudioBuffer));
+    size_t done = 0;
+    while (list && done < audio->frames) {
+        // Read straight into the chunks, never across a chunk boundary
+        size_t offset = done % AUDIO_CHUNK_FRAMES;
+        UInt32 frames = (UInt32)MIN(audio->frames - done, AUDIO_CHUNK_FRAMES - offset);
+        list->mNumberBuffers = audio->channels;
+        for (uint16_t ch = 0; ch < audio->channels; ch++) {
+            list->mBuffers[ch].mNumberChannels = 1;
+            list->mBuffers[ch].mDataByteSize = frames * sizeof(float);
+            list->mBuffers[ch].mData = audio_data_chunk_mut(audio, ch, done / AUDIO_CHUNK_FRAMES) + offset;
+        }
+        if (ExtAudioFileRead(file, &frames, list) != noErr || frames == 0) break;
+        done += frames;
     }
-    
-    // Read WAV header
-    typedef struct {
-        char riff_header[4];    // "RIFF"
-        int32_t wav_size;       // Total file size - 8
-        char wave_header[4];    // "WAVE"
-        char fmt_header[4];     // "fmt "
-        int32_t fmt_chunk_size; // Size of format chunk
-        int16_t audio_format;   // Audio format (1 for PCM)
-        int16_t num_channels;   // Number of channels
-        int32_t sample_rate;    // Sample rate
-        int32_t byte_rate;      // Bytes per second
-        int16_t block_align;    // Bytes per sample * channels
-        int16_t bits_per_sample;// Bits per sample
-        char data_header[4];    // "data"
-        int32_t data_bytes;     // Size of audio data
-    } WavHeader;
-    
-    WavHeader header;
-    if (fread(&header, sizeof(WavHeader), 1, file) != 1) {
-        fclose(file);
-        free(audio->filename);
-        free(audio);
+    free(list);
+    ExtAudioFileDispose(file);
+
+    if (done == 0) {
+        free_audio_data(audio);
         return NULL;
     }
-    
-    // Verify WAV format
-    if (memcmp(header.riff_header, "RIFF", 4) != 0 ||
-        memcmp(header.wave_header, "WAVE", 4) != 0 ||
-        memcmp(header.fmt_header, "fmt ", 4) != 0 ||
-        memcmp(header.data_header, "data", 4) != 0) {
-        fclose(file);
-        free(audio->filename);
-        free(audio);
+
+    audio->frames = done;
+    audio->filename = strdup(filename);
+    audio->bits_per_sample = file_format.mBitsPerChannel;
+    return audio;
+}
+#endif
+
+// WAV files are mapped rather than read. The samples stay in the file's own
+// format and are decoded to float whenever the mix reads them.
+AudioData* load_wav_file(const char* filename) {
+    WavFile* wav = wav_file_open(filename);
+    if (!wav) {
+#ifdef __APPLE__
+        return load_audio_file_coreaudio(filename);
+#else
         return NULL;
+#endif
     }
-    
-    // Fill audio data structure
-    audio->channels = header.num_channels;
-    audio->sample_rate = header.sample_rate;
-    audio->bits_per_sample = header.bits_per_sample;
-    audio->buffer_size = header.data_bytes;
-    
-    // Allocate and read audio data
-    audio->buffer = malloc(audio->buffer_size);
-    if (!audio->buffer) {
-        fclose(file);
-        free(audio->filename);
-        free(audio);
+
+    SampleFormat format = sample_format_from_wav(wav->format, wav->bits_per_sample);
+    if (format == SAMPLE_FORMAT_INVALID || wav->channels > AUDIO_MAX_CHANNELS ||
+        wav->block_align != wav->channels * sample_format_bytes(format)) {
+        fprintf(stderr, "%s: unsupported sample format (format 0x%04x, %u bits, %u channels)\n",
+                filename, wav->format, wav->bits_per_sample, wav->channels);
+        wav_file_unref(wav);
         return NULL;
     }
-    
-    if (fread(audio->buffer, 1, audio->buffer_size, file) != audio->buffer_size) {
-        fclose(file);
-        free(audio->buffer);
-        free(audio->filename);
-        free(audio);
+
+    AudioData* audio = calloc(1, sizeof(AudioData));
+    if (!audio) {
+        wav_file_unref(wav);
         return NULL;
     }
-    
-    fclose(file);
+
+    audio->filename = strdup(filename);
+    audio->mix_volume = 1.0f;
+    audio->source = wav;
+    audio->source_format = format;
+    audio->frames = wav->data_bytes / wav->block_align;
+    audio->sample_rate = wav->sample_rate;
+    audio->channels = wav->channels;
+    audio->bits_per_sample = wav->bits_per_sample;
+
     return audio;
-#endif
 }
 
 void mix_audio_files(AudioPlayer* player) {
     if (!player || !player->audio_files) return;
     
-    // Get first audio file
+    // The mix keeps the player's rate and channel layout whichever file is first
     AudioData* first = (AudioData*)player->audio_files->data;
-    
-    // Create or resize active mix buffer if needed
-    if (!player->active_mix) {
-        player->active_mix = malloc(sizeof(AudioData));
-        player->active_mix->buffer = malloc(first->buffer_size);
-        player->active_mix->buffer_size = first->buffer_size;
-        player->active_mix->sample_rate = first->sample_rate;
-        player->active_mix->channels = first->channels;
-        player->active_mix->bits_per_sample = first->bits_per_sample;
-    }
-    
-    // If we have active effects, don't overwrite the active mix
-    if (player->effect_active) return;
-    
-    // Otherwise, copy the first file's data to active mix
-    memcpy(player->active_mix->buffer, first->buffer, first->buffer_size);
-    
-    // Mix in any additional files
-    for (GList* l = player->audio_files->next; l != NULL; l = l->next) {
-        AudioData* audio = (AudioData*)l->data;
-        for (size_t i = 0; i < audio->buffer_size / sizeof(int16_t); i++) {
-            float sample = audio->buffer[i] * audio->mix_volume;
-            player->active_mix->buffer[i] = (int16_t)fmin(32767, fmax(-32768, 
-                player->active_mix->buffer[i] + sample));
-        }
-    }
+    uint32_t rate = player->target_sample_rate ? player->target_sample_rate : first->sample_rate;
+    uint16_t channels = player->active_mix ? player->active_mix->channels : first->channels;
+    size_t frames = mixer_length(player->audio_files, rate, player->mix_policy);
+    
+    // Always a new buffer, rendered before the audio side sees it: the render
+    // thread reads the mix under mix_lock, which the pool workers writing it
+    // can't hold. Every sample is rewritten, so there is nothing to share
+    // with the old mix.
+    AudioData* mix = audio_data_new(rate, channels, frames);
+    if (!mix) return;
+    mixer_render(player->audio_files, mix, player->mix_policy);
+    
+    g_mutex_lock(&player->mix_lock);
+    AudioData* old = player->active_mix;
+    player->active_mix = mix;
+    g_mutex_unlock(&player->mix_lock);
+    free_audio_data(old);
 }
 
 void add_audio_file(AudioPlayer* player, const char* filename) {
@@ -368,54 +627,56 @@ void add_audio_file(AudioPlayer* player, const char* filename) {
     if (is_first) {
         player->target_sample_rate = audio->sample_rate;
         player->last_60_seconds_samples = audio->sample_rate * 60;
-        
-        // Create initial backup for effects
-        if (!player->original_mix) {
-            player->original_mix = malloc(sizeof(AudioData));
-            player->original_mix->buffer = malloc(audio->buffer_size);
-            memcpy(player->original_mix->buffer, audio->buffer, audio->buffer_size);
-            player->original_mix->buffer_size = audio->buffer_size;
-            player->original_mix->sample_rate = audio->sample_rate;
-            player->original_mix->channels = audio->channels;
-            player->original_mix->bits_per_sample = audio->bits_per_sample;
-        }
     }
     
     mix_audio_files(player);
+    
+    // Keep the first mix for reset; it shares the mix's chunks
+    if (is_first && !player->original_mix) {
+        player->original_mix = audio_data_clone(player->active_mix);
+    }
 }
 
 void remove_audio_file(AudioPlayer* player, AudioData* audio) {
+    // Reset goes back to the first file alone; once that file is gone the
+    // kept mix is of nothing in the list, so reset remixes instead
+    if (player->audio_files && player->audio_files->data == audio) {
+        free_audio_data(player->original_mix);
+        player->original_mix = NULL;
+    }
     player->audio_files = g_list_remove(player->audio_files, audio);
-    free(audio->buffer);
-    free(audio->filename);
-    free(audio);
+    free_audio_data(audio);
     mix_audio_files(player);
 }
 
+// Back to the first file as it was loaded. The mix from then is still
+// around as a clone, so this swaps it back in instead of remixing.
 void reset_to_original(AudioPlayer* player) {
-    if (player->original_mix) {
-        memcpy(player->active_mix->buffer, player->original_mix->buffer,
-               player->original_mix->buffer_size);
-        free(player->original_mix->buffer);
-        free(player->original_mix);
-        player->original_mix = NULL;
-    }
-    player->effect_active = FALSE;
+    history_clear(player);
+    effect_chain_clear(player->effects);
     
-    // Keep only the first file
+    // Keep only the first file, at full volume
     while (g_list_length(player->audio_files) > 1) {
-        GList* last = g_list_last(player->audio_files);
-        AudioData* audio = (AudioData*)last->data;
-        remove_audio_file(player, audio);
+        AudioData* audio = (AudioData*)g_list_last(player->audio_files)->data;
+        player->audio_files = g_list_remove(player->audio_files, audio);
+        free_audio_data(audio);
     }
-    
-    // Reset mix volume
     if (player->audio_files) {
         AudioData* first = (AudioData*)player->audio_files->data;
         first->mix_volume = 1.0f;
     }
     
-    mix_audio_files(player);
+    AudioData* original = audio_data_clone(player->original_mix);
+    if (!original) {
+        mix_audio_files(player);
+        return;
+    }
+    
+    g_mutex_lock(&player->mix_lock);
+    AudioData* old = player->active_mix;
+    player->active_mix = original;
+    g_mutex_unlock(&player->mix_lock);
+    free_audio_data(old);
 }
 
 char* generate_export_filename(void) {
@@ -431,16 +692,17 @@ char* generate_export_filename(void) {
     return filename;
 }
 
+
 void init_audio_player(AudioPlayer* player, AudioData* audio) {
     // Clear all fields first
     memset(player, 0, sizeof(AudioPlayer));
     
     player->audio_files = NULL;
     player->active_mix = NULL;
-    player->original_mix = NULL;
     player->ring_buffer_pos = 0;
-    player->effect_active = FALSE;
     player->last_effect_time = 0;
+    player->mix_policy = mix_policy_default();
+    g_mutex_init(&player->mix_lock);
     
     if (audio) {
         player->audio_files = g_list_append(player->audio_files, audio);
@@ -448,76 +710,71 @@ void init_audio_player(AudioPlayer* player, AudioData* audio) {
         player->last_60_seconds_samples = audio->sample_rate * 60;
         mix_audio_files(player);
         
-        // Create initial backup for effects
-        player->original_mix = malloc(sizeof(AudioData));
-        player->original_mix->buffer = malloc(audio->buffer_size);
-        memcpy(player->original_mix->buffer, audio->buffer, audio->buffer_size);
-        player->original_mix->buffer_size = audio->buffer_size;
-        player->original_mix->sample_rate = audio->sample_rate;
-        player->original_mix->channels = audio->channels;
-        player->original_mix->bits_per_sample = audio->bits_per_sample;
+        // Keep the first mix for reset; it shares the mix's chunks
+        player->original_mix = audio_data_clone(player->active_mix);
         
-#ifdef __APPLE__
-        // Initialize AudioUnit for macOS
-        setup_audio_unit(player);
-#else
-        // Initialize PulseAudio for Linux
-        init_pulseaudio(player);
-#endif
+        // Open the output device; playback starts with play_audio()
+        if (player->active_mix) {
+            player->effects = effect_chain_new(player->target_sample_rate, player->active_mix->channels);
+        }
+        player->playback = playback_engine_new(player, NULL);
     }
 }
 
 void cleanup_audio_player(AudioPlayer* player) {
-#ifdef __APPLE__
-    // ... existing macOS cleanup code ...
-#else
-    cleanup_pulseaudio();
-#endif
+    // Stop the audio threads before any buffer they read is freed
+    playback_engine_free(player->playback);
+    player->playback = NULL;
+    history_clear(player);
+    effect_chain_free(player->effects);
+    player->effects = NULL;
 
     while (player->audio_files) {
         AudioData* audio = (AudioData*)player->audio_files->data;
         remove_audio_file(player, audio);
     }
     
-    if (player->active_mix) {
-        free(player->active_mix->buffer);
-        free(player->active_mix->filename);
-        free(player->active_mix);
-    }
+    // Anything still reading the mix does so under mix_lock
+    g_mutex_lock(&player->mix_lock);
+    AudioData* old = player->active_mix;
+    player->active_mix = NULL;
+    g_mutex_unlock(&player->mix_lock);
+    free_audio_data(old);
     
-    if (player->original_mix) {
-        free(player->original_mix->buffer);
-        free(player->original_mix);
-    }
+    // mix_lock stays initialised; cleanup may run more than once on exit
 }
 
 void play_audio(AudioPlayer* player) {
-    // Audio playback is handled by the callback
-    (void)player;
+    if (!player || !player->active_mix) return;
+    
+    if (!player->effects) {
+        player->effects = effect_chain_new(player->target_sample_rate, player->active_mix->channels);
+    }
+    if (!player->playback) {
+        // The spectrum analyser picks the engine up from its own thread
+        __atomic_store_n(&player->playback, playback_engine_new(player, NULL), __ATOMIC_RELEASE);
+    }
+    playback_start(player->playback);
+}
+
+void pause_audio(AudioPlayer* player) {
+    if (!player) return;
+    playback_pause(player->playback);
 }
 
 void stop_audio(AudioPlayer* player) {
-    // Implementation for stopping audio would go here
-    (void)player;
-}
-
-int save_wav_file(const char* filename, AudioData* audio) {
-    // WAV file header
-    typedef struct {
-        char riff_header[4];    // Contains "RIFF"
-        int32_t wav_size;       // Size of WAV file in bytes - 8
-        char wave_header[4];    // Contains "WAVE"
-        char fmt_header[4];     // Contains "fmt "
-        int32_t fmt_chunk_size; // Size of format chunk
-        int16_t audio_format;   // Audio format (1 for PCM)
-        int16_t num_channels;   // Number of channels
-        int32_t sample_rate;    // Sample rate
-        int32_t byte_rate;      // Byte rate
-        int16_t block_align;    // Block align
-        int16_t bits_per_sample;// Bits per sample
-        char data_header[4];    // Contains "data"
-        int32_t data_bytes;     // Number of bytes in data
-    } WavHeader;
+    if (!player) return;
+    playback_stop(player->playback);
+}
+
+int save_wav_file(const char* filename, AudioData* audio, SampleFormat format) {
+    size_t sample_bytes = sample_format_bytes(format);
+    size_t block_align = audio->channels * sample_bytes;
+    uint16_t wav_format = sample_format_wav_tag(format);
+    if (audio->frames > wav_max_data_bytes(wav_format, block_align) / block_align) {
+        printf("Too long for a WAV file: %s\n", filename);
+        return -1;
+    }
     
     FILE* file = fopen(filename, "wb");
     if (!file) {
@@ -525,32 +782,29 @@ int save_wav_file(const char* filename, AudioData* audio) {
         return -1;
     }
     
-    // Prepare WAV header
-    WavHeader header;
-    memcpy(header.riff_header, "RIFF", 4);
-    memcpy(header.wave_header, "WAVE", 4);
-    memcpy(header.fmt_header, "fmt ", 4);
-    memcpy(header.data_header, "data", 4);
-    
-    header.fmt_chunk_size = 16;
-    header.audio_format = 1;
-    header.num_channels = audio->channels;
-    header.sample_rate = audio->sample_rate;
-    header.bits_per_sample = audio->bits_per_sample;
-    header.block_align = audio->channels * (audio->bits_per_sample / 8);
-    header.byte_rate = header.sample_rate * header.block_align;
-    header.data_bytes = audio->buffer_size;
-    header.wav_size = header.data_bytes + sizeof(WavHeader) - 8;
-    
     // Write header and data
-    size_t written = fwrite(&header, sizeof(WavHeader), 1, file);
+    size_t written = wav_write_header(file, wav_format, audio->channels,
+                                      audio->sample_rate, sample_bytes * 8,
+                                      (uint32_t)(audio->frames * block_align));
     if (written != 1) {
         printf("Error writing WAV header\n");
         fclose(file);
         return -1;
     }
     
-    written = fwrite(audio->buffer, audio->buffer_size, 1, file);
+    // Quantise to the file format only here, a chunk at a time
+    float scratch[AUDIO_MAX_CHANNELS][CONVERT_CHUNK];
+    float* planes[AUDIO_MAX_CHANNELS];
+    for (uint16_t ch = 0; ch < audio->channels; ch++) {
+        planes[ch] = scratch[ch];
+    }
+    uint8_t encoded[CONVERT_CHUNK * AUDIO_MAX_CHANNELS * sizeof(float)];
+    for (size_t pos = 0; pos < audio->frames && written == 1; pos += CONVERT_CHUNK) {
+        size_t n = MIN(CONVERT_CHUNK, audio->frames - pos);
+        audio_data_read(audio, pos, n, planes);
+        sample_encode_planar(format, (const float* const*)planes, audio->channels, n, encoded);
+        written = fwrite(encoded, n * block_align, 1, file);
+    }
     if (written != 1) {
         printf("Error writing WAV data\n");
         fclose(file);
@@ -561,6 +815,30 @@ int save_wav_file(const char* filename, AudioData* audio) {
     return 0;
 }
 
+// One column of image synthesis: three partials of base_freq, whose cycles
+// are counted per column, plus noise, all scaled by the edge strength
+static void synthesize_column(float* column, size_t frames, float base_freq, float max_edge) {
+    static const float partials[][2] = {
+        { 1.0f, 0.5f },     // Fundamental
+        { 2.0f, 0.25f },    // Octave
+        { 3.0f, 0.15f },    // Fifth
+    };
+    float wave[frames];
+    
+    rng_fill_float(rng_thread(), column, frames);
+    for (size_t t = 0; t < frames; t++) {
+        column[t] = 0.1f * max_edge * (column[t] - 0.5f);
+    }
+    for (size_t p = 0; p < G_N_ELEMENTS(partials); p++) {
+        Oscillator osc;
+        oscillator_init(&osc, OSC_SINE, base_freq * partials[p][0], frames);
+        oscillator_render(&osc, wave, frames);
+        for (size_t t = 0; t < frames; t++) {
+            column[t] += partials[p][1] * max_edge * wave[t];
+        }
+    }
+}
+
 // Add new function to convert image to audio
 AudioData* create_audio_from_image(const char* filename, Visualizer* vis) {
     if (!filename) return NULL;
@@ -585,18 +863,19 @@ AudioData* create_audio_from_image(const char* filename, Visualizer* vis) {
         return NULL;
     }
     
-    // Create audio data first
-    AudioData* audio = malloc(sizeof(AudioData));
+    // Create audio data first, 100 frames per pixel column
+    size_t num_samples = width * 100;
+    AudioData* audio = audio_data_new(44100, 2, num_samples);
     if (!audio) {
         g_object_unref(pixbuf);
         return NULL;
     }
     
     audio->filename = strdup(filename);
-    audio->sample_rate = 44100;
-    audio->channels = 2;
-    audio->bits_per_sample = 16;
-    audio->mix_volume = 1.0f;
+    
+    // One pixel column of samples, the same on both channels
+    float column[100];
+    const float* planes[2] = { column, column };
     
     // Convert to grayscale for edge detection
     GdkPixbuf* gray = gdk_pixbuf_new(GDK_COLORSPACE_RGB, FALSE, 8,
@@ -636,10 +915,6 @@ AudioData* create_audio_from_image(const char* filename, Visualizer* vis) {
     }
     
     // Convert edges to frequencies
-    size_t num_samples = width * 100;  // 100 samples per pixel column
-    audio->buffer_size = num_samples * sizeof(int16_t) * 2;
-    audio->buffer = malloc(audio->buffer_size);
-    
     printf("Converting image to audio:\n");
     printf("- Found %d edge points\n", width * height);
     printf("- Creating %zu audio samples\n", num_samples);
@@ -696,24 +971,8 @@ AudioData* create_audio_from_image(const char* filename, Visualizer* vis) {
         printf("Column %d: Edge at y=%d -> Base Frequency %.1f Hz\n", x, max_y, base_freq);
         
         // Generate audio samples with harmonics
-        for (int t = 0; t < 100; t++) {
-            float time = (float)t / 100.0f;
-            float sample = 0;
-            
-            // Add fundamental frequency
-            sample += 0.5f * max_edge * sin(2.0f * M_PI * base_freq * time);
-            // Add octave
-            sample += 0.25f * max_edge * sin(4.0f * M_PI * base_freq * time);
-            // Add fifth
-            sample += 0.15f * max_edge * sin(6.0f * M_PI * base_freq * time);
-            
-            // Add some noise for texture based on edge intensity
-            sample += 0.1f * max_edge * ((float)rand() / RAND_MAX - 0.5f);
-            
-            int idx = (x * 100 + t) * 2;
-            audio->buffer[idx] = (int16_t)(sample * 32767.0f);
-            audio->buffer[idx + 1] = (int16_t)(sample * 32767.0f);
-        }
+        synthesize_column(column, 100, base_freq, max_edge);
+        audio_data_write(audio, x * 100, 100, planes);
     }
     
     if (started) {
@@ -771,24 +1030,8 @@ AudioData* create_audio_from_image(const char* filename, Visualizer* vis) {
                     printf("Column %d: Edge at y=%d -> Base Frequency %.1f Hz\n", x, max_y, base_freq);
                     
                     // Generate audio samples with harmonics
-                    for (int t = 0; t < 100; t++) {
-                        float time = (float)t / 100.0f;
-                        float sample = 0;
-                        
-                        // Add fundamental frequency
-                        sample += 0.5f * max_edge * sin(2.0f * M_PI * base_freq * time);
-                        // Add octave
-                        sample += 0.25f * max_edge * sin(4.0f * M_PI * base_freq * time);
-                        // Add fifth
-                        sample += 0.15f * max_edge * sin(6.0f * M_PI * base_freq * time);
-                        
-                        // Add some noise for texture based on edge intensity
-                        sample += 0.1f * max_edge * ((float)rand() / RAND_MAX - 0.5f);
-                        
-                        int idx = (x * 100 + t) * 2;
-                        audio->buffer[idx] = (int16_t)(sample * 32767.0f);
-                        audio->buffer[idx + 1] = (int16_t)(sample * 32767.0f);
-                    }
+                    synthesize_column(column, 100, base_freq, max_edge);
+                    audio_data_write(audio, x * 100, 100, planes);
                 }
                 
                 if (started) {
@@ -5,6 +5,8 @@
 #include <glib.h>
 #include "types.h"
 #include "visualizer_types.h"
+#include "wavfile.h"
+#include "sample_convert.h"
 
 #ifdef __APPLE__
 #include <AudioToolbox/AudioToolbox.h>
@@ -17,19 +19,62 @@
 #define MAX_FILENAME 256
 #define EXPORT_PREFIX "tastewarp_export_"
 
+// Most channels a file or mix may have
+#define AUDIO_MAX_CHANNELS 8
+
+// Planes are aligned so per-sample loops vectorise cleanly
+#define AUDIO_PLANE_ALIGN 64
+
+// In-memory audio is stored per channel in fixed-size, reference-counted
+// chunks. Clones share every chunk and a chunk is only duplicated when one
+// side writes to it, so snapshots cost next to nothing.
+#define AUDIO_CHUNK_FRAMES 16384
+
+typedef struct AudioChunk AudioChunk;
+typedef struct AudioPeakIndex AudioPeakIndex;
+
 typedef struct AudioData {
     char* filename;
-    int16_t* buffer;
-    size_t buffer_size;
+    AudioChunk** chunks;        // Planar float32, chunk_count per channel, channel-major;
+                                // NULL for file-backed sources, see audio_data_read()
+    size_t chunk_count;
+    size_t frames;
     uint32_t sample_rate;
     uint16_t channels;
-    uint16_t bits_per_sample;
+    uint16_t bits_per_sample;   // Of the file it came from
     float mix_volume;
+    WavFile* source;            // Mapped file behind a file-backed source
+    SampleFormat source_format;
+    AudioPeakIndex* peak_index; // Peaks of whole chunks, built by audio_data_peak()
+    gint peak_generation;       // Bumped on every chunk write; a stale index is rebuilt
 } AudioData;
 
 // Function declarations...
 AudioData* load_wav_file(const char* filename);
-int save_wav_file(const char* filename, AudioData* audio);
+AudioData* audio_data_new(uint32_t sample_rate, uint16_t channels, size_t frames);
+AudioData* audio_data_clone(const AudioData* audio);
+void audio_data_read(const AudioData* audio, size_t frame, size_t frames, float* const* dst);
+void audio_data_write(AudioData* audio, size_t frame, size_t frames, const float* const* src);
+float audio_data_sample(const AudioData* audio, uint16_t channel, size_t frame);
+// Direct chunk access for in-memory audio; _mut unshares the chunk first
+size_t audio_data_chunk_frames(const AudioData* audio, size_t index);
+const float* audio_data_chunk(const AudioData* audio, uint16_t channel, size_t index);
+float* audio_data_chunk_mut(AudioData* audio, uint16_t channel, size_t index);
+// Whether two in-memory buffers share every chunk of a channel, i.e. one is
+// a clone of the other and neither has written to it since
+gboolean audio_data_shares_channel(const AudioData* a, const AudioData* b, uint16_t channel);
+// Min, max and RMS of frames [first, first + frames) of one channel of
+// in-memory audio, for drawing. Whole chunks come from a per-channel pyramid
+// over the chunks and the ragged ends from the chunks' own, so the cost stays
+// a few dozen entries however long the span. UI thread.
+typedef struct {
+    float min;
+    float max;
+    float rms;
+} AudioPeak;
+AudioPeak audio_data_peak(const AudioData* audio, uint16_t channel, size_t first, size_t frames);
+void free_audio_data(AudioData* audio);
+int save_wav_file(const char* filename, AudioData* audio, SampleFormat format);
 void mix_audio_files(AudioPlayer* player);
 void add_audio_file(AudioPlayer* player, const char* filename);
 void remove_audio_file(AudioPlayer* player, AudioData* audio);
@@ -37,6 +82,7 @@ void reset_to_original(AudioPlayer* player);
 void init_audio_player(AudioPlayer* player, AudioData* audio);
 void cleanup_audio_player(AudioPlayer* player);
 void play_audio(AudioPlayer* player);
+void pause_audio(AudioPlayer* player);
 void stop_audio(AudioPlayer* player);
 char* generate_export_filename(void);
 AudioData* create_audio_from_image(const char* filename, Visualizer* vis);
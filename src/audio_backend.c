@@ -0,0 +1,108 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "audio_backend.h"
+
+// Tried in order when the backend is "auto"
+static const AudioBackendOps* const platform_backends[] = {
+#ifdef __APPLE__
+    &coreaudio_backend_ops,
+#else
+    &pulse_backend_ops,
+    &alsa_backend_ops,
+#endif
+    &null_backend_ops,
+};
+
+static const AudioBackendOps* const all_backends[] = {
+#ifdef __APPLE__
+    &coreaudio_backend_ops,
+#else
+    &pulse_backend_ops,
+    &alsa_backend_ops,
+#endif
+    &null_backend_ops,
+    &wav_backend_ops,
+};
+
+static guint env_uint(const char* name, guint fallback) {
+    const char* value = g_getenv(name);
+    if (!value || !*value) return fallback;
+    char* end;
+    unsigned long parsed = strtoul(value, &end, 10);
+    return (*end == '\0') ? (guint)parsed : fallback;
+}
+
+static double env_double(const char* name, double fallback) {
+    const char* value = g_getenv(name);
+    if (!value || !*value) return fallback;
+    char* end;
+    double parsed = strtod(value, &end);
+    return (*end == '\0' && parsed >= 0.0) ? parsed : fallback;
+}
+
+void audio_backend_config_default(AudioBackendConfig* config) {
+    memset(config, 0, sizeof(AudioBackendConfig));
+
+    const char* name = g_getenv("TASTEWARP_AUDIO_BACKEND");
+    config->name = (name && *name) ? name : "auto";
+    config->target_latency_ms = env_uint("TASTEWARP_LATENCY_MS", AUDIO_BACKEND_DEFAULT_LATENCY_MS);
+    config->tlength = env_uint("TASTEWARP_PA_TLENGTH", 0);
+    config->minreq = env_uint("TASTEWARP_PA_MINREQ", 0);
+
+    const char* device = g_getenv("TASTEWARP_ALSA_DEVICE");
+    config->device = (device && *device) ? device : "default";
+    config->alsa_period_frames = env_uint("TASTEWARP_ALSA_PERIOD", 0);
+    config->alsa_periods = env_uint("TASTEWARP_ALSA_PERIODS", 0);
+    config->wav_path = g_getenv("TASTEWARP_WAV_OUT");
+    config->drain_rate = env_double("TASTEWARP_DRAIN_RATE", 1.0);
+}
+
+static AudioBackend* try_open(const AudioBackendOps* ops, const AudioBackendConfig* config) {
+    AudioBackend* backend = calloc(1, sizeof(AudioBackend));
+    if (!backend) return NULL;
+
+    backend->ops = ops;
+    backend->config = *config;
+
+    if (!ops->open(backend)) {
+        free(backend);
+        return NULL;
+    }
+
+    printf("Audio backend: %s\n", ops->name);
+    return backend;
+}
+
+AudioBackend* audio_backend_open(const AudioBackendConfig* config) {
+    if (g_ascii_strcasecmp(config->name, "auto") != 0) {
+        const AudioBackendOps* ops = NULL;
+        for (size_t i = 0; i < G_N_ELEMENTS(all_backends); i++) {
+            if (g_ascii_strcasecmp(config->name, all_backends[i]->name) == 0) {
+                ops = all_backends[i];
+                break;
+            }
+        }
+
+        if (!ops) {
+            fprintf(stderr, "Unknown audio backend '%s', falling back\n", config->name);
+        } else {
+            AudioBackend* backend = try_open(ops, config);
+            if (backend) return backend;
+            fprintf(stderr, "Audio backend '%s' failed to open, falling back\n", config->name);
+        }
+    }
+
+    for (size_t i = 0; i < G_N_ELEMENTS(platform_backends); i++) {
+        AudioBackend* backend = try_open(platform_backends[i], config);
+        if (backend) return backend;
+    }
+
+    return NULL;
+}
+
+void audio_backend_close(AudioBackend* backend) {
+    if (!backend) return;
+    backend->ops->close(backend);
+    free(backend);
+}
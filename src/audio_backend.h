@@ -0,0 +1,64 @@
+#ifndef AUDIO_BACKEND_H
+#define AUDIO_BACKEND_H
+
+#include <stdint.h>
+#include <glib.h>
+
+// Default device latency target, override with TASTEWARP_LATENCY_MS
+#define AUDIO_BACKEND_DEFAULT_LATENCY_MS 20
+
+// Everything a backend needs to open a stream. String fields point at
+// environment values or literals and are never freed.
+typedef struct {
+    const char* name;           // "auto", "pulse", "alsa", "coreaudio", "null" or "wav"
+    uint32_t sample_rate;
+    uint16_t channels;
+    guint target_latency_ms;
+    guint32 tlength;            // PulseAudio bytes, 0 = derive from the latency target
+    guint32 minreq;             // PulseAudio bytes, 0 = derive from tlength
+    const char* device;         // ALSA device name
+    guint alsa_period_frames;   // ALSA period size, 0 = derive from the latency target
+    guint alsa_periods;         // ALSA periods in the hardware ring, 0 = default (2)
+    const char* wav_path;       // File sink output, NULL to discard
+    double drain_rate;          // Null/file sink speed vs. real time, 0 = as fast as possible
+} AudioBackendConfig;
+
+typedef struct AudioBackend AudioBackend;
+
+// Output backend interface. write() takes interleaved S16 frames and may
+// block until the device has room; it returns FALSE once the backend has
+// been paused or has failed so the caller can stop feeding it.
+typedef struct {
+    const char* name;
+    gboolean (*open)(AudioBackend* backend);
+    gboolean (*start)(AudioBackend* backend);
+    void (*pause)(AudioBackend* backend);
+    gboolean (*write)(AudioBackend* backend, const int16_t* samples, size_t frames);
+    guint64 (*latency)(AudioBackend* backend);  // Microseconds queued ahead of the speaker
+    guint (*xruns)(AudioBackend* backend);      // Underruns so far, optional
+    void (*close)(AudioBackend* backend);
+} AudioBackendOps;
+
+struct AudioBackend {
+    const AudioBackendOps* ops;
+    AudioBackendConfig config;
+    void* priv;
+};
+
+#ifdef __APPLE__
+extern const AudioBackendOps coreaudio_backend_ops;
+#else
+extern const AudioBackendOps pulse_backend_ops;
+extern const AudioBackendOps alsa_backend_ops;
+#endif
+extern const AudioBackendOps null_backend_ops;
+extern const AudioBackendOps wav_backend_ops;
+
+void audio_backend_config_default(AudioBackendConfig* config);
+
+// Opens the configured backend, falling back through the platform list and
+// finally to the null sink, so this only returns NULL when out of memory
+AudioBackend* audio_backend_open(const AudioBackendConfig* config);
+void audio_backend_close(AudioBackend* backend);
+
+#endif
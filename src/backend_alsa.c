@@ -0,0 +1,290 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <alsa/asoundlib.h>
+#include "audio_backend.h"
+
+#define ALSA_DEFAULT_PERIODS 2
+#define ALSA_WAIT_MS 100
+
+// Direct ALSA output. Blocks are copied straight into the hardware ring
+// with snd_pcm_mmap_begin/commit, bypassing any sound server; devices that
+// can't do mmap fall back to snd_pcm_writei.
+typedef struct {
+    snd_pcm_t* pcm;
+    gboolean mmap;
+    gboolean can_pause;         // Otherwise pausing drops what is queued
+    snd_pcm_uframes_t period_size;
+    snd_pcm_uframes_t buffer_size;
+    gint paused;
+    gint xruns;
+} AlsaBackend;
+
+// Recover from an underrun (-EPIPE) or suspend (-ESTRPIPE), counting xruns
+static gboolean recover(AlsaBackend* alsa, int err) {
+    if (err == -EPIPE) {
+        int count = g_atomic_int_add(&alsa->xruns, 1) + 1;
+        fprintf(stderr, "ALSA xrun (%d so far)\n", count);
+    }
+    if (snd_pcm_recover(alsa->pcm, err, 1) < 0) {
+        fprintf(stderr, "ALSA recovery failed: %s\n", snd_strerror(err));
+        return FALSE;
+    }
+    return TRUE;
+}
+
+static void alsa_close(AudioBackend* backend) {
+    AlsaBackend* alsa = (AlsaBackend*)backend->priv;
+    if (!alsa) return;
+
+    if (alsa->pcm) {
+        snd_pcm_drop(alsa->pcm);
+        snd_pcm_close(alsa->pcm);
+    }
+    free(alsa);
+    backend->priv = NULL;
+}
+
+static gboolean set_hw_params(AudioBackend* backend) {
+    const AudioBackendConfig* config = &backend->config;
+    AlsaBackend* alsa = (AlsaBackend*)backend->priv;
+    snd_pcm_hw_params_t* hw;
+    int err;
+
+    if (snd_pcm_hw_params_malloc(&hw) < 0) return FALSE;
+    snd_pcm_hw_params_any(alsa->pcm, hw);
+
+    alsa->mmap = snd_pcm_hw_params_set_access(alsa->pcm, hw, SND_PCM_ACCESS_MMAP_INTERLEAVED) >= 0;
+    if (!alsa->mmap &&
+        (err = snd_pcm_hw_params_set_access(alsa->pcm, hw, SND_PCM_ACCESS_RW_INTERLEAVED)) < 0) {
+        goto fail;
+    }
+
+    unsigned int rate = config->sample_rate;
+    if ((err = snd_pcm_hw_params_set_format(alsa->pcm, hw, SND_PCM_FORMAT_S16_LE)) < 0 ||
+        (err = snd_pcm_hw_params_set_channels(alsa->pcm, hw, config->channels)) < 0 ||
+        (err = snd_pcm_hw_params_set_rate_resample(alsa->pcm, hw, 1)) < 0 ||
+        (err = snd_pcm_hw_params_set_rate_near(alsa->pcm, hw, &rate, NULL)) < 0) {
+        goto fail;
+    }
+    if (rate != config->sample_rate) {
+        // The engine renders at the mix rate, so anything else would play at
+        // the wrong speed; let the next backend have a go instead
+        fprintf(stderr, "ALSA device runs at %u Hz instead of %u Hz\n", rate, config->sample_rate);
+        snd_pcm_hw_params_free(hw);
+        return FALSE;
+    }
+
+    // Period size defaults to splitting the latency target across the periods
+    unsigned int periods = config->alsa_periods ? config->alsa_periods : ALSA_DEFAULT_PERIODS;
+    snd_pcm_uframes_t period = config->alsa_period_frames;
+    if (period == 0) {
+        period = (snd_pcm_uframes_t)config->target_latency_ms * config->sample_rate / 1000 / periods;
+        if (period < 32) period = 32;
+    }
+
+    if ((err = snd_pcm_hw_params_set_period_size_near(alsa->pcm, hw, &period, NULL)) < 0 ||
+        (err = snd_pcm_hw_params_set_periods_near(alsa->pcm, hw, &periods, NULL)) < 0 ||
+        (err = snd_pcm_hw_params(alsa->pcm, hw)) < 0) {
+        goto fail;
+    }
+
+    alsa->can_pause = snd_pcm_hw_params_can_pause(hw);
+    snd_pcm_hw_params_get_period_size(hw, &alsa->period_size, NULL);
+    snd_pcm_hw_params_get_buffer_size(hw, &alsa->buffer_size);
+    snd_pcm_hw_params_free(hw);
+    return TRUE;
+
+fail:
+    fprintf(stderr, "ALSA hw params failed: %s\n", snd_strerror(err));
+    snd_pcm_hw_params_free(hw);
+    return FALSE;
+}
+
+static gboolean set_sw_params(AlsaBackend* alsa) {
+    snd_pcm_sw_params_t* sw;
+    int err;
+
+    if (snd_pcm_sw_params_malloc(&sw) < 0) return FALSE;
+
+    // Start once the hardware ring is full, wake the writer every period
+    if ((err = snd_pcm_sw_params_current(alsa->pcm, sw)) < 0 ||
+        (err = snd_pcm_sw_params_set_start_threshold(alsa->pcm, sw, alsa->buffer_size)) < 0 ||
+        (err = snd_pcm_sw_params_set_avail_min(alsa->pcm, sw, alsa->period_size)) < 0 ||
+        (err = snd_pcm_sw_params(alsa->pcm, sw)) < 0) {
+        fprintf(stderr, "ALSA sw params failed: %s\n", snd_strerror(err));
+        snd_pcm_sw_params_free(sw);
+        return FALSE;
+    }
+
+    snd_pcm_sw_params_free(sw);
+    return TRUE;
+}
+
+static gboolean alsa_open(AudioBackend* backend) {
+    const AudioBackendConfig* config = &backend->config;
+    AlsaBackend* alsa = calloc(1, sizeof(AlsaBackend));
+    if (!alsa) return FALSE;
+    backend->priv = alsa;
+
+    int err = snd_pcm_open(&alsa->pcm, config->device, SND_PCM_STREAM_PLAYBACK, 0);
+    if (err < 0) {
+        fprintf(stderr, "snd_pcm_open(%s) failed: %s\n", config->device, snd_strerror(err));
+        alsa->pcm = NULL;
+        alsa_close(backend);
+        return FALSE;
+    }
+
+    if (!set_hw_params(backend) || !set_sw_params(alsa)) {
+        alsa_close(backend);
+        return FALSE;
+    }
+
+    printf("ALSA %s: %s access, period %lu frames x %lu (~%lu ms)\n",
+           config->device, alsa->mmap ? "mmap" : "rw",
+           alsa->period_size, alsa->buffer_size / alsa->period_size,
+           alsa->buffer_size * 1000 / config->sample_rate);
+    return TRUE;
+}
+
+static gboolean alsa_start(AudioBackend* backend) {
+    AlsaBackend* alsa = (AlsaBackend*)backend->priv;
+    g_atomic_int_set(&alsa->paused, 0);
+    switch (snd_pcm_state(alsa->pcm)) {
+        case SND_PCM_STATE_PREPARED:
+        case SND_PCM_STATE_RUNNING:
+            return TRUE;
+        case SND_PCM_STATE_PAUSED:
+            if (snd_pcm_pause(alsa->pcm, 0) >= 0) return TRUE;
+            break;
+        default:
+            break;
+    }
+    return snd_pcm_prepare(alsa->pcm) >= 0;
+}
+
+static void alsa_pause(AudioBackend* backend) {
+    AlsaBackend* alsa = (AlsaBackend*)backend->priv;
+    g_atomic_int_set(&alsa->paused, 1);
+    // Pausing keeps what is queued in the hardware ring, so resuming is
+    // instant. A writer waiting for room notices within ALSA_WAIT_MS. A
+    // stream that hasn't started keeps its queue anyway; devices that can't
+    // pause have to drop it.
+    if (snd_pcm_state(alsa->pcm) != SND_PCM_STATE_RUNNING) return;
+    if (!alsa->can_pause || snd_pcm_pause(alsa->pcm, 1) < 0) {
+        snd_pcm_drop(alsa->pcm);
+    }
+}
+
+// Frames the ring has room for, at least MIN(frames, a period), waiting a
+// while at a time and giving up once paused; < 0 on failure
+static snd_pcm_sframes_t wait_for_room(AlsaBackend* alsa, size_t frames) {
+    while (!g_atomic_int_get(&alsa->paused)) {
+        snd_pcm_sframes_t avail = snd_pcm_avail_update(alsa->pcm);
+        if (avail < 0) {
+            if (!recover(alsa, (int)avail)) return -1;
+            continue;
+        }
+        if ((snd_pcm_uframes_t)avail >= MIN(frames, alsa->period_size)) return avail;
+
+        // Ring is full; kick off a prepared stream, otherwise wait a period
+        if (snd_pcm_state(alsa->pcm) == SND_PCM_STATE_PREPARED) {
+            snd_pcm_start(alsa->pcm);
+            continue;
+        }
+        int err = snd_pcm_wait(alsa->pcm, ALSA_WAIT_MS);
+        if (err < 0 && !recover(alsa, err)) return -1;
+    }
+    return -1;
+}
+
+static gboolean write_rw(AudioBackend* backend, const int16_t* samples, size_t frames) {
+    AlsaBackend* alsa = (AlsaBackend*)backend->priv;
+    size_t channels = backend->config.channels;
+
+    while (frames > 0) {
+        // Only ever write what fits, so writei never blocks past a pause
+        snd_pcm_sframes_t avail = wait_for_room(alsa, frames);
+        if (avail < 0) return FALSE;
+
+        snd_pcm_sframes_t written = snd_pcm_writei(alsa->pcm, samples, MIN(frames, (size_t)avail));
+        if (written < 0) {
+            if (!recover(alsa, (int)written)) return FALSE;
+            continue;
+        }
+
+        samples += written * channels;
+        frames -= written;
+    }
+
+    return TRUE;
+}
+
+static gboolean write_mmap(AudioBackend* backend, const int16_t* samples, size_t frames) {
+    AlsaBackend* alsa = (AlsaBackend*)backend->priv;
+    size_t frame_bytes = backend->config.channels * sizeof(int16_t);
+
+    while (frames > 0) {
+        snd_pcm_sframes_t avail = wait_for_room(alsa, frames);
+        if (avail < 0) return FALSE;
+
+        snd_pcm_uframes_t remaining = MIN(frames, (size_t)avail);
+        while (remaining > 0) {
+            const snd_pcm_channel_area_t* areas;
+            snd_pcm_uframes_t offset;
+            snd_pcm_uframes_t chunk = remaining;
+
+            int err = snd_pcm_mmap_begin(alsa->pcm, &areas, &offset, &chunk);
+            if (err < 0) {
+                if (!recover(alsa, err)) return FALSE;
+                break;
+            }
+
+            // Interleaved access: one area describes every channel
+            uint8_t* dst = (uint8_t*)areas[0].addr + areas[0].first / 8 + offset * areas[0].step / 8;
+            memcpy(dst, samples, chunk * frame_bytes);
+
+            snd_pcm_sframes_t committed = snd_pcm_mmap_commit(alsa->pcm, offset, chunk);
+            if (committed < 0) {
+                if (!recover(alsa, (int)committed)) return FALSE;
+                break;
+            }
+
+            // A short commit is not an error; the rest goes round again
+            samples += committed * backend->config.channels;
+            frames -= committed;
+            remaining -= committed;
+            if ((snd_pcm_uframes_t)committed < chunk) break;
+        }
+    }
+
+    return TRUE;
+}
+
+static gboolean alsa_write(AudioBackend* backend, const int16_t* samples, size_t frames) {
+    AlsaBackend* alsa = (AlsaBackend*)backend->priv;
+    return alsa->mmap ? write_mmap(backend, samples, frames) : write_rw(backend, samples, frames);
+}
+
+static guint64 alsa_latency(AudioBackend* backend) {
+    AlsaBackend* alsa = (AlsaBackend*)backend->priv;
+    snd_pcm_sframes_t delay = 0;
+    if (snd_pcm_delay(alsa->pcm, &delay) < 0 || delay < 0) return 0;
+    return (guint64)delay * G_USEC_PER_SEC / backend->config.sample_rate;
+}
+
+static guint alsa_xruns(AudioBackend* backend) {
+    AlsaBackend* alsa = (AlsaBackend*)backend->priv;
+    return (guint)g_atomic_int_get(&alsa->xruns);
+}
+
+const AudioBackendOps alsa_backend_ops = {
+    .name = "alsa",
+    .open = alsa_open,
+    .start = alsa_start,
+    .pause = alsa_pause,
+    .write = alsa_write,
+    .latency = alsa_latency,
+    .xruns = alsa_xruns,
+    .close = alsa_close,
+};
@@ -0,0 +1,220 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <AudioToolbox/AudioToolbox.h>
+#include "audio_backend.h"
+#include "ringbuffer.h"
+
+#define COREAUDIO_SLOT_FRAMES 256
+
+// CoreAudio pulls from a render callback, so write() hands blocks to it
+// through a lock-free ring and only sleeps when that ring is full
+typedef struct {
+    size_t frames;
+    int16_t samples[];
+} CoreAudioBlock;
+
+typedef struct {
+    AudioUnit unit;
+    gboolean running;
+    RingBuffer* ring;
+    const CoreAudioBlock* current;  // Block partially consumed by the callback
+    size_t current_offset;
+    gint paused;
+    gint flush;                     // Callback drops queued blocks before playing
+} CoreAudioBackend;
+
+static OSStatus render_callback(void* inRefCon,
+                                AudioUnitRenderActionFlags* ioActionFlags,
+                                const AudioTimeStamp* inTimeStamp,
+                                UInt32 inBusNumber,
+                                UInt32 inNumberFrames,
+                                AudioBufferList* ioData) {
+    (void)ioActionFlags;
+    (void)inTimeStamp;
+    (void)inBusNumber;
+
+    AudioBackend* backend = (AudioBackend*)inRefCon;
+    CoreAudioBackend* ca = (CoreAudioBackend*)backend->priv;
+    float* out = (float*)ioData->mBuffers[0].mData;
+    size_t channels = backend->config.channels;
+    UInt32 frame = 0;
+
+    if (g_atomic_int_get(&ca->flush)) {
+        while (ring_buffer_read_slot(ca->ring)) ring_buffer_commit_read(ca->ring);
+        ca->current = NULL;
+        g_atomic_int_set(&ca->flush, 0);
+    }
+
+    while (frame < inNumberFrames) {
+        if (!ca->current) {
+            ca->current = ring_buffer_read_slot(ca->ring);
+            ca->current_offset = 0;
+            if (!ca->current) break;  // Underrun, pad with silence
+        }
+
+        const CoreAudioBlock* block = ca->current;
+        size_t chunk = MIN(inNumberFrames - frame, block->frames - ca->current_offset);
+        const int16_t* src = block->samples + ca->current_offset * channels;
+        for (size_t i = 0; i < chunk * channels; i++) {
+            out[frame * channels + i] = src[i] / 32768.0f;
+        }
+
+        frame += chunk;
+        ca->current_offset += chunk;
+
+        if (ca->current_offset >= block->frames) {
+            ring_buffer_commit_read(ca->ring);
+            ca->current = NULL;
+        }
+    }
+
+    if (frame < inNumberFrames) {
+        memset(out + frame * channels, 0, (inNumberFrames - frame) * channels * sizeof(float));
+    }
+
+    return noErr;
+}
+
+static void coreaudio_close(AudioBackend* backend) {
+    CoreAudioBackend* ca = (CoreAudioBackend*)backend->priv;
+    if (!ca) return;
+
+    if (ca->unit) {
+        AudioOutputUnitStop(ca->unit);
+        AudioUnitUninitialize(ca->unit);
+        AudioComponentInstanceDispose(ca->unit);
+    }
+    ring_buffer_free(ca->ring);
+    free(ca);
+    backend->priv = NULL;
+}
+
+static gboolean coreaudio_open(AudioBackend* backend) {
+    const AudioBackendConfig* config = &backend->config;
+    CoreAudioBackend* ca = calloc(1, sizeof(CoreAudioBackend));
+    if (!ca) return FALSE;
+    backend->priv = ca;
+
+    // Enough slots to hold the latency target, plus headroom
+    size_t latency_frames = (size_t)config->target_latency_ms * config->sample_rate / 1000;
+    size_t slots = latency_frames / COREAUDIO_SLOT_FRAMES + 2;
+    ca->ring = ring_buffer_new(sizeof(CoreAudioBlock) +
+                               COREAUDIO_SLOT_FRAMES * config->channels * sizeof(int16_t),
+                               slots);
+    if (!ca->ring) goto fail;
+
+    AudioComponentDescription desc = {
+        .componentType = kAudioUnitType_Output,
+        .componentSubType = kAudioUnitSubType_DefaultOutput,
+        .componentManufacturer = kAudioUnitManufacturer_Apple,
+        .componentFlags = 0,
+        .componentFlagsMask = 0
+    };
+
+    AudioComponent comp = AudioComponentFindNext(NULL, &desc);
+    if (!comp) goto fail;
+
+    if (AudioComponentInstanceNew(comp, &ca->unit) != noErr) {
+        ca->unit = NULL;
+        goto fail;
+    }
+
+    AURenderCallbackStruct callback = {
+        .inputProc = render_callback,
+        .inputProcRefCon = backend
+    };
+
+    OSStatus status = AudioUnitSetProperty(ca->unit,
+                                           kAudioUnitProperty_SetRenderCallback,
+                                           kAudioUnitScope_Input,
+                                           0,
+                                           &callback,
+                                           sizeof(callback));
+    if (status != noErr) goto fail;
+
+    AudioStreamBasicDescription format = {
+        .mSampleRate = config->sample_rate,
+        .mFormatID = kAudioFormatLinearPCM,
+        .mFormatFlags = kAudioFormatFlagIsFloat | kAudioFormatFlagIsPacked,
+        .mFramesPerPacket = 1,
+        .mChannelsPerFrame = config->channels,
+        .mBitsPerChannel = 32,
+        .mBytesPerPacket = 4 * config->channels,
+        .mBytesPerFrame = 4 * config->channels
+    };
+
+    status = AudioUnitSetProperty(ca->unit,
+                                  kAudioUnitProperty_StreamFormat,
+                                  kAudioUnitScope_Input,
+                                  0,
+                                  &format,
+                                  sizeof(format));
+    if (status != noErr) goto fail;
+
+    if (AudioUnitInitialize(ca->unit) != noErr) goto fail;
+
+    return TRUE;
+
+fail:
+    fprintf(stderr, "CoreAudio output setup failed\n");
+    coreaudio_close(backend);
+    return FALSE;
+}
+
+static gboolean coreaudio_start(AudioBackend* backend) {
+    CoreAudioBackend* ca = (CoreAudioBackend*)backend->priv;
+    g_atomic_int_set(&ca->paused, 0);
+    if (!ca->running) {
+        ca->running = (AudioOutputUnitStart(ca->unit) == noErr);
+    }
+    return ca->running;
+}
+
+static void coreaudio_pause(AudioBackend* backend) {
+    CoreAudioBackend* ca = (CoreAudioBackend*)backend->priv;
+    g_atomic_int_set(&ca->paused, 1);
+    g_atomic_int_set(&ca->flush, 1);
+    if (ca->running) {
+        AudioOutputUnitStop(ca->unit);
+        ca->running = FALSE;
+    }
+}
+
+static gboolean coreaudio_write(AudioBackend* backend, const int16_t* samples, size_t frames) {
+    CoreAudioBackend* ca = (CoreAudioBackend*)backend->priv;
+    size_t channels = backend->config.channels;
+
+    while (frames > 0) {
+        CoreAudioBlock* block;
+        while (!(block = ring_buffer_write_slot(ca->ring))) {
+            if (g_atomic_int_get(&ca->paused)) return FALSE;
+            g_usleep(1000);
+        }
+
+        block->frames = MIN(frames, COREAUDIO_SLOT_FRAMES);
+        memcpy(block->samples, samples, block->frames * channels * sizeof(int16_t));
+        ring_buffer_commit_write(ca->ring);
+
+        samples += block->frames * channels;
+        frames -= block->frames;
+    }
+
+    return TRUE;
+}
+
+static guint64 coreaudio_latency(AudioBackend* backend) {
+    CoreAudioBackend* ca = (CoreAudioBackend*)backend->priv;
+    guint64 queued = ring_buffer_count(ca->ring) * COREAUDIO_SLOT_FRAMES;
+    return queued * G_USEC_PER_SEC / backend->config.sample_rate;
+}
+
+const AudioBackendOps coreaudio_backend_ops = {
+    .name = "coreaudio",
+    .open = coreaudio_open,
+    .start = coreaudio_start,
+    .pause = coreaudio_pause,
+    .write = coreaudio_write,
+    .latency = coreaudio_latency,
+    .close = coreaudio_close,
+};
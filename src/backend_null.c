@@ -0,0 +1,140 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "audio_backend.h"
+#include "wavfile.h"
+
+#define DEFAULT_WAV_OUT "tastewarp_output.wav"
+
+// Headless sinks: "null" discards audio, "wav" streams it to a file. Both
+// consume at drain_rate times real time, or as fast as possible when it is 0,
+// so the engine can run and be benchmarked without a sound server.
+typedef struct {
+    FILE* file;
+    guint64 frames_written;     // Since the last start()
+    gint64 start_time;
+    guint32 data_bytes;         // Total written to the file's data chunk
+    guint32 max_data_bytes;     // What a RIFF file can hold; the rest is dropped
+    gint paused;
+} NullBackend;
+
+static void write_wav_header(NullBackend* sink, const AudioBackendConfig* config) {
+    fseek(sink->file, 0, SEEK_SET);
+    if (!wav_write_header(sink->file, WAV_FORMAT_PCM, config->channels, config->sample_rate, 16,
+                          sink->data_bytes)) {
+        fprintf(stderr, "Error writing WAV sink header\n");
+    }
+    fseek(sink->file, 0, SEEK_END);
+}
+
+static gboolean null_open(AudioBackend* backend) {
+    NullBackend* sink = calloc(1, sizeof(NullBackend));
+    if (!sink) return FALSE;
+    backend->priv = sink;
+    return TRUE;
+}
+
+static gboolean wav_open(AudioBackend* backend) {
+    const char* path = backend->config.wav_path ? backend->config.wav_path : DEFAULT_WAV_OUT;
+
+    NullBackend* sink = calloc(1, sizeof(NullBackend));
+    if (!sink) return FALSE;
+
+    sink->file = fopen(path, "wb");
+    if (!sink->file) {
+        fprintf(stderr, "Error opening WAV sink %s (%s)\n", path, strerror(errno));
+        free(sink);
+        return FALSE;
+    }
+
+    // Placeholder sizes, patched on close
+    sink->max_data_bytes = wav_max_data_bytes(WAV_FORMAT_PCM, backend->config.channels * sizeof(int16_t));
+    write_wav_header(sink, &backend->config);
+    backend->priv = sink;
+    printf("Writing audio to %s\n", path);
+    return TRUE;
+}
+
+static void null_close(AudioBackend* backend) {
+    NullBackend* sink = (NullBackend*)backend->priv;
+    if (!sink) return;
+
+    if (sink->file) {
+        write_wav_header(sink, &backend->config);
+        fclose(sink->file);
+    }
+    free(sink);
+    backend->priv = NULL;
+}
+
+static gboolean null_start(AudioBackend* backend) {
+    NullBackend* sink = (NullBackend*)backend->priv;
+    sink->frames_written = 0;
+    sink->start_time = g_get_monotonic_time();
+    g_atomic_int_set(&sink->paused, 0);
+    return TRUE;
+}
+
+static void null_pause(AudioBackend* backend) {
+    NullBackend* sink = (NullBackend*)backend->priv;
+    g_atomic_int_set(&sink->paused, 1);
+}
+
+static gboolean null_write(AudioBackend* backend, const int16_t* samples, size_t frames) {
+    NullBackend* sink = (NullBackend*)backend->priv;
+    const AudioBackendConfig* config = &backend->config;
+    if (g_atomic_int_get(&sink->paused)) return FALSE;
+
+    if (sink->file && sink->data_bytes < sink->max_data_bytes) {
+        // Stop at the RIFF size limit rather than wrap the header's sizes
+        size_t bytes = MIN(frames * config->channels * sizeof(int16_t),
+                           (size_t)(sink->max_data_bytes - sink->data_bytes));
+        if (fwrite(samples, bytes, 1, sink->file) != 1) {
+            fprintf(stderr, "Error writing WAV sink data\n");
+            return FALSE;
+        }
+        sink->data_bytes += bytes;
+        if (sink->data_bytes == sink->max_data_bytes) {
+            fprintf(stderr, "WAV sink is at the 4 GiB RIFF limit; the rest is not recorded\n");
+        }
+    }
+
+    sink->frames_written += frames;
+
+    // Pace the consumer like a device running at drain_rate x real time
+    if (config->drain_rate > 0.0) {
+        gint64 due = sink->start_time +
+                     (gint64)(sink->frames_written * G_USEC_PER_SEC /
+                              (config->sample_rate * config->drain_rate));
+        gint64 now = g_get_monotonic_time();
+        if (due > now) g_usleep((gulong)(due - now));
+    }
+
+    return TRUE;
+}
+
+static guint64 null_latency(AudioBackend* backend) {
+    (void)backend;
+    return 0;
+}
+
+const AudioBackendOps null_backend_ops = {
+    .name = "null",
+    .open = null_open,
+    .start = null_start,
+    .pause = null_pause,
+    .write = null_write,
+    .latency = null_latency,
+    .close = null_close,
+};
+
+const AudioBackendOps wav_backend_ops = {
+    .name = "wav",
+    .open = wav_open,
+    .start = null_start,
+    .pause = null_pause,
+    .write = null_write,
+    .latency = null_latency,
+    .close = null_close,
+};
@@ -0,0 +1,244 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <pulse/pulseaudio.h>
+#include "audio_backend.h"
+
+// PulseAudio output through a threaded mainloop and an async stream with
+// explicit buffer attributes (pa_simple's defaults give ~2 s of latency)
+typedef struct {
+    pa_threaded_mainloop* mainloop;
+    pa_context* context;
+    pa_stream* stream;
+    pa_sample_spec spec;
+    gint paused;        // Set by pause() to release a blocked write()
+    gint underruns;
+} PulseBackend;
+
+static void context_state_cb(pa_context* context, void* userdata) {
+    (void)context;
+    PulseBackend* pulse = (PulseBackend*)userdata;
+    pa_threaded_mainloop_signal(pulse->mainloop, 0);
+}
+
+static void stream_state_cb(pa_stream* stream, void* userdata) {
+    (void)stream;
+    PulseBackend* pulse = (PulseBackend*)userdata;
+    pa_threaded_mainloop_signal(pulse->mainloop, 0);
+}
+
+// Runs on the PulseAudio thread whenever the server wants more data
+static void stream_write_cb(pa_stream* stream, size_t nbytes, void* userdata) {
+    (void)stream;
+    (void)nbytes;
+    PulseBackend* pulse = (PulseBackend*)userdata;
+    pa_threaded_mainloop_signal(pulse->mainloop, 0);
+}
+
+static void stream_underflow_cb(pa_stream* stream, void* userdata) {
+    (void)stream;
+    PulseBackend* pulse = (PulseBackend*)userdata;
+    g_atomic_int_inc(&pulse->underruns);
+}
+
+static gboolean wait_context_ready(PulseBackend* pulse) {
+    for (;;) {
+        pa_context_state_t state = pa_context_get_state(pulse->context);
+        if (state == PA_CONTEXT_READY) return TRUE;
+        if (!PA_CONTEXT_IS_GOOD(state)) return FALSE;
+        pa_threaded_mainloop_wait(pulse->mainloop);
+    }
+}
+
+static gboolean wait_stream_ready(PulseBackend* pulse) {
+    for (;;) {
+        pa_stream_state_t state = pa_stream_get_state(pulse->stream);
+        if (state == PA_STREAM_READY) return TRUE;
+        if (!PA_STREAM_IS_GOOD(state)) return FALSE;
+        pa_threaded_mainloop_wait(pulse->mainloop);
+    }
+}
+
+static void cork_stream(PulseBackend* pulse, gboolean cork) {
+    pa_threaded_mainloop_lock(pulse->mainloop);
+    pa_operation* op = pa_stream_cork(pulse->stream, cork, NULL, NULL);
+    if (op) pa_operation_unref(op);
+    pa_threaded_mainloop_unlock(pulse->mainloop);
+}
+
+static void pulse_close(AudioBackend* backend) {
+    PulseBackend* pulse = (PulseBackend*)backend->priv;
+    if (!pulse) return;
+
+    if (pulse->mainloop) {
+        pa_threaded_mainloop_stop(pulse->mainloop);
+    }
+    if (pulse->stream) {
+        pa_stream_disconnect(pulse->stream);
+        pa_stream_unref(pulse->stream);
+    }
+    if (pulse->context) {
+        pa_context_disconnect(pulse->context);
+        pa_context_unref(pulse->context);
+    }
+    if (pulse->mainloop) {
+        pa_threaded_mainloop_free(pulse->mainloop);
+    }
+
+    free(pulse);
+    backend->priv = NULL;
+}
+
+static gboolean pulse_open(AudioBackend* backend) {
+    const AudioBackendConfig* config = &backend->config;
+    PulseBackend* pulse = calloc(1, sizeof(PulseBackend));
+    if (!pulse) return FALSE;
+    backend->priv = pulse;
+
+    pulse->spec.format = PA_SAMPLE_S16LE;
+    pulse->spec.rate = config->sample_rate;
+    pulse->spec.channels = config->channels;
+
+    pulse->mainloop = pa_threaded_mainloop_new();
+    if (!pulse->mainloop) goto fail;
+
+    pulse->context = pa_context_new(pa_threaded_mainloop_get_api(pulse->mainloop), "TasteWarp");
+    if (!pulse->context) goto fail;
+    pa_context_set_state_callback(pulse->context, context_state_cb, pulse);
+
+    // Don't autospawn a daemon on boxes that have no sound server
+    if (pa_context_connect(pulse->context, NULL, PA_CONTEXT_NOAUTOSPAWN, NULL) < 0 ||
+        pa_threaded_mainloop_start(pulse->mainloop) < 0) {
+        goto fail;
+    }
+
+    pa_threaded_mainloop_lock(pulse->mainloop);
+
+    if (!wait_context_ready(pulse)) goto fail_locked;
+
+    pulse->stream = pa_stream_new(pulse->context, "Music", &pulse->spec, NULL);
+    if (!pulse->stream) goto fail_locked;
+
+    pa_stream_set_state_callback(pulse->stream, stream_state_cb, pulse);
+    pa_stream_set_write_callback(pulse->stream, stream_write_cb, pulse);
+    pa_stream_set_underflow_callback(pulse->stream, stream_underflow_cb, pulse);
+
+    // Ask for a small server-side buffer instead of the ~2 s default
+    pa_buffer_attr attr = {
+        .maxlength = (uint32_t)-1,
+        .tlength = config->tlength,
+        .prebuf = (uint32_t)-1,
+        .minreq = config->minreq,
+        .fragsize = (uint32_t)-1
+    };
+    if (attr.tlength == 0) {
+        attr.tlength = pa_usec_to_bytes((pa_usec_t)config->target_latency_ms * PA_USEC_PER_MSEC,
+                                        &pulse->spec);
+    }
+    if (attr.minreq == 0) {
+        attr.minreq = attr.tlength / 4;
+    }
+
+    pa_stream_flags_t flags = PA_STREAM_INTERPOLATE_TIMING |
+                              PA_STREAM_AUTO_TIMING_UPDATE |
+                              PA_STREAM_ADJUST_LATENCY |
+                              PA_STREAM_START_CORKED;
+
+    if (pa_stream_connect_playback(pulse->stream, NULL, &attr, flags, NULL, NULL) < 0 ||
+        !wait_stream_ready(pulse)) {
+        goto fail_locked;
+    }
+
+    const pa_buffer_attr* granted = pa_stream_get_buffer_attr(pulse->stream);
+    if (granted) {
+        printf("PulseAudio buffer: tlength %u bytes, minreq %u bytes (~%llu ms)\n",
+               granted->tlength, granted->minreq,
+               (unsigned long long)(pa_bytes_to_usec(granted->tlength, &pulse->spec) / PA_USEC_PER_MSEC));
+    }
+
+    pa_threaded_mainloop_unlock(pulse->mainloop);
+    return TRUE;
+
+fail_locked:
+    pa_threaded_mainloop_unlock(pulse->mainloop);
+fail:
+    fprintf(stderr, "PulseAudio stream setup failed: %s\n",
+            pulse->context ? pa_strerror(pa_context_errno(pulse->context)) : "out of memory");
+    pulse_close(backend);
+    return FALSE;
+}
+
+static gboolean pulse_start(AudioBackend* backend) {
+    PulseBackend* pulse = (PulseBackend*)backend->priv;
+    g_atomic_int_set(&pulse->paused, 0);
+    cork_stream(pulse, FALSE);
+    return TRUE;
+}
+
+static void pulse_pause(AudioBackend* backend) {
+    PulseBackend* pulse = (PulseBackend*)backend->priv;
+    g_atomic_int_set(&pulse->paused, 1);
+
+    // Cork without flushing: what the server has queued plays on resume
+    pa_threaded_mainloop_lock(pulse->mainloop);
+    pa_operation* op = pa_stream_cork(pulse->stream, 1, NULL, NULL);
+    if (op) pa_operation_unref(op);
+
+    // Wake a write() waiting for stream space
+    pa_threaded_mainloop_signal(pulse->mainloop, 0);
+    pa_threaded_mainloop_unlock(pulse->mainloop);
+}
+
+static gboolean pulse_write(AudioBackend* backend, const int16_t* samples, size_t frames) {
+    PulseBackend* pulse = (PulseBackend*)backend->priv;
+    size_t bytes = frames * backend->config.channels * sizeof(int16_t);
+    gboolean ok = TRUE;
+
+    pa_threaded_mainloop_lock(pulse->mainloop);
+    while (!g_atomic_int_get(&pulse->paused) &&
+           PA_STREAM_IS_GOOD(pa_stream_get_state(pulse->stream)) &&
+           pa_stream_writable_size(pulse->stream) < bytes) {
+        pa_threaded_mainloop_wait(pulse->mainloop);
+    }
+
+    if (g_atomic_int_get(&pulse->paused) ||
+        !PA_STREAM_IS_GOOD(pa_stream_get_state(pulse->stream))) {
+        ok = FALSE;
+    } else if (pa_stream_write(pulse->stream, samples, bytes, NULL, 0, PA_SEEK_RELATIVE) < 0) {
+        fprintf(stderr, "pa_stream_write() failed: %s\n",
+                pa_strerror(pa_context_errno(pulse->context)));
+        ok = FALSE;
+    }
+    pa_threaded_mainloop_unlock(pulse->mainloop);
+
+    return ok;
+}
+
+static guint64 pulse_latency(AudioBackend* backend) {
+    PulseBackend* pulse = (PulseBackend*)backend->priv;
+    pa_usec_t latency = 0;
+    int negative = 0;
+
+    pa_threaded_mainloop_lock(pulse->mainloop);
+    if (pa_stream_get_latency(pulse->stream, &latency, &negative) < 0 || negative) {
+        latency = 0;
+    }
+    pa_threaded_mainloop_unlock(pulse->mainloop);
+
+    return latency;
+}
+
+static guint pulse_xruns(AudioBackend* backend) {
+    PulseBackend* pulse = (PulseBackend*)backend->priv;
+    return (guint)g_atomic_int_get(&pulse->underruns);
+}
+
+const AudioBackendOps pulse_backend_ops = {
+    .name = "pulse",
+    .open = pulse_open,
+    .start = pulse_start,
+    .pause = pulse_pause,
+    .write = pulse_write,
+    .latency = pulse_latency,
+    .xruns = pulse_xruns,
+    .close = pulse_close,
+};
@@ -0,0 +1,140 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "delay_line.h"
+
+#define DELAY_LINE_BLOCK 1024      // Frames mixed per pass at most
+#define DELAY_LINE_MAX_LOOP 0.95f   // Most a trip round the feedback loop may keep
+
+struct DelayLine {
+    uint16_t channels;
+    uint32_t sample_rate;
+    double max_delay;       // Frames
+    size_t mask;            // Line length - 1, a power of two
+    size_t pos;             // Where the next frame is written
+    float** line;           // Per channel
+    float wet[DELAY_LINE_BLOCK];    // Panned taps, added to the output
+    float loop[DELAY_LINE_BLOCK];   // Unpanned taps, fed back into the line
+};
+
+typedef struct {
+    size_t whole;
+    float frac;
+    float gain;
+    float pan;
+} TapPlan;
+
+DelayLine* delay_line_new(uint32_t sample_rate, uint16_t channels, float max_delay_ms) {
+    if (sample_rate == 0 || channels == 0 || max_delay_ms < 0.0f) return NULL;
+
+    DelayLine* dl = calloc(1, sizeof(DelayLine));
+    if (!dl) return NULL;
+
+    dl->channels = channels;
+    dl->sample_rate = sample_rate;
+    dl->max_delay = MAX(max_delay_ms * sample_rate / 1000.0, 1.0);
+
+    // Room for the longest delay plus the frame it interpolates towards
+    size_t size = 1;
+    while (size < (size_t)ceil(dl->max_delay) + 2) size <<= 1;
+    dl->mask = size - 1;
+
+    dl->line = calloc(channels, sizeof(float*));
+    if (!dl->line) {
+        free(dl);
+        return NULL;
+    }
+    for (uint16_t ch = 0; ch < channels; ch++) {
+        dl->line[ch] = calloc(size, sizeof(float));
+        if (!dl->line[ch]) {
+            delay_line_free(dl);
+            return NULL;
+        }
+    }
+    return dl;
+}
+
+void delay_line_free(DelayLine* dl) {
+    if (!dl) return;
+
+    if (dl->line) {
+        for (uint16_t ch = 0; ch < dl->channels; ch++) {
+            free(dl->line[ch]);
+        }
+        free(dl->line);
+    }
+    free(dl);
+}
+
+void delay_line_reset(DelayLine* dl) {
+    if (!dl) return;
+
+    for (uint16_t ch = 0; ch < dl->channels; ch++) {
+        memset(dl->line[ch], 0, (dl->mask + 1) * sizeof(float));
+    }
+    dl->pos = 0;
+}
+
+// Linear balance: the far side fades out, centre leaves both at unity
+static float pan_gain(float pan, uint16_t channel, uint16_t channels) {
+    if (channels < 2) return 1.0f;
+    pan = CLAMP(pan, -1.0f, 1.0f);
+    if (channel % 2 == 0) return pan > 0.0f ? 1.0f - pan : 1.0f;
+    return pan < 0.0f ? 1.0f + pan : 1.0f;
+}
+
+void delay_line_process(DelayLine* dl, const DelayTap* taps, guint tap_count, float feedback,
+                        float* const* samples, size_t frames) {
+    if (!dl || frames == 0) return;
+    tap_count = taps ? MIN(tap_count, DELAY_LINE_MAX_TAPS) : 0;
+
+    TapPlan plan[DELAY_LINE_MAX_TAPS];
+    size_t step = DELAY_LINE_BLOCK;
+    float loop_gain = 0.0f;
+    for (guint k = 0; k < tap_count; k++) {
+        double delay = CLAMP(taps[k].delay_ms * dl->sample_rate / 1000.0, 1.0, dl->max_delay);
+        plan[k].whole = (size_t)delay;
+        plan[k].frac = (float)(delay - plan[k].whole);
+        plan[k].gain = taps[k].gain;
+        plan[k].pan = taps[k].pan;
+        step = MIN(step, plan[k].whole);
+        loop_gain += fabsf(taps[k].gain);
+    }
+    feedback = CLAMP(feedback, 0.0f, 1.0f);
+    if (feedback * loop_gain > DELAY_LINE_MAX_LOOP) feedback = DELAY_LINE_MAX_LOOP / loop_gain;
+
+    // Passes no longer than the shortest delay only read frames written by
+    // earlier passes, so each tap is a plain loop rather than a per-frame
+    // dependency on the line
+    for (uint16_t ch = 0; ch < dl->channels; ch++) {
+        float* line = dl->line[ch];
+        float* out = samples[ch];
+        for (size_t start = 0; start < frames; start += step) {
+            size_t n = MIN(step, frames - start);
+            size_t write = dl->pos + start;
+            memset(dl->wet, 0, n * sizeof(float));
+            memset(dl->loop, 0, n * sizeof(float));
+
+            for (guint k = 0; k < tap_count; k++) {
+                size_t read = write - plan[k].whole + dl->mask + 1;
+                float frac = plan[k].frac;
+                float gain = plan[k].gain;
+                float panned = gain * pan_gain(plan[k].pan, ch, dl->channels);
+                for (size_t i = 0; i < n; i++) {
+                    float near = line[(read + i) & dl->mask];
+                    float far = line[(read + i - 1) & dl->mask];
+                    float v = near + (far - near) * frac;
+                    dl->wet[i] += panned * v;
+                    dl->loop[i] += gain * v;
+                }
+            }
+
+            for (size_t i = 0; i < n; i++) {
+                float x = out[start + i];
+                line[(write + i) & dl->mask] = x + feedback * dl->loop[i];
+                out[start + i] = x + dl->wet[i];
+            }
+        }
+    }
+    dl->pos = (dl->pos + frames) & dl->mask;
+}
@@ -0,0 +1,38 @@
+#ifndef DELAY_LINE_H
+#define DELAY_LINE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <glib.h>
+
+// Streaming multi-tap feedback delay for planar float audio. Memory is one
+// line per channel as long as the longest delay, whatever the input length.
+//
+// Per channel, with w the line and taps k at delay d_k with gain g_k:
+//   w[n] = x[n] + feedback * sum(g_k * w[n - d_k])
+//   y[n] = x[n] + sum(g_k * pan_k * w[n - d_k])
+// Delays are fractional (linearly interpolated) and at least one frame.
+
+#define DELAY_LINE_MAX_TAPS 8
+
+typedef struct {
+    float delay_ms;
+    float gain;
+    float pan;      // -1 left .. 1 right; even channels count as left, odd as right
+} DelayTap;
+
+typedef struct DelayLine DelayLine;
+
+DelayLine* delay_line_new(uint32_t sample_rate, uint16_t channels, float max_delay_ms);
+void delay_line_free(DelayLine* dl);
+
+// Silence the line, as if freshly created
+void delay_line_reset(DelayLine* dl);
+
+// Run one block in place. Delays are clamped to the line, and feedback to
+// 0..1 and low enough that the echoes always die away. Taps and feedback may
+// change from call to call.
+void delay_line_process(DelayLine* dl, const DelayTap* taps, guint tap_count, float feedback,
+                        float* const* samples, size_t frames);
+
+#endif
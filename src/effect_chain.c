@@ -0,0 +1,701 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "effect_chain.h"
+#include "effects.h"
+#include "ringbuffer.h"
+#include "fft_plans.h"
+#include "delay_line.h"
+#include "time_stretch.h"
+#include "rng.h"
+#include "oscillator.h"
+
+#define COMMAND_SLOTS 64
+#define GARBAGE_SLOTS (2 * COMMAND_SLOTS)
+
+#define TEMPO_MIN ((float)TIME_STRETCH_MIN_SPEED)
+#define TEMPO_MAX ((float)TIME_STRETCH_MAX_SPEED)
+#define GAIN_MIN_DB -48.0f
+#define GAIN_MAX_DB 24.0f
+#define ECHO_MAX_MS 2000.0f
+#define ECHO_SPREAD_PAN 0.5f // How far the shorter echo taps lean to each side
+#define PITCH_WINDOW 2048
+#define PITCH_HOP (PITCH_WINDOW / 4)
+#define PITCH_BINS (PITCH_WINDOW / 2 + 1)
+#define FUSE_TILE 256       // Frames every stage of a fused run sees before moving on
+
+typedef struct {
+    const char* name;
+    gboolean (*init)(EffectNode* node);
+    // Pull from `upstream` (the number of nodes ahead of this one) and write out
+    void (*process)(EffectChain* chain, EffectNode* node, guint upstream,
+                    float* const* out, size_t frames);
+    void (*finalize)(EffectNode* node);
+    // Pointwise nodes have no process; pull() runs each run of them as one
+    // fused pass. begin reads the parameters once per block, then apply
+    // works in place on frames [offset, offset + frames) of one channel.
+    void (*begin)(EffectNode* node, size_t frames);
+    void (*apply)(EffectNode* node, float* samples, size_t offset, size_t frames);
+} EffectNodeOps;
+
+struct EffectNode {
+    const EffectNodeOps* ops;
+    EffectType type;
+    float params[EFFECT_MAX_PARAMS];    // Accessed atomically
+    uint32_t sample_rate;
+    uint16_t channels;
+    Rng rng;                            // Render thread only
+    void* state;                        // Per-type, render thread only
+};
+
+typedef enum {
+    COMMAND_ADD,
+    COMMAND_REMOVE
+} CommandOp;
+
+typedef struct {
+    CommandOp op;
+    EffectNode* node;
+} Command;
+
+struct EffectChain {
+    uint32_t sample_rate;
+    uint16_t channels;
+    RingBuffer* commands;       // UI -> render
+    RingBuffer* garbage;        // Render -> UI: nodes safe to free
+    GList* ui_nodes;            // UI thread's view of the chain, in order
+
+    // Render thread only
+    EffectNode* nodes[EFFECT_CHAIN_MAX_NODES];
+    guint count;
+    EffectSourceFunc source;
+    gpointer source_data;
+};
+
+static void pull(EffectChain* chain, guint upstream, float* const* out, size_t frames);
+
+static float* plane_new(size_t frames) {
+    return calloc(frames, sizeof(float));
+}
+
+static void planes_free(float** planes, uint16_t channels) {
+    for (uint16_t ch = 0; ch < channels; ch++) {
+        free(planes[ch]);
+    }
+}
+
+static gboolean planes_alloc(float** planes, uint16_t channels, size_t frames) {
+    for (uint16_t ch = 0; ch < channels; ch++) {
+        planes[ch] = plane_new(frames);
+        if (!planes[ch]) {
+            planes_free(planes, ch);
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+// ---- Pointwise nodes: fused, see pull_fused() ----
+
+typedef struct {
+    float amount;               // This block's parameter
+} PointwiseState;
+
+static gboolean pointwise_init(EffectNode* node) {
+    node->state = calloc(1, sizeof(PointwiseState));
+    return node->state != NULL;
+}
+
+static void pointwise_begin(EffectNode* node, size_t frames) {
+    (void)frames;
+    ((PointwiseState*)node->state)->amount = effect_node_get_param(node, 0);
+}
+
+static void bit_mash_apply(EffectNode* node, float* samples, size_t offset, size_t frames) {
+    (void)offset;
+    effect_bit_mash_block(samples, frames, ((PointwiseState*)node->state)->amount, &node->rng);
+}
+
+static void bit_drop_apply(EffectNode* node, float* samples, size_t offset, size_t frames) {
+    (void)offset;
+    effect_bit_drop_block(samples, frames, ((PointwiseState*)node->state)->amount, &node->rng);
+}
+
+// Gain: decibels turned into a factor once per block
+static void gain_begin(EffectNode* node, size_t frames) {
+    (void)frames;
+    float db = CLAMP(effect_node_get_param(node, 0), GAIN_MIN_DB, GAIN_MAX_DB);
+    ((PointwiseState*)node->state)->amount = powf(10.0f, db / 20.0f);
+}
+
+static void gain_apply(EffectNode* node, float* samples, size_t offset, size_t frames) {
+    (void)offset;
+    effect_gain_block(samples, frames, ((PointwiseState*)node->state)->amount);
+}
+
+typedef struct {
+    Oscillator osc;
+    float wave[EFFECT_CHAIN_MAX_BLOCK];
+} RobotState;
+
+static gboolean robot_init(EffectNode* node) {
+    node->state = calloc(1, sizeof(RobotState));
+    return node->state != NULL;
+}
+
+static void robot_begin(EffectNode* node, size_t frames) {
+    RobotState* state = node->state;
+    // Parameters are picked up every block; the phase carries on
+    state->osc.waveform = oscillator_waveform_from_param(effect_node_get_param(node, 1));
+    oscillator_set_frequency(&state->osc, effect_node_get_param(node, 0), node->sample_rate);
+    // Every channel gets the same modulator
+    oscillator_render(&state->osc, state->wave, frames);
+}
+
+static void robot_apply(EffectNode* node, float* samples, size_t offset, size_t frames) {
+    RobotState* state = node->state;
+    effect_ring_mod_block(samples, state->wave + offset, frames);
+}
+
+// ---- Echo: feedback delay, each repeat quieter by the decay ----
+//
+// Several taps spread evenly up to the delay, the longest one centred and
+// the rest alternating left and right, each at the decay scaled to its
+// share of the delay. Feedback sends the taps back round the line.
+
+static gboolean echo_init(EffectNode* node) {
+    node->state = delay_line_new(node->sample_rate, node->channels, ECHO_MAX_MS);
+    return node->state != NULL;
+}
+
+static void echo_process(EffectChain* chain, EffectNode* node, guint upstream,
+                         float* const* out, size_t frames) {
+    pull(chain, upstream, out, frames);
+    float delay = CLAMP(effect_node_get_param(node, 0), 0.0f, ECHO_MAX_MS);
+    float decay = effect_node_get_param(node, 1);
+    guint tap_count = (guint)CLAMP(effect_node_get_param(node, 2), 1.0f, (float)DELAY_LINE_MAX_TAPS);
+    float feedback = effect_node_get_param(node, 3);
+
+    DelayTap taps[DELAY_LINE_MAX_TAPS];
+    for (guint k = 0; k < tap_count; k++) {
+        float share = (float)(k + 1) / tap_count;
+        taps[k].delay_ms = delay * share;
+        taps[k].gain = copysignf(powf(fabsf(decay), share), decay);
+        taps[k].pan = k + 1 == tap_count ? 0.0f : (k % 2 == 0 ? -ECHO_SPREAD_PAN : ECHO_SPREAD_PAN);
+    }
+    delay_line_process(node->state, taps, tap_count, feedback, out, frames);
+}
+
+static void echo_finalize(EffectNode* node) {
+    delay_line_free(node->state);
+    node->state = NULL;
+}
+
+// ---- Tempo: WSOLA, so speed changes without the pitch following ----
+
+typedef struct {
+    EffectChain* chain;
+    guint upstream;
+} TempoSource;
+
+static void tempo_pull(gpointer data, float* const* planes, size_t frames) {
+    TempoSource* source = data;
+    pull(source->chain, source->upstream, planes, frames);
+}
+
+static gboolean tempo_init(EffectNode* node) {
+    node->state = time_stretch_new(node->sample_rate, node->channels);
+    return node->state != NULL;
+}
+
+static void tempo_process(EffectChain* chain, EffectNode* node, guint upstream,
+                          float* const* out, size_t frames) {
+    TempoSource source = { chain, upstream };
+    double factor = CLAMP(effect_node_get_param(node, 0), TEMPO_MIN, TEMPO_MAX);
+    time_stretch_process(node->state, factor, tempo_pull, &source, out, frames);
+}
+
+static void tempo_finalize(EffectNode* node) {
+    time_stretch_free(node->state);
+    node->state = NULL;
+}
+
+// ---- Pitch: streaming phase vocoder ----
+//
+// Input is collected a hop at a time. Each full hop runs one windowed frame,
+// which is overlap-added into the accumulator, and the oldest hop of the
+// accumulator becomes final. Latency is one window.
+
+typedef struct {
+    double* in;
+    fftw_complex* out;
+    fftw_plan forward;                      // Shared, from fft_plans.h
+    fftw_plan backward;
+    const double* window;
+    double phase_advance[PITCH_BINS];
+    double phase[AUDIO_MAX_CHANNELS][PITCH_BINS];
+    double scratch[4 * PITCH_BINS];         // For effect_pitch_shift_bins()
+    float* input[AUDIO_MAX_CHANNELS];       // Last window of input
+    double* accumulator[AUDIO_MAX_CHANNELS];
+    float* ready[AUDIO_MAX_CHANNELS];       // Finished hop being played out
+    size_t hop_fill;
+} PitchState;
+
+static void pitch_finalize(EffectNode* node) {
+    PitchState* state = node->state;
+    fftw_free(state->in);
+    fftw_free(state->out);
+    planes_free(state->input, node->channels);
+    planes_free(state->ready, node->channels);
+    for (uint16_t ch = 0; ch < node->channels; ch++) {
+        free(state->accumulator[ch]);
+    }
+}
+
+// Plans are looked up here, on the UI thread, so a first-time measurement
+// never stalls the render thread
+static gboolean pitch_init(EffectNode* node) {
+    PitchState* state = calloc(1, sizeof(PitchState));
+    if (!state) return FALSE;
+    node->state = state;
+
+    state->in = fftw_alloc_real(PITCH_WINDOW);
+    state->out = fftw_alloc_complex(PITCH_BINS);
+    if (!state->in || !state->out) goto fail;
+    state->forward = fft_plan_get(PITCH_WINDOW, FFT_R2C);
+    state->backward = fft_plan_get(PITCH_WINDOW, FFT_C2R);
+    state->window = fft_hann_window(PITCH_WINDOW);
+    if (!state->forward || !state->backward || !state->window) goto fail;
+
+    for (size_t i = 0; i < PITCH_BINS; i++) {
+        state->phase_advance[i] = 2.0 * M_PI * i * PITCH_HOP / PITCH_WINDOW;
+    }
+
+    for (uint16_t ch = 0; ch < node->channels; ch++) {
+        state->accumulator[ch] = calloc(PITCH_WINDOW, sizeof(double));
+        if (!state->accumulator[ch]) goto fail;
+    }
+    if (!planes_alloc(state->input, node->channels, PITCH_WINDOW)) goto fail;
+    if (!planes_alloc(state->ready, node->channels, PITCH_HOP)) goto fail;
+    return TRUE;
+
+fail:
+    pitch_finalize(node);
+    free(state);
+    node->state = NULL;
+    return FALSE;
+}
+
+static void pitch_frame(PitchState* state, uint16_t ch, double factor) {
+    double* in = state->in;
+    fftw_complex* out = state->out;
+    const float* input = state->input[ch];
+    double* phase = state->phase[ch];
+    double* accumulator = state->accumulator[ch];
+
+    for (size_t i = 0; i < PITCH_WINDOW; i++) {
+        in[i] = input[i] * state->window[i];
+    }
+
+    fftw_execute_dft_r2c(state->forward, in, out);
+
+    effect_pitch_shift_bins(out, PITCH_BINS, phase, state->phase_advance, factor, state->scratch);
+
+    fftw_execute_dft_c2r(state->backward, out, in);
+
+    for (size_t i = 0; i < PITCH_WINDOW; i++) {
+        accumulator[i] += in[i] * state->window[i] / PITCH_WINDOW;
+    }
+
+    // The oldest hop has had every overlapping frame added; hand it out
+    float* ready = state->ready[ch];
+    for (size_t i = 0; i < PITCH_HOP; i++) {
+        ready[i] = (float)accumulator[i];
+    }
+    memmove(accumulator, accumulator + PITCH_HOP, (PITCH_WINDOW - PITCH_HOP) * sizeof(double));
+    memset(accumulator + PITCH_WINDOW - PITCH_HOP, 0, PITCH_HOP * sizeof(double));
+    memmove(state->input[ch], state->input[ch] + PITCH_HOP, (PITCH_WINDOW - PITCH_HOP) * sizeof(float));
+}
+
+static void pitch_process(EffectChain* chain, EffectNode* node, guint upstream,
+                          float* const* out, size_t frames) {
+    pull(chain, upstream, out, frames);
+    PitchState* state = node->state;
+    double factor = pow(2.0, effect_node_get_param(node, 0) / 12.0);
+
+    size_t done = 0;
+    while (done < frames) {
+        size_t chunk = MIN(frames - done, PITCH_HOP - state->hop_fill);
+        for (uint16_t ch = 0; ch < node->channels; ch++) {
+            // Take the input before overwriting it with output
+            memcpy(state->input[ch] + PITCH_WINDOW - PITCH_HOP + state->hop_fill,
+                   out[ch] + done, chunk * sizeof(float));
+            memcpy(out[ch] + done, state->ready[ch] + state->hop_fill, chunk * sizeof(float));
+        }
+        done += chunk;
+        state->hop_fill += chunk;
+
+        if (state->hop_fill == PITCH_HOP) {
+            for (uint16_t ch = 0; ch < node->channels; ch++) {
+                pitch_frame(state, ch, factor);
+            }
+            state->hop_fill = 0;
+        }
+    }
+}
+
+static const EffectNodeOps node_ops[EFFECT_TYPE_COUNT] = {
+    [EFFECT_BIT_MASH] = { "bit mash", pointwise_init, NULL, NULL, pointwise_begin, bit_mash_apply },
+    [EFFECT_BIT_DROP] = { "bit drop", pointwise_init, NULL, NULL, pointwise_begin, bit_drop_apply },
+    [EFFECT_TEMPO] = { "tempo", tempo_init, tempo_process, tempo_finalize },
+    [EFFECT_PITCH] = { "pitch", pitch_init, pitch_process, pitch_finalize },
+    [EFFECT_ECHO] = { "echo", echo_init, echo_process, echo_finalize },
+    [EFFECT_ROBOT] = { "robot", robot_init, NULL, NULL, robot_begin, robot_apply },
+    [EFFECT_GAIN] = { "gain", pointwise_init, NULL, NULL, gain_begin, gain_apply },
+};
+
+// Parameters effect_chain_add() leaves to the type; zero unless listed
+static const float param_defaults[EFFECT_TYPE_COUNT][EFFECT_MAX_PARAMS] = {
+    [EFFECT_ECHO] = { 0.0f, 0.0f, 1.0f, 1.0f },
+};
+
+static EffectNode* effect_node_new(EffectChain* chain, EffectType type, const float* params) {
+    EffectNode* node = calloc(1, sizeof(EffectNode));
+    if (!node) return NULL;
+
+    node->ops = &node_ops[type];
+    node->type = type;
+    memcpy(node->params, params, sizeof(node->params));
+    node->sample_rate = chain->sample_rate;
+    node->channels = chain->channels;
+    rng_seed(&node->rng, rng_next_seed());
+
+    if (node->ops->init && !node->ops->init(node)) {
+        fprintf(stderr, "Could not set up %s effect\n", node->ops->name);
+        free(node);
+        return NULL;
+    }
+    return node;
+}
+
+static void effect_node_free(EffectNode* node) {
+    if (!node) return;
+    if (node->state && node->ops->finalize) node->ops->finalize(node);
+    free(node->state);
+    free(node);
+}
+
+void effect_node_set_param(EffectNode* node, guint index, float value) {
+    if (!node || index >= EFFECT_MAX_PARAMS) return;
+    __atomic_store(&node->params[index], &value, __ATOMIC_RELAXED);
+}
+
+float effect_node_get_param(EffectNode* node, guint index) {
+    float value = 0.0f;
+    if (!node || index >= EFFECT_MAX_PARAMS) return value;
+    __atomic_load(&node->params[index], &value, __ATOMIC_RELAXED);
+    return value;
+}
+
+EffectType effect_node_type(EffectNode* node) {
+    return node->type;
+}
+
+const char* effect_type_name(EffectType type) {
+    if (type < 0 || type >= EFFECT_TYPE_COUNT) return "unknown";
+    return node_ops[type].name;
+}
+
+EffectChain* effect_chain_new(uint32_t sample_rate, uint16_t channels) {
+    if (sample_rate == 0 || channels == 0 || channels > AUDIO_MAX_CHANNELS) return NULL;
+
+    EffectChain* chain = calloc(1, sizeof(EffectChain));
+    if (!chain) return NULL;
+
+    chain->sample_rate = sample_rate;
+    chain->channels = channels;
+    chain->commands = ring_buffer_new(sizeof(Command), COMMAND_SLOTS);
+    chain->garbage = ring_buffer_new(sizeof(EffectNode*), GARBAGE_SLOTS);
+    if (!chain->commands || !chain->garbage) {
+        ring_buffer_free(chain->commands);
+        ring_buffer_free(chain->garbage);
+        free(chain);
+        return NULL;
+    }
+    return chain;
+}
+
+// Free whatever the render thread has finished with
+static void collect_garbage(EffectChain* chain) {
+    EffectNode* node;
+    while (ring_buffer_pop(chain->garbage, &node)) {
+        effect_node_free(node);
+    }
+}
+
+void effect_chain_free(EffectChain* chain) {
+    if (!chain) return;
+
+    // Nodes still listed by the UI are freed below; removals never applied
+    // are the only ones that would otherwise be lost
+    Command command;
+    while (ring_buffer_pop(chain->commands, &command)) {
+        if (command.op == COMMAND_REMOVE) effect_node_free(command.node);
+    }
+    collect_garbage(chain);
+    g_list_free_full(chain->ui_nodes, (GDestroyNotify)effect_node_free);
+
+    ring_buffer_free(chain->commands);
+    ring_buffer_free(chain->garbage);
+    free(chain);
+}
+
+static gboolean send_command(EffectChain* chain, CommandOp op, EffectNode* node) {
+    Command command = { op, node };
+    if (!ring_buffer_push(chain->commands, &command)) {
+        fprintf(stderr, "Effect chain busy, dropping %s change\n", node->ops->name);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+void effect_chain_remove(EffectChain* chain, EffectNode* node) {
+    if (!chain || !node || !g_list_find(chain->ui_nodes, node)) return;
+    collect_garbage(chain);
+
+    if (send_command(chain, COMMAND_REMOVE, node)) {
+        chain->ui_nodes = g_list_remove(chain->ui_nodes, node);
+    }
+}
+
+void effect_chain_clear(EffectChain* chain) {
+    if (!chain) return;
+    collect_garbage(chain);
+
+    while (chain->ui_nodes) {
+        EffectNode* node = chain->ui_nodes->data;
+        if (!send_command(chain, COMMAND_REMOVE, node)) break;
+        chain->ui_nodes = g_list_remove(chain->ui_nodes, node);
+    }
+}
+
+guint effect_chain_length(EffectChain* chain) {
+    return chain ? g_list_length(chain->ui_nodes) : 0;
+}
+
+// Stacking two of these is the same as one with combined parameters
+static gboolean fold_into(EffectNode* node, EffectType type, float param0) {
+    if (node->type != type) return FALSE;
+
+    float current = effect_node_get_param(node, 0);
+    switch (type) {
+        case EFFECT_TEMPO:
+            effect_node_set_param(node, 0, CLAMP(current * param0, TEMPO_MIN, TEMPO_MAX));
+            return TRUE;
+        case EFFECT_PITCH:
+            effect_node_set_param(node, 0, CLAMP(current + param0, -24.0f, 24.0f));
+            return TRUE;
+        case EFFECT_BIT_DROP:
+            effect_node_set_param(node, 0, 1.0f - (1.0f - current) * (1.0f - param0));
+            return TRUE;
+        case EFFECT_GAIN:
+            effect_node_set_param(node, 0, CLAMP(current + param0, GAIN_MIN_DB, GAIN_MAX_DB));
+            return TRUE;
+        default:
+            return FALSE;
+    }
+}
+
+static EffectNode* append_node(EffectChain* chain, EffectType type, const float* params) {
+    EffectNode* node = effect_node_new(chain, type, params);
+    if (!node) return NULL;
+
+    if (!send_command(chain, COMMAND_ADD, node)) {
+        effect_node_free(node);
+        return NULL;
+    }
+    chain->ui_nodes = g_list_append(chain->ui_nodes, node);
+    return node;
+}
+
+EffectNode* effect_chain_add(EffectChain* chain, EffectType type, float param0, float param1) {
+    if (!chain || type < 0 || type >= EFFECT_TYPE_COUNT) return NULL;
+    collect_garbage(chain);
+
+    GList* tail = g_list_last(chain->ui_nodes);
+    if (tail && fold_into(tail->data, type, param0)) {
+        return tail->data;
+    }
+
+    if (g_list_length(chain->ui_nodes) >= EFFECT_CHAIN_MAX_NODES) {
+        EffectNode* oldest = chain->ui_nodes->data;
+        printf("Effect chain full, dropping oldest %s\n", oldest->ops->name);
+        effect_chain_remove(chain, oldest);
+        if (g_list_length(chain->ui_nodes) >= EFFECT_CHAIN_MAX_NODES) return NULL;
+    }
+
+    float params[EFFECT_MAX_PARAMS];
+    memcpy(params, param_defaults[type], sizeof(params));
+    params[0] = param0;
+    params[1] = param1;
+    return append_node(chain, type, params);
+}
+
+guint effect_chain_get_specs(EffectChain* chain, EffectSpec specs[EFFECT_CHAIN_MAX_NODES]) {
+    guint count = 0;
+    if (!chain) return 0;
+
+    for (GList* l = chain->ui_nodes; l != NULL && count < EFFECT_CHAIN_MAX_NODES; l = l->next) {
+        EffectNode* node = l->data;
+        specs[count].type = node->type;
+        for (guint i = 0; i < EFFECT_MAX_PARAMS; i++) {
+            specs[count].params[i] = effect_node_get_param(node, i);
+        }
+        count++;
+    }
+    return count;
+}
+
+void effect_chain_set_specs(EffectChain* chain, const EffectSpec* specs, guint count) {
+    if (!chain) return;
+    collect_garbage(chain);
+
+    // Keep the common prefix, just retuning its parameters
+    guint kept = 0;
+    GList* l = chain->ui_nodes;
+    while (l != NULL && kept < count && ((EffectNode*)l->data)->type == specs[kept].type) {
+        for (guint i = 0; i < EFFECT_MAX_PARAMS; i++) {
+            effect_node_set_param(l->data, i, specs[kept].params[i]);
+        }
+        kept++;
+        l = l->next;
+    }
+
+    while (l != NULL) {
+        GList* next = l->next;
+        EffectNode* node = l->data;
+        if (send_command(chain, COMMAND_REMOVE, node)) {
+            chain->ui_nodes = g_list_delete_link(chain->ui_nodes, l);
+        }
+        l = next;
+    }
+
+    for (guint i = kept; i < count && i < EFFECT_CHAIN_MAX_NODES; i++) {
+        append_node(chain, specs[i].type, specs[i].params);
+    }
+}
+
+EffectNode* effect_chain_add_random(EffectChain* chain) {
+    Rng* rng = rng_thread();
+    // Gain only sets the level, so it is never picked
+    switch (rng_below(rng, EFFECT_GAIN)) {
+        case EFFECT_BIT_MASH:
+            return effect_chain_add(chain, EFFECT_BIT_MASH, rng_double(rng) * 0.8, 0.0f);
+        case EFFECT_BIT_DROP:
+            return effect_chain_add(chain, EFFECT_BIT_DROP, rng_double(rng) * 0.3, 0.0f);
+        case EFFECT_TEMPO:
+            return effect_chain_add(chain, EFFECT_TEMPO, 0.5 + rng_double(rng), 0.0f);
+        case EFFECT_PITCH:
+            return effect_chain_add(chain, EFFECT_PITCH, rng_double(rng) * 24.0 - 12.0, 0.0f);
+        case EFFECT_ECHO: {
+            double delay = 100.0 + rng_double(rng) * 400.0;
+            EffectNode* node = effect_chain_add(chain, EFFECT_ECHO, delay, 0.3 + rng_double(rng) * 0.4);
+            if (node) {
+                effect_node_set_param(node, 2, 1 + rng_below(rng, 4));
+                effect_node_set_param(node, 3, 0.3 + rng_double(rng) * 0.7);
+            }
+            return node;
+        }
+        default: {
+            double modulation_freq = 1.0 + rng_double(rng) * 10.0;
+            return effect_chain_add(chain, EFFECT_ROBOT, modulation_freq, rng_below(rng, OSC_WAVEFORM_COUNT));
+        }
+    }
+}
+
+// Render thread: pick up structural changes queued by the UI
+static void apply_commands(EffectChain* chain) {
+    Command command;
+    while (ring_buffer_pop(chain->commands, &command)) {
+        if (command.op == COMMAND_ADD) {
+            if (chain->count < EFFECT_CHAIN_MAX_NODES) {
+                chain->nodes[chain->count++] = command.node;
+            }
+            continue;
+        }
+
+        for (guint i = 0; i < chain->count; i++) {
+            if (chain->nodes[i] != command.node) continue;
+            memmove(&chain->nodes[i], &chain->nodes[i + 1],
+                    (chain->count - i - 1) * sizeof(EffectNode*));
+            chain->count--;
+            break;
+        }
+        // Sized so this always fits; see GARBAGE_SLOTS
+        ring_buffer_push(chain->garbage, &command.node);
+    }
+}
+
+// Pull once from below a run of adjacent pointwise nodes, then take each
+// tile of each channel through the whole run while it is still in L1, rather
+// than sweeping the block once per node. Nodes with a window of their own
+// (echo, pitch, tempo) end a run.
+static void pull_fused(EffectChain* chain, guint upstream, float* const* out, size_t frames) {
+    guint first = upstream;
+    while (first > 0 && chain->nodes[first - 1]->ops->apply) {
+        first--;
+    }
+    pull(chain, first, out, frames);
+
+    EffectNode* const* run = &chain->nodes[first];
+    guint length = upstream - first;
+    for (guint i = 0; i < length; i++) {
+        run[i]->ops->begin(run[i], frames);
+    }
+    for (uint16_t ch = 0; ch < chain->channels; ch++) {
+        for (size_t offset = 0; offset < frames; offset += FUSE_TILE) {
+            size_t n = MIN(FUSE_TILE, frames - offset);
+            for (guint i = 0; i < length; i++) {
+                run[i]->ops->apply(run[i], out[ch] + offset, offset, n);
+            }
+        }
+    }
+}
+
+static void pull(EffectChain* chain, guint upstream, float* const* out, size_t frames) {
+    if (upstream == 0) {
+        chain->source(chain->source_data, out, frames);
+        return;
+    }
+    EffectNode* node = chain->nodes[upstream - 1];
+    if (node->ops->apply) {
+        pull_fused(chain, upstream, out, frames);
+        return;
+    }
+    node->ops->process(chain, node, upstream - 1, out, frames);
+}
+
+void effect_chain_process(EffectChain* chain, EffectSourceFunc source, gpointer data,
+                          float* const* out, size_t frames) {
+    if (!chain) {
+        source(data, out, frames);
+        return;
+    }
+
+    apply_commands(chain);
+    chain->source = source;
+    chain->source_data = data;
+
+    float* planes[AUDIO_MAX_CHANNELS];
+    size_t done = 0;
+    while (done < frames) {
+        size_t chunk = MIN(frames - done, EFFECT_CHAIN_MAX_BLOCK);
+        for (uint16_t ch = 0; ch < chain->channels; ch++) {
+            planes[ch] = out[ch] + done;
+        }
+        pull(chain, chain->count, planes, chunk);
+        done += chunk;
+    }
+}
@@ -0,0 +1,77 @@
+#ifndef EFFECT_CHAIN_H
+#define EFFECT_CHAIN_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <glib.h>
+
+// Live, non-destructive effects. The chain sits between the mix and the
+// device: the render thread pulls each block through it, so applying an
+// effect costs one block and the mix itself is never rewritten.
+//
+// Threading: everything except effect_chain_process() belongs to the UI
+// thread. Structural changes travel to the render thread through a lock-free
+// command queue and retired nodes come back through a second one, so neither
+// side ever waits on the other. Node parameters may be changed at any time.
+//
+// Runs of adjacent pointwise nodes (bit mash, bit drop, robot, gain) are
+// fused: each tile of a block goes through the whole run in one pass.
+
+#define EFFECT_CHAIN_MAX_NODES 16
+#define EFFECT_CHAIN_MAX_BLOCK 1024     // Frames pulled per pass; longer requests are split
+#define EFFECT_MAX_PARAMS 4
+
+typedef enum {
+    EFFECT_BIT_MASH = 0,    // intensity 0..1
+    EFFECT_BIT_DROP,        // probability 0..1
+    EFFECT_TEMPO,           // speed factor 0.25..4
+    EFFECT_PITCH,           // semitones -24..24
+    EFFECT_ECHO,            // delay ms, decay per repeat, taps 1..8, feedback 0..1
+    EFFECT_ROBOT,           // modulation Hz, OscWaveform
+    EFFECT_GAIN,            // dB -48..24
+    EFFECT_TYPE_COUNT
+} EffectType;
+
+typedef struct EffectNode EffectNode;
+typedef struct EffectChain EffectChain;
+
+// What a node does, without its running state
+typedef struct {
+    EffectType type;
+    float params[EFFECT_MAX_PARAMS];
+} EffectSpec;
+
+// Fills exactly `frames` frames of every plane with the chain's input
+typedef void (*EffectSourceFunc)(gpointer data, float* const* planes, size_t frames);
+
+EffectChain* effect_chain_new(uint32_t sample_rate, uint16_t channels);
+// Only once the render thread has stopped calling effect_chain_process()
+void effect_chain_free(EffectChain* chain);
+
+// Append an effect at the end of the chain. Tempo, pitch, drop and gain fold
+// into a tail node of the same type. When the chain is full the oldest node
+// is retired. Parameters past the first two start at the type's defaults (one
+// echo tap, full feedback) and can be set on the returned node. Returns the
+// node now carrying the effect, or NULL on failure.
+EffectNode* effect_chain_add(EffectChain* chain, EffectType type, float param0, float param1);
+EffectNode* effect_chain_add_random(EffectChain* chain);
+void effect_chain_remove(EffectChain* chain, EffectNode* node);
+void effect_chain_clear(EffectChain* chain);
+guint effect_chain_length(EffectChain* chain);
+
+// Describe the chain, and rebuild it from a description. Nodes that already
+// match keep running (and keep their delay lines etc.); only the rest change.
+guint effect_chain_get_specs(EffectChain* chain, EffectSpec specs[EFFECT_CHAIN_MAX_NODES]);
+void effect_chain_set_specs(EffectChain* chain, const EffectSpec* specs, guint count);
+
+// Live parameters; safe while the node is being processed
+void effect_node_set_param(EffectNode* node, guint index, float value);
+float effect_node_get_param(EffectNode* node, guint index);
+EffectType effect_node_type(EffectNode* node);
+const char* effect_type_name(EffectType type);
+
+// Render thread: pull `frames` frames from source through every node into out
+void effect_chain_process(EffectChain* chain, EffectSourceFunc source, gpointer data,
+                          float* const* out, size_t frames);
+
+#endif
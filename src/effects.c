@@ -3,306 +3,79 @@
 #include <time.h>
 #include <string.h>
 #include <glib/gstdio.h>
-#include <fftw3.h>
 #include "effects.h"
+#include "playback.h"
+#include "spectral.h"
+#include "rng.h"
+#include "oscillator.h"
 #include "ui.h"
 
-// Add FFTW constants if not defined
-#ifndef FFTW_FORWARD
-#define FFTW_FORWARD (-1)
-#define FFTW_BACKWARD 1
-#define FFTW_ESTIMATE 64
-#endif
-
-// Add backup function
-static void backup_original(AudioPlayer* player, AudioData* audio) {
-    if (!player->effect_active) {
-        if (!player->original_mix) {
-            player->original_mix = malloc(sizeof(AudioData));
-            player->original_mix->buffer = malloc(audio->buffer_size);
-        }
-        memcpy(player->original_mix->buffer, audio->buffer, audio->buffer_size);
-        player->original_mix->buffer_size = audio->buffer_size;
-        player->original_mix->sample_rate = audio->sample_rate;
-        player->original_mix->channels = audio->channels;
-        player->original_mix->bits_per_sample = audio->bits_per_sample;
-        player->effect_active = TRUE;
-    }
-}
-
-// Utility function for random float between 0 and 1
-static float rand_float() {
-    return (float)rand() / (float)RAND_MAX;
-}
-
-void bit_mash(AudioPlayer* player, AudioData* audio G_GNUC_UNUSED, float intensity) {
-    if (!player || !player->active_mix) return;
-    
-    // Store original if not already stored
-    if (!player->effect_active) {
-        if (!player->original_mix) {
-            player->original_mix = malloc(sizeof(AudioData));
-            player->original_mix->buffer = malloc(player->active_mix->buffer_size);
-            memcpy(player->original_mix->buffer, player->active_mix->buffer, player->active_mix->buffer_size);
-            player->original_mix->buffer_size = player->active_mix->buffer_size;
-            player->original_mix->sample_rate = player->active_mix->sample_rate;
-            player->original_mix->channels = player->active_mix->channels;
-            player->original_mix->bits_per_sample = player->active_mix->bits_per_sample;
-        }
-        player->effect_active = TRUE;
-    }
-    
-    // Apply effect directly to active mix
+void effect_bit_mash_block(float* samples, size_t frames, float intensity, Rng* rng) {
+    // The effect is defined on 16-bit words, so quantise just for it
     int mask = 0xFFFF >> (int)(intensity * 8);
-    for (size_t i = 0; i < player->active_mix->buffer_size / sizeof(int16_t); i++) {
-        player->active_mix->buffer[i] &= mask;
-        if (rand_float() < intensity * 0.1) {
-            player->active_mix->buffer[i] ^= (1 << (int)(rand_float() * 16));
-        }
+    for (size_t i = 0; i < frames; i++) {
+        int16_t word = (int16_t)CLAMP(lrintf(samples[i] * 32768.0f), -32768, 32767);
+        word &= mask;
+        samples[i] = word / 32768.0f;
     }
-}
-
-void bit_drop(AudioPlayer* player, AudioData* audio G_GNUC_UNUSED, float probability) {
-    if (!player || !player->active_mix) return;
     
-    // Store original if not already stored
-    if (!player->effect_active) {
-        if (!player->original_mix) {
-            player->original_mix = malloc(sizeof(AudioData));
-            player->original_mix->buffer = malloc(player->active_mix->buffer_size);
-            memcpy(player->original_mix->buffer, player->active_mix->buffer, player->active_mix->buffer_size);
-            player->original_mix->buffer_size = player->active_mix->buffer_size;
-            player->original_mix->sample_rate = player->active_mix->sample_rate;
-            player->original_mix->channels = player->active_mix->channels;
-            player->original_mix->bits_per_sample = player->active_mix->bits_per_sample;
-        }
-        player->effect_active = TRUE;
-    }
-    
-    // Apply effect directly to active mix
-    for (size_t i = 0; i < player->active_mix->buffer_size / sizeof(int16_t); i++) {
-        if (rand_float() < probability) {
-            player->active_mix->buffer[i] = 0;
-        }
+    // A few samples also get one random bit flipped; skip straight to them
+    double flip_chance = intensity * 0.1;
+    for (size_t i = rng_geometric(rng, flip_chance); i < frames; i += 1 + rng_geometric(rng, flip_chance)) {
+        int16_t word = (int16_t)(samples[i] * 32768.0f);
+        word ^= (1 << rng_below(rng, 16));
+        samples[i] = word / 32768.0f;
     }
 }
 
-void tempo_shift(AudioPlayer* player, AudioData* audio G_GNUC_UNUSED, float factor) {
-    if (!player || !player->active_mix) return;
-    
-    // Store original if not already stored
-    if (!player->effect_active) {
-        if (!player->original_mix) {
-            player->original_mix = malloc(sizeof(AudioData));
-            player->original_mix->buffer = malloc(player->active_mix->buffer_size);
-            memcpy(player->original_mix->buffer, player->active_mix->buffer, player->active_mix->buffer_size);
-            player->original_mix->buffer_size = player->active_mix->buffer_size;
-            player->original_mix->sample_rate = player->active_mix->sample_rate;
-            player->original_mix->channels = player->active_mix->channels;
-            player->original_mix->bits_per_sample = player->active_mix->bits_per_sample;
-        }
-        player->effect_active = TRUE;
-    }
-    
-    // Apply effect directly to active mix
-    size_t num_samples = player->active_mix->buffer_size / sizeof(int16_t);
-    int16_t* new_buffer = malloc(player->active_mix->buffer_size);
-    
-    for (size_t i = 0; i < num_samples; i++) {
-        size_t src_idx = (size_t)(i * factor) % num_samples;
-        new_buffer[i] = player->active_mix->buffer[src_idx];
-    }
-    
-    memcpy(player->active_mix->buffer, new_buffer, player->active_mix->buffer_size);
-    free(new_buffer);
-}
-
-void pitch_shift(AudioPlayer* player, AudioData* audio, float semitones) {
-    if (!audio || !audio->buffer) return;
-    
-    // Save original if needed
-    backup_original(player, audio);
-    
-    // Calculate pitch shift factor
-    float factor = pow(2.0f, semitones / 12.0f);
-    
-    // Create FFT context for phase vocoder
-    size_t window_size = 2048;
-    size_t hop_size = window_size / 4;
-    
-    fftw_complex* in = fftw_alloc_complex(window_size);
-    fftw_complex* out = fftw_alloc_complex(window_size);
-    fftw_plan forward = fftw_plan_dft_1d(window_size, in, out, FFTW_FORWARD, FFTW_ESTIMATE);
-    fftw_plan backward = fftw_plan_dft_1d(window_size, out, in, FFTW_BACKWARD, FFTW_ESTIMATE);
-    
-    // Hann window for smooth overlapping
-    double* window = malloc(window_size * sizeof(double));
-    for (size_t i = 0; i < window_size; i++) {
-        window[i] = 0.5 * (1.0 - cos(2.0 * M_PI * i / (window_size - 1)));
-    }
-    
-    // Phase accumulation arrays
-    double* phase = calloc(window_size/2 + 1, sizeof(double));
-    double* phase_advance = calloc(window_size/2 + 1, sizeof(double));
-    
-    // Calculate frequency for each bin
-    for (size_t i = 0; i <= window_size/2; i++) {
-        phase_advance[i] = 2.0 * M_PI * i * hop_size / window_size;
-    }
-    
-    // Process audio in overlapping windows
-    size_t num_samples = audio->buffer_size / sizeof(int16_t);
-    int16_t* output = malloc(audio->buffer_size);
-    double* accumulator = calloc(num_samples + window_size, sizeof(double));
-    
-    for (size_t pos = 0; pos < num_samples; pos += hop_size) {
-        // Fill input buffer
-        for (size_t i = 0; i < window_size; i++) {
-            size_t idx = pos + i;
-            double sample = idx < num_samples ? audio->buffer[idx] / 32768.0 : 0.0;
-            in[i][0] = sample * window[i];
-            in[i][1] = 0.0;
-        }
-        
-        // Forward FFT
-        fftw_execute(forward);
-        
-        // Modify phases for pitch shift
-        for (size_t i = 0; i <= window_size/2; i++) {
-            double magnitude = sqrt(out[i][0] * out[i][0] + out[i][1] * out[i][1]);
-            double phase_now = atan2(out[i][1], out[i][0]);
-            
-            double phase_diff = phase_now - phase[i] - phase_advance[i];
-            phase_diff = fmod(phase_diff + M_PI, 2*M_PI) - M_PI;
-            
-            double true_freq = phase_advance[i] + phase_diff;
-            phase[i] = phase_now;
-            
-            // Apply pitch shift
-            double shifted_phase = fmod(phase[i] + true_freq * factor, 2*M_PI);
-            
-            out[i][0] = magnitude * cos(shifted_phase);
-            out[i][1] = magnitude * sin(shifted_phase);
-        }
-        
-        // Inverse FFT
-        fftw_execute(backward);
-        
-        // Overlap-add to output
-        for (size_t i = 0; i < window_size; i++) {
-            accumulator[pos + i] += in[i][0] * window[i] / window_size;
-        }
-    }
-    
-    // Convert back to int16
-    for (size_t i = 0; i < num_samples; i++) {
-        output[i] = (int16_t)CLAMP(accumulator[i] * 32768.0, -32768.0, 32767.0);
+void effect_bit_drop_block(float* samples, size_t frames, float probability, Rng* rng) {
+    // Only the dropped samples are visited
+    for (size_t i = rng_geometric(rng, probability); i < frames; i += 1 + rng_geometric(rng, probability)) {
+        samples[i] = 0.0f;
     }
-    
-    // Copy to audio buffer
-    memcpy(audio->buffer, output, audio->buffer_size);
-    
-    // Cleanup
-    fftw_destroy_plan(forward);
-    fftw_destroy_plan(backward);
-    fftw_free(in);
-    fftw_free(out);
-    free(window);
-    free(phase);
-    free(phase_advance);
-    free(output);
-    free(accumulator);
 }
 
-void add_echo(AudioPlayer* player, AudioData* audio, float delay_ms, float decay) {
-    if (!audio || !player) return;
-    
-    // Store original if not already stored
-    if (!player->effect_active) {
-        if (!player->original_mix) {
-            player->original_mix = malloc(sizeof(AudioData));
-            player->original_mix->buffer = malloc(audio->buffer_size);
-        }
-        memcpy(player->original_mix->buffer, audio->buffer, audio->buffer_size);
-        player->original_mix->buffer_size = audio->buffer_size;
-        player->effect_active = TRUE;
-    }
-    
-    // Apply effect directly
-    size_t delay_samples = (size_t)(delay_ms * audio->sample_rate / 1000.0f);
-    size_t num_samples = audio->buffer_size / sizeof(int16_t);
-    int16_t* new_buffer = malloc(audio->buffer_size);
-    memcpy(new_buffer, audio->buffer, audio->buffer_size);
-    
-    for (size_t i = delay_samples; i < num_samples; i++) {
-        float echo = audio->buffer[i - delay_samples] * decay;
-        new_buffer[i] = (int16_t)fmin(32767, fmax(-32768, new_buffer[i] + echo));
-    }
-    
-    memcpy(audio->buffer, new_buffer, audio->buffer_size);
-    free(new_buffer);
-    
-    // Update the active mix
-    if (player->active_mix) {
-        memcpy(player->active_mix->buffer, audio->buffer, audio->buffer_size);
+void effect_ring_mod_block(float* samples, const float* wave, size_t frames) {
+    for (size_t i = 0; i < frames; i++) {
+        samples[i] *= (wave[i] + 1.0f) * 0.5f;
     }
 }
 
-void add_robot(AudioPlayer* player, AudioData* audio, float modulation_freq) {
-    if (!audio || !player) return;
-    
-    // Store original if not already stored
-    if (!player->effect_active) {
-        if (!player->original_mix) {
-            player->original_mix = malloc(sizeof(AudioData));
-            player->original_mix->buffer = malloc(audio->buffer_size);
-        }
-        memcpy(player->original_mix->buffer, audio->buffer, audio->buffer_size);
-        player->original_mix->buffer_size = audio->buffer_size;
-        player->effect_active = TRUE;
-    }
-    
-    // Apply effect directly
-    float phase = 0.0f;
-    float phase_inc = 2.0f * M_PI * modulation_freq / audio->sample_rate;
-    
-    for (size_t i = 0; i < audio->buffer_size / sizeof(int16_t); i++) {
-        float modulator = (sin(phase) + 1.0f) * 0.5f;
-        audio->buffer[i] = (int16_t)(audio->buffer[i] * modulator);
-        phase += phase_inc;
-    }
-    
-    // Update the active mix
-    if (player->active_mix) {
-        memcpy(player->active_mix->buffer, audio->buffer, audio->buffer_size);
+void effect_gain_block(float* samples, size_t frames, float gain) {
+    for (size_t i = 0; i < frames; i++) {
+        samples[i] *= gain;
     }
 }
 
-void random_effect(AudioPlayer* player, AudioData* audio) {
-    switch (rand() % 6) {
-        case 0:
-            bit_mash(player, audio, rand_float() * 0.8f);
-            break;
-        case 1:
-            bit_drop(player, audio, rand_float() * 0.3f);
-            break;
-        case 2:
-            tempo_shift(player, audio, 0.5f + rand_float());
-            break;
-        case 3:
-            pitch_shift(player, audio, (rand_float() * 24.0f) - 12.0f);
-            break;
-        case 4:
-            add_echo(player, audio, 100.0f + rand_float() * 400.0f, 0.3f + rand_float() * 0.4f);
-            break;
-        case 5:
-            add_robot(player, audio, 1.0f + rand_float() * 10.0f);
-            break;
-    }
+void effect_pitch_shift_bins(double (*bins)[2], size_t count, double* phase,
+                             const double* phase_advance, double factor, double* scratch) {
+    double* magnitude = scratch;
+    double* shifted_phase = scratch + count;
+    double (*shifted)[2] = (double (*)[2])(scratch + 2 * count);
+    
+    // True frequency of each bin from its phase change, then scale it
+    spectral_to_polar((const double (*)[2])bins, magnitude, shifted_phase, count);
+    spectral_phase_advance(shifted_phase, phase, phase_advance, shifted_phase, count);
+    for (size_t i = 0; i < count; i++) {
+        shifted_phase[i] = phase[i] + shifted_phase[i] * factor;
+    }
+    spectral_from_polar(magnitude, shifted_phase, shifted, count);
+    
+    // The full complex transform this replaced rewrote only the lower half of
+    // the spectrum and kept the real part of the result, which equals
+    // averaging shifted and original bins
+    bins[0][0] = shifted[0][0];
+    bins[0][1] = 0.0;
+    for (size_t i = 1; i + 1 < count; i++) {
+        bins[i][0] = 0.5 * (bins[i][0] + shifted[i][0]);
+        bins[i][1] = 0.5 * (bins[i][1] + shifted[i][1]);
+    }
+    bins[count - 1][0] = shifted[count - 1][0];
+    bins[count - 1][1] = 0.0;
 }
 
 void export_last_60_seconds(AudioPlayer* player) {
-    if (!player || !player->active_mix) {
+    if (!player || !player->active_mix || player->active_mix->frames == 0) {
         printf("Export failed: no active mix\n");
         return;
     }
@@ -310,27 +83,59 @@ void export_last_60_seconds(AudioPlayer* player) {
     // Get full path in user's data directory
     char* export_path = get_export_path();
     
-    size_t bytes_per_sample = sizeof(int16_t) * player->active_mix->channels;
-    size_t total_samples = player->last_60_seconds_samples * player->active_mix->channels;
-    size_t buffer_samples = player->active_mix->buffer_size / bytes_per_sample;
+    AudioData* mix = player->active_mix;
+    AudioData* export_audio = NULL;
     
-    AudioData export_audio = {
-        .buffer = malloc(total_samples * bytes_per_sample),
-        .buffer_size = total_samples * bytes_per_sample,
-        .sample_rate = player->active_mix->sample_rate,
-        .channels = player->active_mix->channels,
-        .bits_per_sample = player->active_mix->bits_per_sample
-    };
-    
-    size_t start_pos = (player->ring_buffer_pos + buffer_samples - total_samples) % buffer_samples;
+    // What was actually played, live effects included, when there is any
+    if (playback_channels(player->playback) == mix->channels) {
+        size_t capacity = player->last_60_seconds_samples;
+        float* played = malloc((size_t)mix->channels * capacity * sizeof(float));
+        float* planes[AUDIO_MAX_CHANNELS];
+        for (uint16_t ch = 0; played && ch < mix->channels; ch++) {
+            planes[ch] = played + ch * capacity;
+        }
+        size_t frames = played ? playback_copy_history(player->playback, planes, capacity) : 0;
+        if (frames > 0) {
+            export_audio = audio_data_new(playback_sample_rate(player->playback), mix->channels, frames);
+            if (export_audio) audio_data_write(export_audio, 0, frames, (const float* const*)planes);
+        }
+        free(played);
+    }
     
-    // Copy the last 60 seconds
-    for (size_t i = 0; i < total_samples; i++) {
-        size_t src_idx = (start_pos + i) % buffer_samples;
-        export_audio.buffer[i] = player->active_mix->buffer[src_idx];
+    if (!export_audio) {
+        // Nothing played yet: take the last 60 seconds of the mix, wrapping around the loop
+        size_t total_frames = MIN(player->last_60_seconds_samples, mix->frames);
+        export_audio = audio_data_new(mix->sample_rate, mix->channels, total_frames);
+        if (!export_audio) {
+            g_free(export_path);
+            return;
+        }
+        
+        size_t start_pos = (player->ring_buffer_pos + mix->frames - total_frames) % mix->frames;
+        size_t first_part = MIN(total_frames, mix->frames - start_pos);
+        float* planes[AUDIO_MAX_CHANNELS];
+        float* scratch = malloc((size_t)mix->channels * AUDIO_CHUNK_FRAMES * sizeof(float));
+        if (!scratch) {
+            free_audio_data(export_audio);
+            g_free(export_path);
+            return;
+        }
+        for (uint16_t ch = 0; ch < mix->channels; ch++) {
+            planes[ch] = scratch + ch * AUDIO_CHUNK_FRAMES;
+        }
+        for (size_t done = 0; done < total_frames; ) {
+            size_t src = done < first_part ? start_pos + done : done - first_part;
+            size_t n = MIN(AUDIO_CHUNK_FRAMES, total_frames - done);
+            if (done < first_part) n = MIN(n, first_part - done);
+            audio_data_read(mix, src, n, planes);
+            audio_data_write(export_audio, done, n, (const float* const*)planes);
+            done += n;
+        }
+        free(scratch);
     }
     
-    if (save_wav_file(export_path, &export_audio) != 0) {
+    SampleFormat format = sample_format_parse(g_getenv("TASTEWARP_EXPORT_FORMAT"), SAMPLE_S16);
+    if (save_wav_file(export_path, export_audio, format) != 0) {
         printf("Error saving WAV file to: %s\n", export_path);
     } else {
         printf("Successfully exported to: %s\n", export_path);
@@ -341,7 +146,7 @@ void export_last_60_seconds(AudioPlayer* player) {
     }
     
     g_free(export_path);
-    free(export_audio.buffer);
+    free_audio_data(export_audio);
 }
 
 char* get_export_path(void) {
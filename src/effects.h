@@ -2,17 +2,23 @@
 #define EFFECTS_H
 
 #include "audio.h"
+#include "rng.h"
+#include "oscillator.h"
 
-// Effect functions
-void bit_mash(AudioPlayer* player, AudioData* audio, float intensity);
-void bit_drop(AudioPlayer* player, AudioData* audio, float probability);
-void tempo_shift(AudioPlayer* player, AudioData* audio, float factor);
-void pitch_shift(AudioPlayer* player, AudioData* audio, float semitones);
-void add_echo(AudioPlayer* player, AudioData* audio, float delay_ms, float decay);
-void add_robot(AudioPlayer* player, AudioData* audio, float modulation_freq);
-void random_effect(AudioPlayer* player, AudioData* audio);
+// Effects are applied live through effect_chain.h; the mix is never rewritten.
 void export_last_60_seconds(AudioPlayer* player);
 
+// Per-block kernels for the live chain.
+// effect_ring_mod_block scales by an oscillator wave mapped to 0..1.
+void effect_bit_mash_block(float* samples, size_t frames, float intensity, Rng* rng);
+void effect_bit_drop_block(float* samples, size_t frames, float probability, Rng* rng);
+void effect_ring_mod_block(float* samples, const float* wave, size_t frames);
+void effect_gain_block(float* samples, size_t frames, float gain);
+// One phase-vocoder frame of pitch shifting on a half spectrum. phase holds
+// the previous frame's phases and is updated; scratch holds 4 * count doubles.
+void effect_pitch_shift_bins(double (*bins)[2], size_t count, double* phase,
+                             const double* phase_advance, double factor, double* scratch);
+
 // Export path helper
 char* get_export_path(void);
 
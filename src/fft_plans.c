@@ -0,0 +1,134 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <glib.h>
+#include "fft_plans.h"
+
+#define FFT_PLAN_SLOTS 16
+
+typedef struct {
+    int size;
+    FftDirection direction;
+    fftw_plan plan;
+} CachedPlan;
+
+typedef struct {
+    int size;
+    double* window;
+} CachedWindow;
+
+// FFTW's planner isn't thread-safe, so everything that plans or touches
+// wisdom goes through this lock. Running a plan needs no lock.
+static CachedPlan plans[FFT_PLAN_SLOTS];
+static CachedWindow windows[FFT_PLAN_SLOTS];
+static guint plan_count = 0;
+static guint window_count = 0;
+G_LOCK_DEFINE_STATIC(planner);
+
+static char* wisdom_path(void) {
+    return g_build_filename(g_get_user_data_dir(), "com.un1crom.tastewarp", "fftw-wisdom", NULL);
+}
+
+// Planning with FFTW_MEASURE scribbles over the arrays, so it gets its own
+static fftw_plan make_plan(int size, FftDirection direction) {
+    double* real = fftw_alloc_real(size);
+    fftw_complex* bins = fftw_alloc_complex(size / 2 + 1);
+    fftw_plan plan = NULL;
+    if (real && bins) {
+        if (direction == FFT_R2C) {
+            plan = fftw_plan_dft_r2c_1d(size, real, bins, FFTW_MEASURE);
+        } else {
+            plan = fftw_plan_dft_c2r_1d(size, bins, real, FFTW_MEASURE);
+        }
+    }
+    fftw_free(real);
+    fftw_free(bins);
+    return plan;
+}
+
+fftw_plan fft_plan_get(int size, FftDirection direction) {
+    if (size <= 0) return NULL;
+
+    G_LOCK(planner);
+    for (guint i = 0; i < plan_count; i++) {
+        if (plans[i].size == size && plans[i].direction == direction) {
+            fftw_plan plan = plans[i].plan;
+            G_UNLOCK(planner);
+            return plan;
+        }
+    }
+
+    fftw_plan plan = NULL;
+    if (plan_count < FFT_PLAN_SLOTS) {
+        plan = make_plan(size, direction);
+        if (plan) {
+            plans[plan_count++] = (CachedPlan){size, direction, plan};
+        }
+    } else {
+        fprintf(stderr, "FFT plan cache full, not planning size %d\n", size);
+    }
+    G_UNLOCK(planner);
+    return plan;
+}
+
+const double* fft_hann_window(int size) {
+    if (size <= 1) return NULL;
+
+    G_LOCK(planner);
+    for (guint i = 0; i < window_count; i++) {
+        if (windows[i].size == size) {
+            const double* window = windows[i].window;
+            G_UNLOCK(planner);
+            return window;
+        }
+    }
+
+    double* window = NULL;
+    if (window_count < FFT_PLAN_SLOTS) {
+        window = malloc(size * sizeof(double));
+        if (window) {
+            for (int i = 0; i < size; i++) {
+                window[i] = 0.5 * (1.0 - cos(2.0 * M_PI * i / (size - 1)));
+            }
+            windows[window_count++] = (CachedWindow){size, window};
+        }
+    }
+    G_UNLOCK(planner);
+    return window;
+}
+
+void fft_plans_load_wisdom(void) {
+    char* path = wisdom_path();
+    G_LOCK(planner);
+    // A missing file just means this is the first run
+    if (g_file_test(path, G_FILE_TEST_EXISTS) && !fftw_import_wisdom_from_filename(path)) {
+        fprintf(stderr, "Ignoring unreadable FFTW wisdom: %s\n", path);
+    }
+    G_UNLOCK(planner);
+    g_free(path);
+}
+
+void fft_plans_save_wisdom(void) {
+    char* path = wisdom_path();
+    char* dir = g_path_get_dirname(path);
+    G_LOCK(planner);
+    if (g_mkdir_with_parents(dir, 0755) != 0 || !fftw_export_wisdom_to_filename(path)) {
+        fprintf(stderr, "Could not save FFTW wisdom to %s\n", path);
+    }
+    G_UNLOCK(planner);
+    g_free(dir);
+    g_free(path);
+}
+
+void fft_plans_cleanup(void) {
+    G_LOCK(planner);
+    for (guint i = 0; i < plan_count; i++) {
+        fftw_destroy_plan(plans[i].plan);
+    }
+    for (guint i = 0; i < window_count; i++) {
+        free(windows[i].window);
+    }
+    plan_count = 0;
+    window_count = 0;
+    G_UNLOCK(planner);
+}
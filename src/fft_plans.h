@@ -0,0 +1,33 @@
+#ifndef FFT_PLANS_H
+#define FFT_PLANS_H
+
+#include <fftw3.h>
+
+// Shared FFTW plans for real signals. A plan is measured once per size and
+// direction and kept for the life of the program; callers run it on their
+// own buffers through fftw_execute_dft_r2c/c2r, which is safe from any
+// thread. Buffers must come from fftw_alloc_real/fftw_alloc_complex (for the
+// alignment the plan was made with) and the transform must be out of place:
+// `size` reals in, size / 2 + 1 complex bins out. c2r overwrites its input.
+//
+// Measuring is slow the first time, so the planner's wisdom is kept in the
+// user data dir and loaded at startup.
+
+typedef enum {
+    FFT_R2C = 0,    // Forward, real to half-spectrum
+    FFT_C2R         // Backward, unnormalised (scale by 1 / size)
+} FftDirection;
+
+// NULL if FFTW can't plan the size
+fftw_plan fft_plan_get(int size, FftDirection direction);
+
+// Symmetric Hann window of `size` points, as the vocoders use it.
+// Shared and read-only; lives as long as the plans.
+const double* fft_hann_window(int size);
+
+void fft_plans_load_wisdom(void);
+void fft_plans_save_wisdom(void);
+// Destroy every cached plan; nothing may be running them
+void fft_plans_cleanup(void);
+
+#endif
@@ -0,0 +1,74 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "history.h"
+#include "effect_chain.h"
+
+typedef struct {
+    EffectSpec chain[EFFECT_CHAIN_MAX_NODES];
+    guint chain_length;
+} HistoryEntry;
+
+static void entry_free(gpointer data) {
+    free(data);
+}
+
+static GList* trim(GList* stack) {
+    while (g_list_length(stack) > HISTORY_DEPTH) {
+        GList* oldest = g_list_last(stack);
+        entry_free(oldest->data);
+        stack = g_list_delete_link(stack, oldest);
+    }
+    return stack;
+}
+
+// Exchange the player's state with the entry's; the entry then holds what
+// is needed to go back the other way
+static void swap_state(AudioPlayer* player, HistoryEntry* entry) {
+    EffectSpec current[EFFECT_CHAIN_MAX_NODES];
+    guint length = effect_chain_get_specs(player->effects, current);
+    effect_chain_set_specs(player->effects, entry->chain, entry->chain_length);
+    memcpy(entry->chain, current, sizeof(current));
+    entry->chain_length = length;
+}
+
+void history_record(AudioPlayer* player) {
+    if (!player) return;
+
+    HistoryEntry* entry = calloc(1, sizeof(HistoryEntry));
+    if (!entry) return;
+
+    entry->chain_length = effect_chain_get_specs(player->effects, entry->chain);
+
+    player->undo_stack = trim(g_list_prepend(player->undo_stack, entry));
+    g_list_free_full(player->redo_stack, entry_free);
+    player->redo_stack = NULL;
+}
+
+gboolean history_undo(AudioPlayer* player) {
+    if (!player || !player->undo_stack) return FALSE;
+
+    HistoryEntry* entry = player->undo_stack->data;
+    player->undo_stack = g_list_delete_link(player->undo_stack, player->undo_stack);
+    swap_state(player, entry);
+    player->redo_stack = g_list_prepend(player->redo_stack, entry);
+    return TRUE;
+}
+
+gboolean history_redo(AudioPlayer* player) {
+    if (!player || !player->redo_stack) return FALSE;
+
+    HistoryEntry* entry = player->redo_stack->data;
+    player->redo_stack = g_list_delete_link(player->redo_stack, player->redo_stack);
+    swap_state(player, entry);
+    player->undo_stack = g_list_prepend(player->undo_stack, entry);
+    return TRUE;
+}
+
+void history_clear(AudioPlayer* player) {
+    if (!player) return;
+    g_list_free_full(player->undo_stack, entry_free);
+    g_list_free_full(player->redo_stack, entry_free);
+    player->undo_stack = NULL;
+    player->redo_stack = NULL;
+}
@@ -0,0 +1,16 @@
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include "types.h"
+
+// Multi-level undo/redo. Effects never rewrite the mix, so each step only
+// keeps the live effect chain as it was.
+#define HISTORY_DEPTH 32
+
+// Call before a change to the effect chain
+void history_record(AudioPlayer* player);
+gboolean history_undo(AudioPlayer* player);
+gboolean history_redo(AudioPlayer* player);
+void history_clear(AudioPlayer* player);
+
+#endif
@@ -3,6 +3,8 @@
 #include <glib/gstdio.h>
 #include "audio.h"
 #include "ui.h"
+#include "fft_plans.h"
+#include "thread_pool.h"
 
 #define APP_NAME "TasteWarp"
 #define APP_VERSION "1.0"
@@ -29,6 +31,9 @@ static char* get_resource_path(const char* filename) {
 int main(int argc, char *argv[]) {
     gtk_init(&argc, &argv);
     
+    // Measured FFT plans from earlier runs
+    fft_plans_load_wisdom();
+    
     // Get path to wav file resource
     char* wav_path = get_resource_path("wav.wav");
     AudioData* audio = load_wav_file(wav_path);
@@ -49,12 +54,18 @@ int main(int argc, char *argv[]) {
     memset(&ui, 0, sizeof(UI));
     create_ui(&ui, &player);
     
+    // Start looping playback on the audio threads
+    play_audio(&player);
+    
     // Start GTK main loop
     gtk_main();
     
     // Cleanup
     cleanup_ui(&ui);
     cleanup_audio_player(&player);
+    fft_plans_save_wisdom();
+    fft_plans_cleanup();
+    thread_pool_shutdown();
     
     return 0;
 } 
\ No newline at end of file
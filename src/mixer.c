@@ -0,0 +1,303 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include "mixer.h"
+#include "resampler.h"
+#include "simd.h"
+#include "thread_pool.h"
+
+// Frames mixed per pass; one tile of every source plus the accumulator
+// stays in L1/L2 while all sources are summed
+#define MIX_TILE 1024
+
+// Streams one source at the mix rate, a tile at a time
+typedef struct {
+    const AudioData* audio;
+    Resampler* rs;
+    size_t in_pos;              // Next source frame to decode
+    gboolean drained;           // Resampler tail has been flushed
+    gboolean produced;          // Delivered audio since the last rewind
+    float* in_planes[AUDIO_MAX_CHANNELS];
+    float* out_planes[AUDIO_MAX_CHANNELS];
+    size_t out_capacity;
+    size_t pending;             // Resampled frames not handed out yet
+    size_t pending_offset;
+    float* scratch;
+} SourceCursor;
+
+MixPolicy mix_policy_default(void) {
+    const char* name = g_getenv("TASTEWARP_MIX_POLICY");
+    if (!name || !*name) return MIX_POLICY_LOOP;
+    if (strcasecmp(name, "pad") == 0) return MIX_POLICY_PAD;
+    if (strcasecmp(name, "truncate") == 0) return MIX_POLICY_TRUNCATE;
+    if (strcasecmp(name, "loop") != 0) {
+        fprintf(stderr, "Unknown TASTEWARP_MIX_POLICY '%s', using loop\n", name);
+    }
+    return MIX_POLICY_LOOP;
+}
+
+static size_t length_at_rate(const AudioData* audio, uint32_t sample_rate) {
+    if (audio->sample_rate == sample_rate) return audio->frames;
+    return (size_t)(((guint64)audio->frames * sample_rate + audio->sample_rate - 1) / audio->sample_rate);
+}
+
+size_t mixer_length(GList* sources, uint32_t sample_rate, MixPolicy policy) {
+    if (!sources) return 0;
+
+    size_t length = length_at_rate((const AudioData*)sources->data, sample_rate);
+    if (policy == MIX_POLICY_LOOP) return length;
+
+    for (GList* l = sources->next; l != NULL; l = l->next) {
+        size_t frames = length_at_rate((const AudioData*)l->data, sample_rate);
+        length = policy == MIX_POLICY_PAD ? MAX(length, frames) : MIN(length, frames);
+    }
+    return length;
+}
+
+static gboolean cursor_init(SourceCursor* cursor, const AudioData* audio, uint32_t sample_rate) {
+    memset(cursor, 0, sizeof(SourceCursor));
+    cursor->audio = audio;
+    cursor->out_capacity = MIX_TILE;
+
+    if (audio->sample_rate != sample_rate) {
+        cursor->rs = resampler_new(audio->sample_rate, sample_rate, audio->channels,
+                                   resampler_default_quality());
+        if (!cursor->rs) return FALSE;
+        cursor->out_capacity = resampler_max_output(cursor->rs, MIX_TILE);
+    }
+
+    cursor->scratch = malloc((MIX_TILE + cursor->out_capacity) * audio->channels * sizeof(float));
+    if (!cursor->scratch) {
+        resampler_free(cursor->rs);
+        return FALSE;
+    }
+
+    for (uint16_t ch = 0; ch < audio->channels; ch++) {
+        cursor->in_planes[ch] = cursor->scratch + ch * MIX_TILE;
+        cursor->out_planes[ch] = cursor->scratch + audio->channels * MIX_TILE + ch * cursor->out_capacity;
+    }
+    return TRUE;
+}
+
+static void cursor_clear(SourceCursor* cursor) {
+    resampler_free(cursor->rs);
+    free(cursor->scratch);
+}
+
+// Restart from the top for looping; the resampler starts from fresh history
+static void cursor_rewind(SourceCursor* cursor) {
+    cursor->in_pos = 0;
+    cursor->drained = FALSE;
+    cursor->produced = FALSE;
+    cursor->pending = 0;
+    cursor->pending_offset = 0;
+    resampler_reset(cursor->rs);
+}
+
+// Point planes at up to frames of source audio; returns 0 at the end
+static size_t cursor_read(SourceCursor* cursor, size_t frames, const float** planes) {
+    const AudioData* audio = cursor->audio;
+
+    if (!cursor->rs) {
+        if (cursor->in_pos >= audio->frames) return 0;
+        size_t n = MIN(frames, audio->frames - cursor->in_pos);
+        if (audio->chunks) {
+            // Owned buffers are read in place, a chunk at a time
+            size_t offset = cursor->in_pos % AUDIO_CHUNK_FRAMES;
+            n = MIN(n, AUDIO_CHUNK_FRAMES - offset);
+            for (uint16_t ch = 0; ch < audio->channels; ch++) {
+                planes[ch] = audio_data_chunk(audio, ch, cursor->in_pos / AUDIO_CHUNK_FRAMES) + offset;
+            }
+        } else {
+            audio_data_read(audio, cursor->in_pos, n, cursor->in_planes);
+            for (uint16_t ch = 0; ch < audio->channels; ch++) planes[ch] = cursor->in_planes[ch];
+        }
+        cursor->in_pos += n;
+        return n;
+    }
+
+    while (cursor->pending == 0) {
+        cursor->pending_offset = 0;
+        if (cursor->in_pos < audio->frames) {
+            size_t n = MIN(MIX_TILE, audio->frames - cursor->in_pos);
+            audio_data_read(audio, cursor->in_pos, n, cursor->in_planes);
+            cursor->in_pos += n;
+            cursor->pending = resampler_process(cursor->rs, (const float* const*)cursor->in_planes, n,
+                                                cursor->out_planes, cursor->out_capacity);
+        } else if (!cursor->drained) {
+            cursor->drained = TRUE;
+            cursor->pending = resampler_drain(cursor->rs, cursor->out_planes, cursor->out_capacity);
+        } else {
+            return 0;
+        }
+    }
+
+    size_t n = MIN(frames, cursor->pending);
+    for (uint16_t ch = 0; ch < audio->channels; ch++) {
+        planes[ch] = cursor->out_planes[ch] + cursor->pending_offset;
+    }
+    cursor->pending_offset += n;
+    cursor->pending -= n;
+    return n;
+}
+
+static void accumulate_scalar(float* acc, const float* src, float gain, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        acc[i] += src[i] * gain;
+    }
+}
+
+static void saturate_scalar(float* dst, const float* acc, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        dst[i] = CLAMP(acc[i], -1.0f, 1.0f);
+    }
+}
+
+#ifdef HAVE_X86_SIMD
+
+static void accumulate_sse(float* acc, const float* src, float gain, size_t n) {
+    const __m128 g = _mm_set1_ps(gain);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        _mm_storeu_ps(acc + i, _mm_add_ps(_mm_loadu_ps(acc + i), _mm_mul_ps(_mm_loadu_ps(src + i), g)));
+    }
+    accumulate_scalar(acc + i, src + i, gain, n - i);
+}
+
+__attribute__((target("avx2,fma")))
+static void accumulate_fma(float* acc, const float* src, float gain, size_t n) {
+    const __m256 g = _mm256_set1_ps(gain);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        _mm256_storeu_ps(acc + i, _mm256_fmadd_ps(_mm256_loadu_ps(src + i), g, _mm256_loadu_ps(acc + i)));
+    }
+    accumulate_scalar(acc + i, src + i, gain, n - i);
+}
+
+static void saturate_sse(float* dst, const float* acc, size_t n) {
+    const __m128 lo = _mm_set1_ps(-1.0f);
+    const __m128 hi = _mm_set1_ps(1.0f);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        _mm_storeu_ps(dst + i, _mm_min_ps(_mm_max_ps(_mm_loadu_ps(acc + i), lo), hi));
+    }
+    saturate_scalar(dst + i, acc + i, n - i);
+}
+
+#endif
+
+typedef void (*AccumulateFunc)(float* acc, const float* src, float gain, size_t n);
+typedef void (*SaturateFunc)(float* dst, const float* acc, size_t n);
+
+typedef struct {
+    GList* sources;
+    AudioData* mix;
+    MixPolicy policy;
+    AccumulateFunc accumulate;
+    SaturateFunc saturate;
+} MixJob;
+
+// Cursors for every non-empty source, positioned at mix frame `start`.
+// Only sources at the mix rate can start anywhere but 0.
+static SourceCursor* open_cursors(MixJob* job, size_t start, guint* active) {
+    SourceCursor* cursors = calloc(MAX(g_list_length(job->sources), 1), sizeof(SourceCursor));
+    if (!cursors) return NULL;
+
+    *active = 0;
+    for (GList* l = job->sources; l != NULL; l = l->next) {
+        const AudioData* audio = (const AudioData*)l->data;
+        if (audio->frames == 0 || !cursor_init(&cursors[*active], audio, job->mix->sample_rate)) continue;
+        SourceCursor* cursor = &cursors[(*active)++];
+        if (start > 0) {
+            // Looping sources repeat from the top; the rest have ended or not
+            cursor->in_pos = job->policy == MIX_POLICY_LOOP ? start % audio->frames : MIN(start, audio->frames);
+            cursor->produced = TRUE;
+        }
+    }
+    return cursors;
+}
+
+static void close_cursors(SourceCursor* cursors, guint active) {
+    for (guint s = 0; s < active; s++) {
+        cursor_clear(&cursors[s]);
+    }
+    free(cursors);
+}
+
+// Mix frames [start, end); cursors continue from start
+static void mix_range(MixJob* job, SourceCursor* cursors, guint active, float* acc, size_t start, size_t end) {
+    AudioData* mix = job->mix;
+
+    // One pass over the mix: every source adds its tile into the
+    // accumulator, which is then clipped and written once
+    const float* planes[AUDIO_MAX_CHANNELS];
+    for (size_t pos = start; pos < end; pos += MIX_TILE) {
+        size_t tile = MIN(MIX_TILE, end - pos);
+        memset(acc, 0, (size_t)mix->channels * MIX_TILE * sizeof(float));
+
+        for (guint s = 0; s < active; s++) {
+            SourceCursor* cursor = &cursors[s];
+            uint16_t src_channels = cursor->audio->channels;
+            float gain = cursor->audio->mix_volume;
+            size_t filled = 0;
+
+            while (filled < tile) {
+                size_t n = cursor_read(cursor, tile - filled, planes);
+                if (n == 0) {
+                    // Only the loop policy brings an ended source back
+                    if (job->policy != MIX_POLICY_LOOP || !cursor->produced) break;
+                    cursor_rewind(cursor);
+                    continue;
+                }
+                cursor->produced = TRUE;
+                // Mono sources feed every mix channel
+                for (uint16_t ch = 0; ch < mix->channels; ch++) {
+                    job->accumulate(acc + ch * MIX_TILE + filled, planes[ch % src_channels], gain, n);
+                }
+                filled += n;
+            }
+        }
+
+        // Tiles never straddle a chunk since MIX_TILE divides AUDIO_CHUNK_FRAMES
+        for (uint16_t ch = 0; ch < mix->channels; ch++) {
+            float* dst = audio_data_chunk_mut(mix, ch, pos / AUDIO_CHUNK_FRAMES);
+            if (dst) job->saturate(dst + pos % AUDIO_CHUNK_FRAMES, acc + ch * MIX_TILE, tile);
+        }
+    }
+}
+
+// Mix chunks [begin, end), from cursors of its own
+static void mix_chunks(gpointer data, size_t begin, size_t end) {
+    MixJob* job = data;
+    size_t start = begin * AUDIO_CHUNK_FRAMES;
+    guint active = 0;
+    SourceCursor* cursors = open_cursors(job, start, &active);
+    float* acc = aligned_alloc(AUDIO_PLANE_ALIGN, (size_t)job->mix->channels * MIX_TILE * sizeof(float));
+    if (cursors && acc) {
+        mix_range(job, cursors, active, acc, start, MIN(end * AUDIO_CHUNK_FRAMES, job->mix->frames));
+    } else {
+        fprintf(stderr, "mixer: out of memory\n");
+    }
+    if (cursors) close_cursors(cursors, active);
+    free(acc);
+}
+
+void mixer_render(GList* sources, AudioData* mix, MixPolicy policy) {
+    if (!mix || !mix->chunks) return;
+
+    MixJob job = { sources, mix, policy, accumulate_scalar, saturate_scalar };
+#ifdef HAVE_X86_SIMD
+    job.accumulate = simd_have_avx2() && simd_have_fma() ? accumulate_fma : accumulate_sse;
+    job.saturate = saturate_sse;
+#endif
+
+    // Sources at the mix rate can be read from anywhere, so chunks of the mix
+    // are independent and go to the thread pool. A resampler's output
+    // depends on everything before it, so those mixes stay in one pass.
+    gboolean seekable = TRUE;
+    for (GList* l = sources; l != NULL; l = l->next) {
+        if (((const AudioData*)l->data)->sample_rate != mix->sample_rate) seekable = FALSE;
+    }
+    parallel_for(mix->chunk_count, seekable ? 1 : mix->chunk_count, mix_chunks, &job);
+}
@@ -0,0 +1,26 @@
+#ifndef MIXER_H
+#define MIXER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <glib.h>
+#include "audio.h"
+
+// How sources of different lengths fill the mix
+typedef enum {
+    MIX_POLICY_LOOP,        // Mix is as long as the first source; shorter ones repeat
+    MIX_POLICY_PAD,         // Mix is as long as the longest source; shorter ones end in silence
+    MIX_POLICY_TRUNCATE     // Mix is as long as the shortest source
+} MixPolicy;
+
+// Policy from TASTEWARP_MIX_POLICY (loop, pad or truncate)
+MixPolicy mix_policy_default(void);
+
+// Length in frames at sample_rate that the sources produce under policy
+size_t mixer_length(GList* sources, uint32_t sample_rate, MixPolicy policy);
+
+// Overwrite mix with the gain-weighted, saturated sum of all sources,
+// resampling any whose rate differs from the mix
+void mixer_render(GList* sources, AudioData* mix, MixPolicy policy);
+
+#endif
@@ -0,0 +1,120 @@
+#include <math.h>
+#include <glib.h>
+#include "oscillator.h"
+#include "simd.h"
+
+#define TABLE_BITS 11
+#define TABLE_SIZE (1 << TABLE_BITS)
+#define FRAC_BITS (32 - TABLE_BITS)
+#define MAX_HARMONIC 64
+
+// One extra entry repeats the first, so interpolation never wraps
+static float tables[OSC_WAVEFORM_COUNT][TABLE_SIZE + 1];
+static gsize tables_ready = 0;
+
+static void build_tables(void) {
+    for (int i = 0; i <= TABLE_SIZE; i++) {
+        double x = 2.0 * M_PI * i / TABLE_SIZE;
+        double square = 0.0, saw = 0.0;
+        for (int k = 1; k <= MAX_HARMONIC; k++) {
+            if (k % 2 == 1) square += sin(k * x) / k;
+            saw += (k % 2 == 1 ? 1.0 : -1.0) * sin(k * x) / k;
+        }
+        tables[OSC_SINE][i] = (float)sin(x);
+        tables[OSC_SQUARE][i] = (float)(square * 4.0 / M_PI);
+        tables[OSC_SAW][i] = (float)(saw * 2.0 / M_PI);
+    }
+
+    // Band-limiting overshoots the edges; scale back to -1..1
+    for (int w = OSC_SQUARE; w < OSC_WAVEFORM_COUNT; w++) {
+        float peak = 0.0f;
+        for (int i = 0; i < TABLE_SIZE; i++) {
+            peak = MAX(peak, fabsf(tables[w][i]));
+        }
+        for (int i = 0; i <= TABLE_SIZE; i++) {
+            tables[w][i] /= peak;
+        }
+    }
+}
+
+static const float* table_for(OscWaveform waveform) {
+    if (g_once_init_enter(&tables_ready)) {
+        build_tables();
+        g_once_init_leave(&tables_ready, 1);
+    }
+    return tables[waveform < OSC_WAVEFORM_COUNT ? waveform : OSC_SINE];
+}
+
+void oscillator_init(Oscillator* osc, OscWaveform waveform, double frequency, uint32_t sample_rate) {
+    osc->waveform = waveform < OSC_WAVEFORM_COUNT ? waveform : OSC_SINE;
+    osc->phase = 0;
+    oscillator_set_frequency(osc, frequency, sample_rate);
+}
+
+void oscillator_set_frequency(Oscillator* osc, double frequency, uint32_t sample_rate) {
+    if (sample_rate == 0) {
+        osc->increment = 0;
+        return;
+    }
+    // Whole cycles per sample alias away, as they would for any sampled wave
+    double cycles = frequency / sample_rate;
+    cycles -= floor(cycles);
+    osc->increment = (uint32_t)(uint64_t)llround(cycles * 4294967296.0);
+}
+
+static uint32_t render_scalar(const float* table, uint32_t phase, uint32_t increment,
+                              float* out, size_t frames) {
+    const float scale = 1.0f / (1 << FRAC_BITS);
+    for (size_t i = 0; i < frames; i++) {
+        uint32_t index = phase >> FRAC_BITS;
+        float frac = (float)(int32_t)(phase & ((1u << FRAC_BITS) - 1)) * scale;
+        float a = table[index];
+        out[i] = a + (table[index + 1] - a) * frac;
+        phase += increment;
+    }
+    return phase;
+}
+
+#ifdef HAVE_X86_SIMD
+
+// Same arithmetic as render_scalar, eight phases at a time
+__attribute__((target("avx2")))
+static uint32_t render_avx2(const float* table, uint32_t phase, uint32_t increment,
+                            float* out, size_t frames) {
+    const __m256i frac_mask = _mm256_set1_epi32((1 << FRAC_BITS) - 1);
+    const __m256 scale = _mm256_set1_ps(1.0f / (1 << FRAC_BITS));
+    const __m256i step = _mm256_set1_epi32((int32_t)(increment * 8u));
+    __m256i phases = _mm256_add_epi32(_mm256_set1_epi32((int32_t)phase),
+                                      _mm256_mullo_epi32(_mm256_set1_epi32((int32_t)increment),
+                                                         _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7)));
+    size_t i = 0;
+    for (; i + 8 <= frames; i += 8) {
+        __m256i index = _mm256_srli_epi32(phases, FRAC_BITS);
+        __m256 frac = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_and_si256(phases, frac_mask)), scale);
+        __m256 a = _mm256_i32gather_ps(table, index, 4);
+        __m256 b = _mm256_i32gather_ps(table + 1, index, 4);
+        _mm256_storeu_ps(out + i, _mm256_add_ps(a, _mm256_mul_ps(_mm256_sub_ps(b, a), frac)));
+        phases = _mm256_add_epi32(phases, step);
+    }
+    phase += (uint32_t)i * increment;
+    return render_scalar(table, phase, increment, out + i, frames - i);
+}
+
+#endif
+
+void oscillator_render(Oscillator* osc, float* out, size_t frames) {
+    const float* table = table_for(osc->waveform);
+#ifdef HAVE_X86_SIMD
+    if (simd_have_avx2()) {
+        osc->phase = render_avx2(table, osc->phase, osc->increment, out, frames);
+        return;
+    }
+#endif
+    osc->phase = render_scalar(table, osc->phase, osc->increment, out, frames);
+}
+
+OscWaveform oscillator_waveform_from_param(float value) {
+    if (!(value >= 0.0f)) return OSC_SINE;
+    int waveform = (int)lrintf(value);
+    return waveform < OSC_WAVEFORM_COUNT ? (OscWaveform)waveform : OSC_WAVEFORM_COUNT - 1;
+}
@@ -0,0 +1,36 @@
+#ifndef OSCILLATOR_H
+#define OSCILLATOR_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Wavetable oscillator. The phase is a 32-bit fixed-point fraction of a
+// cycle, so it wraps exactly and never loses precision however long it runs;
+// samples are linearly interpolated from a 2048-entry table, within 2e-6 of
+// the ideal sine. Square and saw tables are band-limited to 64 harmonics.
+// Blocks render with AVX2 gathers where available.
+
+typedef enum {
+    OSC_SINE = 0,
+    OSC_SQUARE,
+    OSC_SAW,
+    OSC_WAVEFORM_COUNT
+} OscWaveform;
+
+typedef struct {
+    OscWaveform waveform;
+    uint32_t phase;         // Fraction of a cycle, in units of 2^-32
+    uint32_t increment;     // Per sample
+} Oscillator;
+
+// Starts at phase 0, where every waveform is 0 and rising
+void oscillator_init(Oscillator* osc, OscWaveform waveform, double frequency, uint32_t sample_rate);
+void oscillator_set_frequency(Oscillator* osc, double frequency, uint32_t sample_rate);
+
+// Next `frames` samples, -1..1
+void oscillator_render(Oscillator* osc, float* out, size_t frames);
+
+// Waveform from an effect parameter, rounding and clamping
+OscWaveform oscillator_waveform_from_param(float value);
+
+#endif
@@ -0,0 +1,413 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glib.h>
+
+#include "playback.h"
+#include "ringbuffer.h"
+#include "audio.h"
+#include "effect_chain.h"
+
+// One slot in the ring: a block of interleaved samples plus the mix frame it
+// started at, so the audio side can report exactly what is being heard
+typedef struct {
+    size_t position;
+    size_t frames;
+    size_t mix_frames;      // Length of the mix it came from, for wrapping
+    size_t history_end;     // history_written once it was rendered
+    int16_t samples[];
+} PlaybackBlock;
+
+struct PlaybackEngine {
+    AudioPlayer* player;
+    AudioBackend* backend;
+    RingBuffer* ring;
+    GThread* render_thread;
+    GThread* output_thread;
+    gint state;             // PlaybackState, accessed atomically
+    gint quit;              // Tells the threads to exit
+    GMutex wake_lock;       // Doorbell so an idle side sleeps instead of polling;
+    GCond wake_cond;        // the ring itself stays lock-free
+    size_t render_pos;      // Next mix frame to render (render thread only)
+    size_t block_frames;
+    size_t blocks_ahead;    // How many blocks the render thread may queue
+    uint16_t channels;
+    uint32_t sample_rate;
+    float* scratch[AUDIO_MAX_CHANNELS];     // One block after effects
+    size_t scratch_mix_frames;              // Mix length seen while filling it
+
+    // Everything rendered recently, after effects, for export
+    float* history[AUDIO_MAX_CHANNELS];
+    size_t history_frames;
+    size_t history_written;                 // Total frames ever, accessed atomically
+    size_t history_heard;                   // Of those, up to the speaker, accessed atomically
+};
+
+static size_t mix_frames(AudioData* mix) {
+    if (!mix || !mix->chunks) return 0;
+    return mix->frames;
+}
+
+static void publish_position(PlaybackEngine* engine, size_t position, size_t total) {
+    if (total > 0) position %= total;
+    __atomic_store_n(&engine->player->ring_buffer_pos, position, __ATOMIC_RELEASE);
+}
+
+// Effect chain source: the next frames of the looping mix. The mix is held
+// only while copying so the UI can't swap it out underneath.
+static void read_mix(gpointer data, float* const* planes, size_t frames) {
+    PlaybackEngine* engine = (PlaybackEngine*)data;
+    g_mutex_lock(&engine->player->mix_lock);
+
+    AudioData* mix = engine->player->active_mix;
+    size_t total = mix_frames(mix);
+    engine->scratch_mix_frames = total;
+
+    if (total == 0 || mix->channels != engine->channels) {
+        g_mutex_unlock(&engine->player->mix_lock);
+        for (size_t ch = 0; ch < engine->channels; ch++) {
+            memset(planes[ch], 0, frames * sizeof(float));
+        }
+        return;
+    }
+
+    if (engine->render_pos >= total) engine->render_pos = 0;
+
+    float* dst[AUDIO_MAX_CHANNELS];
+    size_t done = 0;
+    while (done < frames) {
+        size_t chunk = MIN(frames - done, total - engine->render_pos);
+        for (size_t ch = 0; ch < engine->channels; ch++) {
+            dst[ch] = planes[ch] + done;
+        }
+        audio_data_read(mix, engine->render_pos, chunk, dst);
+        done += chunk;
+        engine->render_pos += chunk;
+        if (engine->render_pos >= total) engine->render_pos = 0;
+    }
+
+    g_mutex_unlock(&engine->player->mix_lock);
+}
+
+static void record_history(PlaybackEngine* engine, size_t frames) {
+    size_t written = __atomic_load_n(&engine->history_written, __ATOMIC_RELAXED);
+    size_t done = 0;
+    while (done < frames) {
+        size_t at = (written + done) % engine->history_frames;
+        size_t chunk = MIN(frames - done, engine->history_frames - at);
+        for (size_t ch = 0; ch < engine->channels; ch++) {
+            memcpy(engine->history[ch] + at, engine->scratch[ch] + done, chunk * sizeof(float));
+        }
+        done += chunk;
+    }
+    __atomic_store_n(&engine->history_written, written + frames, __ATOMIC_RELEASE);
+}
+
+// Render the next block: pull the mix through the live effects, keep a copy
+// for export, and quantise for the device
+static void render_block(PlaybackEngine* engine, PlaybackBlock* block) {
+    block->frames = engine->block_frames;
+    block->position = engine->render_pos;
+
+    effect_chain_process(engine->player->effects, read_mix, engine,
+                         engine->scratch, block->frames);
+
+    block->mix_frames = engine->scratch_mix_frames;
+    if (block->mix_frames == 0) block->position = 0;
+
+    record_history(engine, block->frames);
+    block->history_end = __atomic_load_n(&engine->history_written, __ATOMIC_RELAXED);
+    sample_encode_planar(SAMPLE_S16, (const float* const*)engine->scratch, engine->channels,
+                         block->frames, block->samples);
+}
+
+static gulong block_usec(PlaybackEngine* engine) {
+    return (gulong)((guint64)engine->block_frames * G_USEC_PER_SEC / engine->sample_rate);
+}
+
+// Sleep until the other side rings or the timeout passes
+static void wait_for_ring(PlaybackEngine* engine, gulong usec) {
+    g_mutex_lock(&engine->wake_lock);
+    g_cond_wait_until(&engine->wake_cond, &engine->wake_lock, g_get_monotonic_time() + usec);
+    g_mutex_unlock(&engine->wake_lock);
+}
+
+static void ring_doorbell(PlaybackEngine* engine) {
+    g_mutex_lock(&engine->wake_lock);
+    g_cond_broadcast(&engine->wake_cond);
+    g_mutex_unlock(&engine->wake_lock);
+}
+
+static gpointer render_thread_func(gpointer data) {
+    PlaybackEngine* engine = (PlaybackEngine*)data;
+    gulong idle_usec = block_usec(engine) / 2;
+
+    while (!g_atomic_int_get(&engine->quit)) {
+        if (g_atomic_int_get(&engine->state) != PLAYBACK_PLAYING) {
+            g_usleep(idle_usec);
+            continue;
+        }
+
+        // Staying only a few blocks ahead keeps effects audible quickly
+        PlaybackBlock* block = NULL;
+        if (ring_buffer_count(engine->ring) < engine->blocks_ahead) {
+            block = ring_buffer_write_slot(engine->ring);
+        }
+        if (!block) {
+            wait_for_ring(engine, idle_usec);
+            continue;
+        }
+
+        render_block(engine, block);
+        ring_buffer_commit_write(engine->ring);
+        ring_doorbell(engine);
+    }
+
+    return NULL;
+}
+
+// Audio-side consumer: hands blocks to the backend, never touches GTK
+static gpointer output_thread_func(gpointer data) {
+    PlaybackEngine* engine = (PlaybackEngine*)data;
+    AudioBackend* backend = engine->backend;
+    gulong idle_usec = block_usec(engine) / 2;
+
+    while (!g_atomic_int_get(&engine->quit)) {
+        if (g_atomic_int_get(&engine->state) != PLAYBACK_PLAYING) {
+            g_usleep(idle_usec);
+            continue;
+        }
+
+        const PlaybackBlock* block = ring_buffer_read_slot(engine->ring);
+        if (!block) {
+            // Underrun: the render thread will catch up within a block
+            wait_for_ring(engine, idle_usec);
+            continue;
+        }
+
+        if (!backend->ops->write(backend, block->samples, block->frames)) {
+            // Paused or failed; leave the block queued for when we resume
+            g_usleep(idle_usec);
+            continue;
+        }
+
+        guint64 latency = backend->ops->latency(backend);
+        __atomic_store_n(&engine->player->output_latency_usec, latency, __ATOMIC_RELAXED);
+        if (backend->ops->xruns) {
+            __atomic_store_n(&engine->player->output_xruns, backend->ops->xruns(backend), __ATOMIC_RELAXED);
+        }
+
+        // Report the frame leaving the speakers, not the one just queued
+        size_t latency_frames = (size_t)(latency * engine->sample_rate / G_USEC_PER_SEC);
+        size_t total = block->mix_frames;
+        size_t heard = block->position + block->frames;
+        if (total > 0) heard += total - latency_frames % total;
+        publish_position(engine, heard, total);
+        __atomic_store_n(&engine->history_heard, block->history_end - MIN(latency_frames, block->history_end),
+                         __ATOMIC_RELEASE);
+
+        ring_buffer_commit_read(engine->ring);
+        ring_doorbell(engine);
+    }
+
+    return NULL;
+}
+
+static void free_planes(PlaybackEngine* engine) {
+    for (size_t ch = 0; ch < AUDIO_MAX_CHANNELS; ch++) {
+        free(engine->scratch[ch]);
+        free(engine->history[ch]);
+    }
+}
+
+PlaybackEngine* playback_engine_new(AudioPlayer* player, const AudioBackendConfig* config) {
+    if (!player || !player->active_mix) return NULL;
+
+    PlaybackEngine* engine = calloc(1, sizeof(PlaybackEngine));
+    if (!engine) return NULL;
+
+    engine->player = player;
+    engine->block_frames = PLAYBACK_BLOCK_FRAMES;
+    engine->channels = player->active_mix->channels;
+    engine->sample_rate = player->target_sample_rate;
+
+    AudioBackendConfig backend_config;
+    if (config) {
+        backend_config = *config;
+    } else {
+        audio_backend_config_default(&backend_config);
+    }
+    backend_config.sample_rate = engine->sample_rate;
+    backend_config.channels = engine->channels;
+
+    // Queue at most the target latency worth of blocks (but at least two)
+    size_t latency_frames = (size_t)backend_config.target_latency_ms * engine->sample_rate / 1000;
+    engine->blocks_ahead = CLAMP(latency_frames / engine->block_frames, 2, PLAYBACK_RING_BLOCKS);
+
+    g_mutex_init(&engine->wake_lock);
+    g_cond_init(&engine->wake_cond);
+
+    // A second on top of the export length covers blocks not yet heard
+    engine->history_frames = (size_t)engine->sample_rate * (PLAYBACK_HISTORY_SECONDS + 1);
+    gboolean planes_ok = TRUE;
+    for (size_t ch = 0; ch < engine->channels; ch++) {
+        engine->scratch[ch] = calloc(engine->block_frames, sizeof(float));
+        engine->history[ch] = calloc(engine->history_frames, sizeof(float));
+        if (!engine->scratch[ch] || !engine->history[ch]) planes_ok = FALSE;
+    }
+
+    size_t slot_size = sizeof(PlaybackBlock) +
+                       engine->block_frames * engine->channels * sizeof(int16_t);
+    engine->ring = planes_ok ? ring_buffer_new(slot_size, PLAYBACK_RING_BLOCKS) : NULL;
+    engine->backend = engine->ring ? audio_backend_open(&backend_config) : NULL;
+
+    if (!engine->backend) {
+        g_cond_clear(&engine->wake_cond);
+        g_mutex_clear(&engine->wake_lock);
+        ring_buffer_free(engine->ring);
+        free_planes(engine);
+        free(engine);
+        return NULL;
+    }
+
+    return engine;
+}
+
+void playback_engine_free(PlaybackEngine* engine) {
+    if (!engine) return;
+    playback_stop(engine);
+    audio_backend_close(engine->backend);
+    ring_buffer_free(engine->ring);
+    free_planes(engine);
+    g_cond_clear(&engine->wake_cond);
+    g_mutex_clear(&engine->wake_lock);
+    free(engine);
+}
+
+// Swap a backend that won't start for the null sink, as audio_backend_open()
+// does for one that won't open. Only before the output thread has taken it.
+static gboolean start_null_backend(PlaybackEngine* engine) {
+    if (engine->output_thread) return FALSE;
+
+    AudioBackendConfig config = engine->backend->config;
+    config.name = "null";
+    AudioBackend* backend = audio_backend_open(&config);
+    if (!backend || !backend->ops->start(backend)) {
+        audio_backend_close(backend);
+        return FALSE;
+    }
+    audio_backend_close(engine->backend);
+    engine->backend = backend;
+    return TRUE;
+}
+
+gboolean playback_start(PlaybackEngine* engine) {
+    if (!engine) return FALSE;
+    if (g_atomic_int_get(&engine->state) == PLAYBACK_PLAYING) return TRUE;
+
+    if (!engine->backend->ops->start(engine->backend)) {
+        fprintf(stderr, "Audio backend %s failed to start\n", engine->backend->ops->name);
+        if (!start_null_backend(engine)) return FALSE;
+    }
+
+    g_atomic_int_set(&engine->quit, 0);
+    g_atomic_int_set(&engine->state, PLAYBACK_PLAYING);
+    if (!engine->render_thread) {
+        engine->render_thread = g_thread_new("tastewarp-render", render_thread_func, engine);
+    }
+    if (!engine->output_thread) {
+        engine->output_thread = g_thread_new("tastewarp-output", output_thread_func, engine);
+    }
+    return TRUE;
+}
+
+void playback_pause(PlaybackEngine* engine) {
+    if (!engine) return;
+
+    // Threads stay alive and queued blocks are kept, so resuming is instant
+    if (g_atomic_int_get(&engine->state) == PLAYBACK_PLAYING) {
+        g_atomic_int_set(&engine->state, PLAYBACK_PAUSED);
+        engine->backend->ops->pause(engine->backend);
+    }
+}
+
+void playback_stop(PlaybackEngine* engine) {
+    if (!engine) return;
+
+    g_atomic_int_set(&engine->state, PLAYBACK_STOPPED);
+    g_atomic_int_set(&engine->quit, 1);
+
+    // Pausing the backend releases an output thread blocked in write()
+    engine->backend->ops->pause(engine->backend);
+
+    if (engine->render_thread) {
+        g_thread_join(engine->render_thread);
+        engine->render_thread = NULL;
+    }
+    if (engine->output_thread) {
+        g_thread_join(engine->output_thread);
+        engine->output_thread = NULL;
+    }
+
+    // Both sides are idle now, so the ring can be rewound safely
+    ring_buffer_reset(engine->ring);
+    engine->render_pos = 0;
+    publish_position(engine, 0, 0);
+}
+
+PlaybackState playback_get_state(PlaybackEngine* engine) {
+    if (!engine) return PLAYBACK_STOPPED;
+    return (PlaybackState)g_atomic_int_get(&engine->state);
+}
+
+const char* playback_backend_name(PlaybackEngine* engine) {
+    return engine ? engine->backend->ops->name : "none";
+}
+
+// Frames of history that can be read while the render thread writes: it
+// stays clear of the part that may be overwritten
+static size_t history_usable(PlaybackEngine* engine) {
+    return engine->history_frames - PLAYBACK_RING_BLOCKS * engine->block_frames;
+}
+
+static void copy_history(PlaybackEngine* engine, size_t start, float* const* dst, size_t frames) {
+    size_t done = 0;
+    while (done < frames) {
+        size_t at = (start + done) % engine->history_frames;
+        size_t chunk = MIN(frames - done, engine->history_frames - at);
+        for (size_t ch = 0; ch < engine->channels; ch++) {
+            memcpy(dst[ch] + done, engine->history[ch] + at, chunk * sizeof(float));
+        }
+        done += chunk;
+    }
+}
+
+size_t playback_copy_history(PlaybackEngine* engine, float* const* dst, size_t frames) {
+    if (!engine) return 0;
+
+    size_t written = __atomic_load_n(&engine->history_written, __ATOMIC_ACQUIRE);
+    frames = MIN(frames, MIN(written, history_usable(engine)));
+    copy_history(engine, written - frames, dst, frames);
+    return frames;
+}
+
+size_t playback_history_heard(PlaybackEngine* engine) {
+    return engine ? __atomic_load_n(&engine->history_heard, __ATOMIC_ACQUIRE) : 0;
+}
+
+gboolean playback_read_history(PlaybackEngine* engine, size_t end, float* const* dst, size_t frames) {
+    if (!engine || end < frames) return FALSE;
+
+    size_t written = __atomic_load_n(&engine->history_written, __ATOMIC_ACQUIRE);
+    if (end > written || written - (end - frames) > history_usable(engine)) return FALSE;
+    copy_history(engine, end - frames, dst, frames);
+    return TRUE;
+}
+
+uint16_t playback_channels(PlaybackEngine* engine) {
+    return engine ? engine->channels : 0;
+}
+
+uint32_t playback_sample_rate(PlaybackEngine* engine) {
+    return engine ? engine->sample_rate : 0;
+}
@@ -0,0 +1,51 @@
+#ifndef PLAYBACK_H
+#define PLAYBACK_H
+
+#include "types.h"
+#include "audio_backend.h"
+
+// Frames rendered per block and number of blocks queued ahead of the device
+#define PLAYBACK_BLOCK_FRAMES 256
+#define PLAYBACK_RING_BLOCKS 8
+// Rendered output kept for export
+#define PLAYBACK_HISTORY_SECONDS 60
+
+typedef enum {
+    PLAYBACK_STOPPED = 0,
+    PLAYBACK_PLAYING,
+    PLAYBACK_PAUSED
+} PlaybackState;
+
+// The engine runs a render thread that pulls the active mix through the
+// player's live effect chain in fixed-size blocks and pushes them through a
+// lock-free SPSC ring, and an audio-side consumer that feeds the selected AudioBackend and advances ring_buffer_pos.
+// Neither side ever waits on the GTK main loop.
+typedef struct PlaybackEngine PlaybackEngine;
+
+// NULL config means audio_backend_config_default(); rate and channels are
+// always taken from the player
+PlaybackEngine* playback_engine_new(AudioPlayer* player, const AudioBackendConfig* config);
+void playback_engine_free(PlaybackEngine* engine);
+
+// FALSE, leaving the state as it was, if the backend won't start and can't
+// be swapped for the null sink
+gboolean playback_start(PlaybackEngine* engine);
+void playback_pause(PlaybackEngine* engine);
+void playback_stop(PlaybackEngine* engine);
+PlaybackState playback_get_state(PlaybackEngine* engine);
+const char* playback_backend_name(PlaybackEngine* engine);
+uint16_t playback_channels(PlaybackEngine* engine);
+uint32_t playback_sample_rate(PlaybackEngine* engine);
+
+// Copy the most recently rendered frames, effects included, into dst (one
+// plane per channel). Returns how many frames were available.
+size_t playback_copy_history(PlaybackEngine* engine, float* const* dst, size_t frames);
+
+// Where the speaker is in the history, counting every frame rendered since
+// the engine was made; only grows, and stops while paused. Any thread.
+size_t playback_history_heard(PlaybackEngine* engine);
+// Copy the `frames` of history that end at position `end`. FALSE if they
+// haven't all been rendered or are no longer kept.
+gboolean playback_read_history(PlaybackEngine* engine, size_t end, float* const* dst, size_t frames);
+
+#endif
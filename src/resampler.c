@@ -0,0 +1,284 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <math.h>
+#include <glib.h>
+#include "resampler.h"
+#include "simd.h"
+
+// Phases beyond this are approximated by the nearest stored phase
+#define RESAMPLER_MAX_PHASES 1024
+#define RESAMPLER_MAX_TAPS 512
+#define RESAMPLER_ALIGN 64
+
+struct Resampler {
+    uint16_t channels;
+    size_t up;              // Output rate / gcd
+    size_t down;            // Input rate / gcd
+    size_t phases;          // Rows in the filter bank
+    size_t taps;            // Multiple of 8 so rows vectorise without tails
+    float* bank;            // phases x taps, aligned
+
+    float** history;        // Per channel: unread input, oldest first
+    size_t history_len;
+    size_t history_cap;
+    size_t window;          // Start of the next output's window in history
+    size_t frac;            // Fractional position, in units of 1/up input frames
+};
+
+typedef struct {
+    size_t taps;
+    double rolloff;         // Passband edge as a fraction of Nyquist
+    double beta;            // Kaiser window shape
+} QualityParams;
+
+static const QualityParams quality_params[] = {
+    [RESAMPLER_FAST] = {16, 0.85, 5.0},
+    [RESAMPLER_MEDIUM] = {32, 0.92, 7.5},
+    [RESAMPLER_BEST] = {64, 0.96, 9.5},
+};
+
+static size_t gcd(size_t a, size_t b) {
+    while (b) {
+        size_t t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+// Zeroth-order modified Bessel function, for the Kaiser window
+static double bessel_i0(double x) {
+    double sum = 1.0, term = 1.0;
+    for (int k = 1; k < 50; k++) {
+        term *= (x / (2.0 * k)) * (x / (2.0 * k));
+        sum += term;
+        if (term < sum * 1e-12) break;
+    }
+    return sum;
+}
+
+// Row p of the bank holds the filter for an output p/phases of the way
+// between two input frames. Tap k weights input frame (k - taps/2 + 1).
+static void build_bank(Resampler* rs, double cutoff, double beta) {
+    double half = rs->taps / 2.0;
+    double norm = bessel_i0(beta);
+
+    for (size_t p = 0; p < rs->phases; p++) {
+        float* row = rs->bank + p * rs->taps;
+        double offset = (double)p / rs->phases;
+        double sum = 0.0;
+
+        for (size_t k = 0; k < rs->taps; k++) {
+            double x = (double)k - half + 1.0 - offset;
+            double sinc = fabs(x) < 1e-9 ? 1.0 : sin(M_PI * cutoff * x) / (M_PI * cutoff * x);
+            double r = x / half;
+            double window = fabs(r) >= 1.0 ? 0.0 : bessel_i0(beta * sqrt(1.0 - r * r)) / norm;
+            row[k] = (float)(cutoff * sinc * window);
+            sum += row[k];
+        }
+
+        // Unity gain at DC for every phase, or the output ripples with the phase
+        for (size_t k = 0; k < rs->taps; k++) {
+            row[k] = (float)(row[k] / sum);
+        }
+    }
+}
+
+Resampler* resampler_new(uint32_t in_rate, uint32_t out_rate, uint16_t channels,
+                         ResamplerQuality quality) {
+    if (in_rate == 0 || out_rate == 0 || channels == 0) return NULL;
+    if (quality > RESAMPLER_BEST) quality = RESAMPLER_MEDIUM;
+
+    Resampler* rs = calloc(1, sizeof(Resampler));
+    if (!rs) return NULL;
+
+    size_t g = gcd(in_rate, out_rate);
+    rs->channels = channels;
+    rs->up = out_rate / g;
+    rs->down = in_rate / g;
+    rs->phases = MIN(rs->up, RESAMPLER_MAX_PHASES);
+
+    // When downsampling the passband shrinks, so widen the filter to keep
+    // the same number of zero crossings
+    const QualityParams* params = &quality_params[quality];
+    double ratio = MIN(1.0, (double)out_rate / in_rate);
+    size_t taps = (size_t)ceil(params->taps / ratio);
+    rs->taps = MIN((taps + 7) & ~(size_t)7, RESAMPLER_MAX_TAPS);
+
+    size_t bank_bytes = rs->phases * rs->taps * sizeof(float);
+    rs->bank = aligned_alloc(RESAMPLER_ALIGN, (bank_bytes + RESAMPLER_ALIGN - 1) & ~(size_t)(RESAMPLER_ALIGN - 1));
+    rs->history = calloc(channels, sizeof(float*));
+    if (!rs->bank || !rs->history) {
+        resampler_free(rs);
+        return NULL;
+    }
+    build_bank(rs, ratio * params->rolloff, params->beta);
+
+    rs->history_cap = rs->taps * 2;
+    for (uint16_t ch = 0; ch < channels; ch++) {
+        rs->history[ch] = malloc(rs->history_cap * sizeof(float));
+        if (!rs->history[ch]) {
+            resampler_free(rs);
+            return NULL;
+        }
+    }
+
+    resampler_reset(rs);
+    return rs;
+}
+
+void resampler_reset(Resampler* rs) {
+    if (!rs) return;
+
+    // Start with taps/2 - 1 frames of silence so output 0 lines up with input 0
+    rs->history_len = rs->taps / 2 - 1;
+    rs->window = 0;
+    rs->frac = 0;
+    for (uint16_t ch = 0; ch < rs->channels; ch++) {
+        memset(rs->history[ch], 0, rs->history_len * sizeof(float));
+    }
+}
+
+void resampler_free(Resampler* rs) {
+    if (!rs) return;
+
+    if (rs->history) {
+        for (uint16_t ch = 0; ch < rs->channels; ch++) {
+            free(rs->history[ch]);
+        }
+        free(rs->history);
+    }
+    free(rs->bank);
+    free(rs);
+}
+
+size_t resampler_max_output(const Resampler* rs, size_t in_frames) {
+    // Everything already buffered plus the new input, rounded up
+    size_t frames = rs->history_len + in_frames + rs->taps;
+    return frames * rs->up / rs->down + 1;
+}
+
+static float dot_scalar(const float* coeffs, const float* x, size_t taps) {
+    float sum = 0.0f;
+    for (size_t k = 0; k < taps; k++) {
+        sum += coeffs[k] * x[k];
+    }
+    return sum;
+}
+
+#ifdef HAVE_X86_SIMD
+
+static float dot_sse(const float* coeffs, const float* x, size_t taps) {
+    __m128 acc0 = _mm_setzero_ps();
+    __m128 acc1 = _mm_setzero_ps();
+    for (size_t k = 0; k < taps; k += 8) {
+        acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_load_ps(coeffs + k), _mm_loadu_ps(x + k)));
+        acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_load_ps(coeffs + k + 4), _mm_loadu_ps(x + k + 4)));
+    }
+    __m128 acc = _mm_add_ps(acc0, acc1);
+    acc = _mm_add_ps(acc, _mm_movehl_ps(acc, acc));
+    acc = _mm_add_ss(acc, _mm_shuffle_ps(acc, acc, 1));
+    return _mm_cvtss_f32(acc);
+}
+
+__attribute__((target("avx2,fma")))
+static float dot_fma(const float* coeffs, const float* x, size_t taps) {
+    __m256 acc = _mm256_setzero_ps();
+    for (size_t k = 0; k < taps; k += 8) {
+        acc = _mm256_fmadd_ps(_mm256_load_ps(coeffs + k), _mm256_loadu_ps(x + k), acc);
+    }
+    __m128 sum = _mm_add_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1));
+    sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+    sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+    return _mm_cvtss_f32(sum);
+}
+
+#endif
+
+typedef float (*DotFunc)(const float* coeffs, const float* x, size_t taps);
+
+static DotFunc pick_dot(void) {
+#ifdef HAVE_X86_SIMD
+    if (simd_have_avx2() && simd_have_fma()) return dot_fma;
+    return dot_sse;
+#else
+    return dot_scalar;
+#endif
+}
+
+static gboolean append_input(Resampler* rs, const float* const* in, size_t frames) {
+    size_t needed = rs->history_len + frames;
+    if (needed > rs->history_cap) {
+        size_t cap = MAX(needed, rs->history_cap * 2);
+        for (uint16_t ch = 0; ch < rs->channels; ch++) {
+            float* grown = realloc(rs->history[ch], cap * sizeof(float));
+            if (!grown) return FALSE;
+            rs->history[ch] = grown;
+        }
+        rs->history_cap = cap;
+    }
+
+    for (uint16_t ch = 0; ch < rs->channels; ch++) {
+        if (in) {
+            memcpy(rs->history[ch] + rs->history_len, in[ch], frames * sizeof(float));
+        } else {
+            memset(rs->history[ch] + rs->history_len, 0, frames * sizeof(float));
+        }
+    }
+    rs->history_len = needed;
+    return TRUE;
+}
+
+// Produce every output whose window is fully buffered, then drop the input
+// no later output can reach
+static size_t run_filter(Resampler* rs, float* const* out, size_t max_out) {
+    DotFunc dot = pick_dot();
+    size_t window = rs->window;
+    size_t frac = rs->frac;
+    size_t produced = 0;
+
+    while (produced < max_out && window + rs->taps <= rs->history_len) {
+        const float* row = rs->bank + (frac * rs->phases / rs->up) * rs->taps;
+        for (uint16_t ch = 0; ch < rs->channels; ch++) {
+            out[ch][produced] = dot(row, rs->history[ch] + window, rs->taps);
+        }
+        produced++;
+
+        frac += rs->down;
+        window += frac / rs->up;
+        frac %= rs->up;
+    }
+
+    size_t keep = rs->history_len - MIN(window, rs->history_len);
+    for (uint16_t ch = 0; ch < rs->channels; ch++) {
+        memmove(rs->history[ch], rs->history[ch] + rs->history_len - keep, keep * sizeof(float));
+    }
+    rs->window = window - (rs->history_len - keep);
+    rs->history_len = keep;
+    rs->frac = frac;
+    return produced;
+}
+
+size_t resampler_process(Resampler* rs, const float* const* in, size_t in_frames,
+                         float* const* out, size_t max_out) {
+    if (!rs || !append_input(rs, in, in_frames)) return 0;
+    return run_filter(rs, out, max_out);
+}
+
+size_t resampler_drain(Resampler* rs, float* const* out, size_t max_out) {
+    if (!rs || !append_input(rs, NULL, rs->taps / 2)) return 0;
+    return run_filter(rs, out, max_out);
+}
+
+ResamplerQuality resampler_default_quality(void) {
+    const char* name = g_getenv("TASTEWARP_SRC_QUALITY");
+    if (!name || !*name) return RESAMPLER_MEDIUM;
+    if (strcasecmp(name, "fast") == 0) return RESAMPLER_FAST;
+    if (strcasecmp(name, "best") == 0) return RESAMPLER_BEST;
+    if (strcasecmp(name, "medium") != 0) {
+        fprintf(stderr, "Unknown TASTEWARP_SRC_QUALITY '%s', using medium\n", name);
+    }
+    return RESAMPLER_MEDIUM;
+}
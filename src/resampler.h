@@ -0,0 +1,37 @@
+#ifndef RESAMPLER_H
+#define RESAMPLER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef enum {
+    RESAMPLER_FAST,     // Short filter, audible roll-off near Nyquist
+    RESAMPLER_MEDIUM,
+    RESAMPLER_BEST      // Long filter for final renders
+} ResamplerQuality;
+
+// Streaming polyphase windowed-sinc sample-rate converter for planar float
+// audio. Feed it blocks of any size; it keeps its own filter history.
+typedef struct Resampler Resampler;
+
+Resampler* resampler_new(uint32_t in_rate, uint32_t out_rate, uint16_t channels,
+                         ResamplerQuality quality);
+void resampler_free(Resampler* rs);
+
+// Forget all buffered input, as if freshly created
+void resampler_reset(Resampler* rs);
+
+// Upper bound on the frames one process() call can produce for in_frames
+size_t resampler_max_output(const Resampler* rs, size_t in_frames);
+
+// Consume all in_frames and write up to max_out frames, returning how many
+size_t resampler_process(Resampler* rs, const float* const* in, size_t in_frames,
+                         float* const* out, size_t max_out);
+
+// Push the filter tail out after the last input block
+size_t resampler_drain(Resampler* rs, float* const* out, size_t max_out);
+
+// Quality from TASTEWARP_SRC_QUALITY (fast, medium or best)
+ResamplerQuality resampler_default_quality(void);
+
+#endif
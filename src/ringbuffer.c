@@ -0,0 +1,112 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include "ringbuffer.h"
+
+#define CACHE_LINE 64
+
+struct RingBuffer {
+    uint8_t* slots;
+    size_t slot_size;      // Size requested by the caller
+    size_t slot_stride;    // slot_size rounded up to a cache line
+    size_t num_slots;      // Always a power of two
+    size_t mask;
+
+    // Keep the indices on separate cache lines so producer and consumer
+    // don't bounce the same line between cores
+    _Alignas(CACHE_LINE) atomic_size_t write_index;
+    _Alignas(CACHE_LINE) atomic_size_t read_index;
+};
+
+RingBuffer* ring_buffer_new(size_t slot_size, size_t num_slots) {
+    if (slot_size == 0 || num_slots == 0) return NULL;
+
+    size_t capacity = 1;
+    while (capacity < num_slots) capacity <<= 1;
+
+    // Round slots up so every slot starts cache-line aligned
+    size_t stride = (slot_size + CACHE_LINE - 1) & ~(size_t)(CACHE_LINE - 1);
+
+    RingBuffer* ring = aligned_alloc(CACHE_LINE, sizeof(RingBuffer));
+    if (!ring) return NULL;
+
+    ring->slots = aligned_alloc(CACHE_LINE, stride * capacity);
+    if (!ring->slots) {
+        free(ring);
+        return NULL;
+    }
+    memset(ring->slots, 0, stride * capacity);
+
+    ring->slot_size = slot_size;
+    ring->slot_stride = stride;
+    ring->num_slots = capacity;
+    ring->mask = capacity - 1;
+    atomic_init(&ring->write_index, 0);
+    atomic_init(&ring->read_index, 0);
+    return ring;
+}
+
+void ring_buffer_free(RingBuffer* ring) {
+    if (!ring) return;
+    free(ring->slots);
+    free(ring);
+}
+
+void* ring_buffer_write_slot(RingBuffer* ring) {
+    size_t write = atomic_load_explicit(&ring->write_index, memory_order_relaxed);
+    size_t read = atomic_load_explicit(&ring->read_index, memory_order_acquire);
+    if (write - read >= ring->num_slots) return NULL;  // Full
+    return ring->slots + (write & ring->mask) * ring->slot_stride;
+}
+
+void ring_buffer_commit_write(RingBuffer* ring) {
+    size_t write = atomic_load_explicit(&ring->write_index, memory_order_relaxed);
+    atomic_store_explicit(&ring->write_index, write + 1, memory_order_release);
+}
+
+const void* ring_buffer_read_slot(RingBuffer* ring) {
+    size_t read = atomic_load_explicit(&ring->read_index, memory_order_relaxed);
+    size_t write = atomic_load_explicit(&ring->write_index, memory_order_acquire);
+    if (read == write) return NULL;  // Empty
+    return ring->slots + (read & ring->mask) * ring->slot_stride;
+}
+
+void ring_buffer_commit_read(RingBuffer* ring) {
+    size_t read = atomic_load_explicit(&ring->read_index, memory_order_relaxed);
+    atomic_store_explicit(&ring->read_index, read + 1, memory_order_release);
+}
+
+gboolean ring_buffer_push(RingBuffer* ring, const void* item) {
+    void* slot = ring_buffer_write_slot(ring);
+    if (!slot) return FALSE;
+    memcpy(slot, item, ring->slot_size);
+    ring_buffer_commit_write(ring);
+    return TRUE;
+}
+
+gboolean ring_buffer_pop(RingBuffer* ring, void* item) {
+    const void* slot = ring_buffer_read_slot(ring);
+    if (!slot) return FALSE;
+    memcpy(item, slot, ring->slot_size);
+    ring_buffer_commit_read(ring);
+    return TRUE;
+}
+
+size_t ring_buffer_count(RingBuffer* ring) {
+    size_t write = atomic_load_explicit(&ring->write_index, memory_order_acquire);
+    size_t read = atomic_load_explicit(&ring->read_index, memory_order_acquire);
+    return write - read;
+}
+
+size_t ring_buffer_capacity(RingBuffer* ring) {
+    return ring->num_slots;
+}
+
+size_t ring_buffer_slot_size(RingBuffer* ring) {
+    return ring->slot_size;
+}
+
+void ring_buffer_reset(RingBuffer* ring) {
+    atomic_store(&ring->write_index, 0);
+    atomic_store(&ring->read_index, 0);
+}
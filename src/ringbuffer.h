@@ -0,0 +1,34 @@
+#ifndef RINGBUFFER_H
+#define RINGBUFFER_H
+
+#include <stddef.h>
+#include <glib.h>
+
+// Single-producer/single-consumer lock-free ring of fixed-size slots.
+// One thread may write and one (other) thread may read concurrently
+// without locks; neither side ever blocks.
+typedef struct RingBuffer RingBuffer;
+
+RingBuffer* ring_buffer_new(size_t slot_size, size_t num_slots);
+void ring_buffer_free(RingBuffer* ring);
+
+// Producer side: get the next free slot (NULL when full), fill it, commit it
+void* ring_buffer_write_slot(RingBuffer* ring);
+void ring_buffer_commit_write(RingBuffer* ring);
+
+// Consumer side: peek the oldest slot (NULL when empty), then release it
+const void* ring_buffer_read_slot(RingBuffer* ring);
+void ring_buffer_commit_read(RingBuffer* ring);
+
+// Copying convenience wrappers around the slot API
+gboolean ring_buffer_push(RingBuffer* ring, const void* item);
+gboolean ring_buffer_pop(RingBuffer* ring, void* item);
+
+size_t ring_buffer_count(RingBuffer* ring);
+size_t ring_buffer_capacity(RingBuffer* ring);
+size_t ring_buffer_slot_size(RingBuffer* ring);
+
+// Only safe while neither side is running
+void ring_buffer_reset(RingBuffer* ring);
+
+#endif
@@ -0,0 +1,261 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "rng.h"
+#include "simd.h"
+
+#define FILL_BATCH 64   // Steps per conversion pass in rng_fill_float()
+
+static uint64_t session_seed;
+static uint64_t seeds_handed_out;
+static gboolean session_started = FALSE;
+G_LOCK_DEFINE_STATIC(seeds);
+
+static GPrivate thread_rng = G_PRIVATE_INIT(g_free);
+
+static uint64_t splitmix64(uint64_t* state) {
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+static inline uint64_t rotl(uint64_t x, int k) {
+    return (x << k) | (x >> (64 - k));
+}
+
+// One step of every lane, scalar
+static void step_scalar(uint64_t s[4][RNG_LANES], uint64_t* out) {
+    for (int lane = 0; lane < RNG_LANES; lane++) {
+        uint64_t s0 = s[0][lane], s1 = s[1][lane], s2 = s[2][lane], s3 = s[3][lane];
+        out[lane] = rotl(s1 * 5, 7) * 9;
+        uint64_t t = s1 << 17;
+        s2 ^= s0;
+        s3 ^= s1;
+        s1 ^= s2;
+        s0 ^= s3;
+        s2 ^= t;
+        s3 = rotl(s3, 45);
+        s[0][lane] = s0;
+        s[1][lane] = s1;
+        s[2][lane] = s2;
+        s[3][lane] = s3;
+    }
+}
+
+#ifdef HAVE_X86_SIMD
+
+// No 64-bit multiply below AVX-512, but by 5 and 9 is a shift and an add
+#define ROTL_SSE(x, k) _mm_or_si128(_mm_slli_epi64(x, k), _mm_srli_epi64(x, 64 - (k)))
+#define TIMES5_SSE(x) _mm_add_epi64(_mm_slli_epi64(x, 2), x)
+#define TIMES9_SSE(x) _mm_add_epi64(_mm_slli_epi64(x, 3), x)
+
+static void steps_sse(uint64_t s[4][RNG_LANES], uint64_t* out, size_t steps) {
+    // Lanes 0-1 and 2-3
+    for (int half = 0; half < RNG_LANES; half += 2) {
+        __m128i s0 = _mm_loadu_si128((const __m128i*)&s[0][half]);
+        __m128i s1 = _mm_loadu_si128((const __m128i*)&s[1][half]);
+        __m128i s2 = _mm_loadu_si128((const __m128i*)&s[2][half]);
+        __m128i s3 = _mm_loadu_si128((const __m128i*)&s[3][half]);
+        for (size_t i = 0; i < steps; i++) {
+            __m128i result = TIMES9_SSE(ROTL_SSE(TIMES5_SSE(s1), 7));
+            _mm_storeu_si128((__m128i*)(out + i * RNG_LANES + half), result);
+            __m128i t = _mm_slli_epi64(s1, 17);
+            s2 = _mm_xor_si128(s2, s0);
+            s3 = _mm_xor_si128(s3, s1);
+            s1 = _mm_xor_si128(s1, s2);
+            s0 = _mm_xor_si128(s0, s3);
+            s2 = _mm_xor_si128(s2, t);
+            s3 = ROTL_SSE(s3, 45);
+        }
+        _mm_storeu_si128((__m128i*)&s[0][half], s0);
+        _mm_storeu_si128((__m128i*)&s[1][half], s1);
+        _mm_storeu_si128((__m128i*)&s[2][half], s2);
+        _mm_storeu_si128((__m128i*)&s[3][half], s3);
+    }
+}
+
+#define ROTL_AVX(x, k) _mm256_or_si256(_mm256_slli_epi64(x, k), _mm256_srli_epi64(x, 64 - (k)))
+#define TIMES5_AVX(x) _mm256_add_epi64(_mm256_slli_epi64(x, 2), x)
+#define TIMES9_AVX(x) _mm256_add_epi64(_mm256_slli_epi64(x, 3), x)
+
+__attribute__((target("avx2")))
+static void steps_avx2(uint64_t s[4][RNG_LANES], uint64_t* out, size_t steps) {
+    __m256i s0 = _mm256_loadu_si256((const __m256i*)s[0]);
+    __m256i s1 = _mm256_loadu_si256((const __m256i*)s[1]);
+    __m256i s2 = _mm256_loadu_si256((const __m256i*)s[2]);
+    __m256i s3 = _mm256_loadu_si256((const __m256i*)s[3]);
+    for (size_t i = 0; i < steps; i++) {
+        __m256i result = TIMES9_AVX(ROTL_AVX(TIMES5_AVX(s1), 7));
+        _mm256_storeu_si256((__m256i*)(out + i * RNG_LANES), result);
+        __m256i t = _mm256_slli_epi64(s1, 17);
+        s2 = _mm256_xor_si256(s2, s0);
+        s3 = _mm256_xor_si256(s3, s1);
+        s1 = _mm256_xor_si256(s1, s2);
+        s0 = _mm256_xor_si256(s0, s3);
+        s2 = _mm256_xor_si256(s2, t);
+        s3 = ROTL_AVX(s3, 45);
+    }
+    _mm256_storeu_si256((__m256i*)s[0], s0);
+    _mm256_storeu_si256((__m256i*)s[1], s1);
+    _mm256_storeu_si256((__m256i*)s[2], s2);
+    _mm256_storeu_si256((__m256i*)s[3], s3);
+}
+
+#else
+
+static void steps_scalar(uint64_t s[4][RNG_LANES], uint64_t* out, size_t steps) {
+    for (size_t i = 0; i < steps; i++) {
+        step_scalar(s, out + i * RNG_LANES);
+    }
+}
+
+#endif
+
+typedef void (*StepsFunc)(uint64_t s[4][RNG_LANES], uint64_t* out, size_t steps);
+
+static StepsFunc pick_steps(void) {
+#ifdef HAVE_X86_SIMD
+    if (simd_have_avx2()) return steps_avx2;
+    return steps_sse;
+#else
+    return steps_scalar;
+#endif
+}
+
+// Advance one lane by 2^128 draws
+static void jump_lane(uint64_t s[4][RNG_LANES], int lane) {
+    static const uint64_t jump[] = {
+        0x180EC6D33CFD0ABAULL, 0xD5A61266F0C9392CULL, 0xA9582618E03FC9AAULL, 0x39ABDC4529B1661CULL
+    };
+    uint64_t s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+    for (int i = 0; i < 4; i++) {
+        for (int b = 0; b < 64; b++) {
+            if (jump[i] & (1ULL << b)) {
+                s0 ^= s[0][lane];
+                s1 ^= s[1][lane];
+                s2 ^= s[2][lane];
+                s3 ^= s[3][lane];
+            }
+            uint64_t t = s[1][lane] << 17;
+            s[2][lane] ^= s[0][lane];
+            s[3][lane] ^= s[1][lane];
+            s[1][lane] ^= s[2][lane];
+            s[0][lane] ^= s[3][lane];
+            s[2][lane] ^= t;
+            s[3][lane] = rotl(s[3][lane], 45);
+        }
+    }
+    s[0][lane] = s0;
+    s[1][lane] = s1;
+    s[2][lane] = s2;
+    s[3][lane] = s3;
+}
+
+void rng_seed(Rng* rng, uint64_t seed) {
+    uint64_t state = seed;
+    for (int w = 0; w < 4; w++) {
+        rng->s[w][0] = splitmix64(&state);
+    }
+    for (int lane = 1; lane < RNG_LANES; lane++) {
+        for (int w = 0; w < 4; w++) {
+            rng->s[w][lane] = rng->s[w][lane - 1];
+        }
+        jump_lane(rng->s, lane);
+    }
+    rng->buffered = 0;
+}
+
+uint64_t rng_next_seed(void) {
+    G_LOCK(seeds);
+    if (!session_started) {
+        const char* value = g_getenv("TASTEWARP_SEED");
+        if (value && *value) {
+            session_seed = g_ascii_strtoull(value, NULL, 0);
+        } else {
+            uint64_t state = (uint64_t)g_get_real_time() ^ ((uint64_t)g_get_monotonic_time() << 32);
+            session_seed = splitmix64(&state);
+            printf("Random seed: %" G_GUINT64_FORMAT " (set TASTEWARP_SEED to replay)\n",
+                   (guint64)session_seed);
+        }
+        session_started = TRUE;
+    }
+    uint64_t state = session_seed + seeds_handed_out++ * 0xD1B54A32D192ED03ULL;
+    uint64_t seed = splitmix64(&state);
+    G_UNLOCK(seeds);
+    return seed;
+}
+
+Rng* rng_thread(void) {
+    Rng* rng = g_private_get(&thread_rng);
+    if (!rng) {
+        rng = g_new(Rng, 1);
+        rng_seed(rng, rng_next_seed());
+        g_private_set(&thread_rng, rng);
+    }
+    return rng;
+}
+
+uint64_t rng_next(Rng* rng) {
+    if (rng->buffered == 0) {
+        step_scalar(rng->s, rng->buffer);
+        rng->buffered = RNG_LANES;
+    }
+    return rng->buffer[RNG_LANES - rng->buffered--];
+}
+
+double rng_double(Rng* rng) {
+    return (rng_next(rng) >> 11) * 0x1.0p-53;
+}
+
+float rng_float(Rng* rng) {
+    return (rng_next(rng) >> 40) * 0x1.0p-24f;
+}
+
+uint32_t rng_below(Rng* rng, uint32_t n) {
+    // Multiply-shift rather than modulo; the bias is at most n / 2^32
+    return (uint32_t)(((rng_next(rng) >> 32) * n) >> 32);
+}
+
+size_t rng_geometric(Rng* rng, double probability) {
+    if (probability >= 1.0) return 0;
+    if (probability <= 0.0) return SIZE_MAX / 2;
+
+    // Inversion: floor(log(u) / log(1 - p)) with u in (0, 1]
+    double u = ((rng_next(rng) >> 11) + 1) * 0x1.0p-53;
+    double skip = floor(log(u) / log1p(-probability));
+    return skip < (double)(SIZE_MAX / 2) ? (size_t)skip : SIZE_MAX / 2;
+}
+
+void rng_fill(Rng* rng, uint64_t* out, size_t count) {
+    while (count > 0 && rng->buffered > 0) {
+        *out++ = rng->buffer[RNG_LANES - rng->buffered--];
+        count--;
+    }
+
+    size_t steps = count / RNG_LANES;
+    if (steps > 0) {
+        pick_steps()(rng->s, out, steps);
+        out += steps * RNG_LANES;
+        count -= steps * RNG_LANES;
+    }
+
+    while (count > 0) {
+        *out++ = rng_next(rng);
+        count--;
+    }
+}
+
+void rng_fill_float(Rng* rng, float* out, size_t count) {
+    uint64_t bits[FILL_BATCH * RNG_LANES];
+    while (count > 0) {
+        size_t n = MIN(count, G_N_ELEMENTS(bits));
+        rng_fill(rng, bits, n);
+        for (size_t i = 0; i < n; i++) {
+            out[i] = (bits[i] >> 40) * 0x1.0p-24f;
+        }
+        out += n;
+        count -= n;
+    }
+}
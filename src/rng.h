@@ -0,0 +1,46 @@
+#ifndef RNG_H
+#define RNG_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <glib.h>
+
+// Seedable xoshiro256** generator. Four streams, 2^128 draws apart, step
+// together so a batch comes out of one SIMD step; single draws are served
+// from the same batches, so a seed gives the same sequence either way and on
+// every machine.
+//
+// Every seed is drawn from the session seed, TASTEWARP_SEED if set, so a
+// session can be replayed by setting it to what the last one printed.
+
+#define RNG_LANES 4
+
+typedef struct {
+    uint64_t s[4][RNG_LANES];       // Word-major, so each word is one vector
+    uint64_t buffer[RNG_LANES];     // Rest of the last batch
+    guint buffered;
+} Rng;
+
+void rng_seed(Rng* rng, uint64_t seed);
+
+// A fresh seed from the session seed; each call gives the next one
+uint64_t rng_next_seed(void);
+
+// The calling thread's generator, seeded from rng_next_seed() on first use
+Rng* rng_thread(void);
+
+uint64_t rng_next(Rng* rng);
+double rng_double(Rng* rng);                // [0, 1)
+float rng_float(Rng* rng);                  // [0, 1)
+uint32_t rng_below(Rng* rng, uint32_t n);   // [0, n)
+
+// Failures before the next success of a trial with the given probability:
+// how far to jump to the next sample a per-sample chance picks. Huge for
+// probability <= 0, 0 for probability >= 1.
+size_t rng_geometric(Rng* rng, double probability);
+
+// Batches, in the same order as repeated single draws
+void rng_fill(Rng* rng, uint64_t* out, size_t count);
+void rng_fill_float(Rng* rng, float* out, size_t count);    // [0, 1)
+
+#endif
@@ -0,0 +1,431 @@
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <math.h>
+#include <glib.h>
+#include "sample_convert.h"
+#include "wavfile.h"
+#include "simd.h"
+
+#define U8_SCALE 128.0f
+#define S16_SCALE 32768.0f
+#define S24_SCALE 8388608.0f
+#define S32_SCALE 2147483648.0f
+
+// Samples converted per pass by the planar helpers
+#define PLANAR_CHUNK 2048
+
+// Largest float below 1.0; full-scale input must not wrap to the negative end
+#define MAX_BELOW_ONE 0.99999994f
+
+SampleFormat sample_format_from_wav(uint16_t wav_format, uint16_t bits_per_sample) {
+    if (wav_format == WAV_FORMAT_IEEE_FLOAT) {
+        return bits_per_sample == 32 ? SAMPLE_F32 : SAMPLE_FORMAT_INVALID;
+    }
+    if (wav_format != WAV_FORMAT_PCM) return SAMPLE_FORMAT_INVALID;
+
+    switch (bits_per_sample) {
+        case 8: return SAMPLE_U8;
+        case 16: return SAMPLE_S16;
+        case 24: return SAMPLE_S24;
+        case 32: return SAMPLE_S32;
+        default: return SAMPLE_FORMAT_INVALID;
+    }
+}
+
+SampleFormat sample_format_parse(const char* name, SampleFormat fallback) {
+    if (!name || !*name) return fallback;
+    for (SampleFormat f = SAMPLE_U8; f <= SAMPLE_F32; f++) {
+        if (strcasecmp(name, sample_format_name(f)) == 0) return f;
+    }
+    fprintf(stderr, "Unknown sample format '%s', using %s\n", name, sample_format_name(fallback));
+    return fallback;
+}
+
+const char* sample_format_name(SampleFormat format) {
+    switch (format) {
+        case SAMPLE_U8: return "u8";
+        case SAMPLE_S16: return "s16";
+        case SAMPLE_S24: return "s24";
+        case SAMPLE_S32: return "s32";
+        case SAMPLE_F32: return "f32";
+        default: return "invalid";
+    }
+}
+
+size_t sample_format_bytes(SampleFormat format) {
+    switch (format) {
+        case SAMPLE_U8: return 1;
+        case SAMPLE_S16: return 2;
+        case SAMPLE_S24: return 3;
+        case SAMPLE_S32: return 4;
+        case SAMPLE_F32: return 4;
+        default: return 0;
+    }
+}
+
+uint16_t sample_format_wav_tag(SampleFormat format) {
+    return format == SAMPLE_F32 ? WAV_FORMAT_IEEE_FLOAT : WAV_FORMAT_PCM;
+}
+
+// NaN goes to -1 here, matching what the SIMD max/min sequence does
+static inline float clamp_unit(float x) {
+    if (!(x > -1.0f)) return -1.0f;
+    return x > MAX_BELOW_ONE ? MAX_BELOW_ONE : x;
+}
+
+static inline int32_t clamp_int(long v, int32_t lo, int32_t hi) {
+    return v < lo ? lo : (v > hi ? hi : (int32_t)v);
+}
+
+// Scalar kernels, also used for the tails the vector loops leave behind
+
+static void decode_u8_scalar(const uint8_t* src, float* dst, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        dst[i] = ((int)src[i] - 128) * (1.0f / U8_SCALE);
+    }
+}
+
+static void decode_s16_scalar(const uint8_t* src, float* dst, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        int16_t v;
+        memcpy(&v, src + i * 2, sizeof(v));
+        dst[i] = v * (1.0f / S16_SCALE);
+    }
+}
+
+static void decode_s24_scalar(const uint8_t* src, float* dst, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        const uint8_t* p = src + i * 3;
+        int32_t v = (int32_t)(((uint32_t)p[0] << 8) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 24)) >> 8;
+        dst[i] = v * (1.0f / S24_SCALE);
+    }
+}
+
+static void decode_s32_scalar(const uint8_t* src, float* dst, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        int32_t v;
+        memcpy(&v, src + i * 4, sizeof(v));
+        dst[i] = (float)v * (1.0f / S32_SCALE);
+    }
+}
+
+static void encode_u8_scalar(const float* src, uint8_t* dst, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        dst[i] = (uint8_t)(clamp_int(lrintf(clamp_unit(src[i]) * U8_SCALE), -128, 127) + 128);
+    }
+}
+
+static void encode_s16_scalar(const float* src, uint8_t* dst, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        int16_t v = (int16_t)clamp_int(lrintf(clamp_unit(src[i]) * S16_SCALE), -32768, 32767);
+        memcpy(dst + i * 2, &v, sizeof(v));
+    }
+}
+
+static void encode_s24_scalar(const float* src, uint8_t* dst, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        int32_t v = clamp_int(lrintf(clamp_unit(src[i]) * S24_SCALE), -8388608, 8388607);
+        dst[i * 3] = (uint8_t)v;
+        dst[i * 3 + 1] = (uint8_t)(v >> 8);
+        dst[i * 3 + 2] = (uint8_t)(v >> 16);
+    }
+}
+
+static void encode_s32_scalar(const float* src, uint8_t* dst, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        // Clamped input tops out at 2147483520, which still fits
+        int32_t v = (int32_t)lrintf(clamp_unit(src[i]) * S32_SCALE);
+        memcpy(dst + i * 4, &v, sizeof(v));
+    }
+}
+
+#ifdef HAVE_X86_SIMD
+
+// SSE2 is part of x86-64, so these need no runtime check. Each kernel
+// returns how many samples it handled; the caller finishes the tail.
+
+static size_t decode_u8_sse2(const uint8_t* src, float* dst, size_t count) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i bias = _mm_set1_epi16(128);
+    const __m128 scale = _mm_set1_ps(1.0f / U8_SCALE);
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(src + i));
+        __m128i lo = _mm_sub_epi16(_mm_unpacklo_epi8(v, zero), bias);
+        __m128i hi = _mm_sub_epi16(_mm_unpackhi_epi8(v, zero), bias);
+        // Sign-extend 16 -> 32 by placing each value in the top half and shifting down
+        _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(lo, lo), 16)), scale));
+        _mm_storeu_ps(dst + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(lo, lo), 16)), scale));
+        _mm_storeu_ps(dst + i + 8, _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(hi, hi), 16)), scale));
+        _mm_storeu_ps(dst + i + 12, _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(hi, hi), 16)), scale));
+    }
+    return i;
+}
+
+static size_t decode_s16_sse2(const uint8_t* src, float* dst, size_t count) {
+    const __m128 scale = _mm_set1_ps(1.0f / S16_SCALE);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(src + i * 2));
+        __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+        __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+        _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtepi32_ps(lo), scale));
+        _mm_storeu_ps(dst + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), scale));
+    }
+    return i;
+}
+
+static size_t decode_s32_sse2(const uint8_t* src, float* dst, size_t count) {
+    const __m128 scale = _mm_set1_ps(1.0f / S32_SCALE);
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(src + i * 4));
+        _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtepi32_ps(v), scale));
+    }
+    return i;
+}
+
+static inline __m128i scale_to_int_sse2(__m128 x, __m128 scale) {
+    x = _mm_min_ps(_mm_max_ps(x, _mm_set1_ps(-1.0f)), _mm_set1_ps(MAX_BELOW_ONE));
+    return _mm_cvtps_epi32(_mm_mul_ps(x, scale));
+}
+
+static size_t encode_u8_sse2(const float* src, uint8_t* dst, size_t count) {
+    const __m128 scale = _mm_set1_ps(U8_SCALE);
+    const __m128i bias = _mm_set1_epi16(128);
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m128i a = scale_to_int_sse2(_mm_loadu_ps(src + i), scale);
+        __m128i b = scale_to_int_sse2(_mm_loadu_ps(src + i + 4), scale);
+        __m128i c = scale_to_int_sse2(_mm_loadu_ps(src + i + 8), scale);
+        __m128i d = scale_to_int_sse2(_mm_loadu_ps(src + i + 12), scale);
+        __m128i lo = _mm_add_epi16(_mm_packs_epi32(a, b), bias);
+        __m128i hi = _mm_add_epi16(_mm_packs_epi32(c, d), bias);
+        _mm_storeu_si128((__m128i*)(dst + i), _mm_packus_epi16(lo, hi));
+    }
+    return i;
+}
+
+static size_t encode_s16_sse2(const float* src, uint8_t* dst, size_t count) {
+    const __m128 scale = _mm_set1_ps(S16_SCALE);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m128i a = scale_to_int_sse2(_mm_loadu_ps(src + i), scale);
+        __m128i b = scale_to_int_sse2(_mm_loadu_ps(src + i + 4), scale);
+        // packs saturates the one value (+32768) that rounding can push out of range
+        _mm_storeu_si128((__m128i*)(dst + i * 2), _mm_packs_epi32(a, b));
+    }
+    return i;
+}
+
+static size_t encode_s32_sse2(const float* src, uint8_t* dst, size_t count) {
+    const __m128 scale = _mm_set1_ps(S32_SCALE);
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        _mm_storeu_si128((__m128i*)(dst + i * 4), scale_to_int_sse2(_mm_loadu_ps(src + i), scale));
+    }
+    return i;
+}
+
+// AVX2 kernels are compiled for AVX2 regardless of the global flags and only
+// called after the CPU check
+
+__attribute__((target("avx2")))
+static size_t decode_s16_avx2(const uint8_t* src, float* dst, size_t count) {
+    const __m256 scale = _mm256_set1_ps(1.0f / S16_SCALE);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i v = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*)(src + i * 2)));
+        _mm256_storeu_ps(dst + i, _mm256_mul_ps(_mm256_cvtepi32_ps(v), scale));
+    }
+    return i;
+}
+
+__attribute__((target("avx2")))
+static size_t decode_s24_avx2(const uint8_t* src, float* dst, size_t count) {
+    const __m256 scale = _mm256_set1_ps(1.0f / S24_SCALE);
+    // Put each 3-byte sample in the top of a 32-bit lane, then shift down to sign-extend
+    const __m256i shuffle = _mm256_setr_epi8(
+        -1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11,
+        -1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11);
+    size_t i = 0;
+    // Each step loads 28 bytes for 8 samples (24 used), so stop 10 samples early
+    for (; i + 10 <= count; i += 8) {
+        const uint8_t* p = src + i * 3;
+        __m128i lo = _mm_loadu_si128((const __m128i*)p);
+        __m128i hi = _mm_loadu_si128((const __m128i*)(p + 12));
+        __m256i v = _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+        v = _mm256_srai_epi32(_mm256_shuffle_epi8(v, shuffle), 8);
+        _mm256_storeu_ps(dst + i, _mm256_mul_ps(_mm256_cvtepi32_ps(v), scale));
+    }
+    return i;
+}
+
+__attribute__((target("avx2")))
+static size_t decode_s32_avx2(const uint8_t* src, float* dst, size_t count) {
+    const __m256 scale = _mm256_set1_ps(1.0f / S32_SCALE);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(src + i * 4));
+        _mm256_storeu_ps(dst + i, _mm256_mul_ps(_mm256_cvtepi32_ps(v), scale));
+    }
+    return i;
+}
+
+__attribute__((target("avx2")))
+static inline __m256i scale_to_int_avx2(__m256 x, __m256 scale) {
+    x = _mm256_min_ps(_mm256_max_ps(x, _mm256_set1_ps(-1.0f)), _mm256_set1_ps(MAX_BELOW_ONE));
+    return _mm256_cvtps_epi32(_mm256_mul_ps(x, scale));
+}
+
+__attribute__((target("avx2")))
+static size_t encode_s16_avx2(const float* src, uint8_t* dst, size_t count) {
+    const __m256 scale = _mm256_set1_ps(S16_SCALE);
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m256i a = scale_to_int_avx2(_mm256_loadu_ps(src + i), scale);
+        __m256i b = scale_to_int_avx2(_mm256_loadu_ps(src + i + 8), scale);
+        // packs works per 128-bit lane; restore sample order afterwards
+        __m256i packed = _mm256_permute4x64_epi64(_mm256_packs_epi32(a, b), _MM_SHUFFLE(3, 1, 2, 0));
+        _mm256_storeu_si256((__m256i*)(dst + i * 2), packed);
+    }
+    return i;
+}
+
+__attribute__((target("avx2")))
+static size_t encode_s32_avx2(const float* src, uint8_t* dst, size_t count) {
+    const __m256 scale = _mm256_set1_ps(S32_SCALE);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        _mm256_storeu_si256((__m256i*)(dst + i * 4), scale_to_int_avx2(_mm256_loadu_ps(src + i), scale));
+    }
+    return i;
+}
+
+#endif
+
+void sample_decode(SampleFormat format, const void* src, float* dst, size_t count) {
+    const uint8_t* in = (const uint8_t*)src;
+    size_t done = 0;
+
+    switch (format) {
+        case SAMPLE_U8:
+#ifdef HAVE_X86_SIMD
+            done = decode_u8_sse2(in, dst, count);
+#endif
+            decode_u8_scalar(in + done, dst + done, count - done);
+            break;
+        case SAMPLE_S16:
+#ifdef HAVE_X86_SIMD
+            done = simd_have_avx2() ? decode_s16_avx2(in, dst, count) : decode_s16_sse2(in, dst, count);
+#endif
+            decode_s16_scalar(in + done * 2, dst + done, count - done);
+            break;
+        case SAMPLE_S24:
+#ifdef HAVE_X86_SIMD
+            if (simd_have_avx2()) done = decode_s24_avx2(in, dst, count);
+#endif
+            decode_s24_scalar(in + done * 3, dst + done, count - done);
+            break;
+        case SAMPLE_S32:
+#ifdef HAVE_X86_SIMD
+            done = simd_have_avx2() ? decode_s32_avx2(in, dst, count) : decode_s32_sse2(in, dst, count);
+#endif
+            decode_s32_scalar(in + done * 4, dst + done, count - done);
+            break;
+        case SAMPLE_F32:
+            memcpy(dst, src, count * sizeof(float));
+            break;
+        default:
+            memset(dst, 0, count * sizeof(float));
+            break;
+    }
+}
+
+void sample_encode(SampleFormat format, const float* src, void* dst, size_t count) {
+    uint8_t* out = (uint8_t*)dst;
+    size_t done = 0;
+
+    switch (format) {
+        case SAMPLE_U8:
+#ifdef HAVE_X86_SIMD
+            done = encode_u8_sse2(src, out, count);
+#endif
+            encode_u8_scalar(src + done, out + done, count - done);
+            break;
+        case SAMPLE_S16:
+#ifdef HAVE_X86_SIMD
+            done = simd_have_avx2() ? encode_s16_avx2(src, out, count) : encode_s16_sse2(src, out, count);
+#endif
+            encode_s16_scalar(src + done, out + done * 2, count - done);
+            break;
+        case SAMPLE_S24:
+            // Three-byte packing doesn't vectorise cleanly; the conversion is the cheap part
+            encode_s24_scalar(src, out, count);
+            break;
+        case SAMPLE_S32:
+#ifdef HAVE_X86_SIMD
+            done = simd_have_avx2() ? encode_s32_avx2(src, out, count) : encode_s32_sse2(src, out, count);
+#endif
+            encode_s32_scalar(src + done, out + done * 4, count - done);
+            break;
+        case SAMPLE_F32:
+            // Float files may legitimately exceed full scale, so pass through
+            memcpy(dst, src, count * sizeof(float));
+            break;
+        default:
+            break;
+    }
+}
+
+void sample_decode_planar(SampleFormat format, const void* src, uint16_t channels,
+                          size_t frames, float* const* dst) {
+    const uint8_t* in = (const uint8_t*)src;
+    size_t frame_bytes = sample_format_bytes(format) * channels;
+    if (channels == 0) return;
+
+    if (channels == 1) {
+        sample_decode(format, src, dst[0], frames);
+        return;
+    }
+
+    // Decode a slab with the vector kernels, then scatter it to the planes
+    float chunk[PLANAR_CHUNK];
+    size_t chunk_frames = PLANAR_CHUNK / channels;
+    for (size_t pos = 0; pos < frames; pos += chunk_frames) {
+        size_t n = MIN(chunk_frames, frames - pos);
+        sample_decode(format, in + pos * frame_bytes, chunk, n * channels);
+        for (uint16_t ch = 0; ch < channels; ch++) {
+            float* plane = dst[ch] + pos;
+            for (size_t i = 0; i < n; i++) {
+                plane[i] = chunk[i * channels + ch];
+            }
+        }
+    }
+}
+
+void sample_encode_planar(SampleFormat format, const float* const* src, uint16_t channels,
+                          size_t frames, void* dst) {
+    uint8_t* out = (uint8_t*)dst;
+    size_t frame_bytes = sample_format_bytes(format) * channels;
+    if (channels == 0) return;
+
+    if (channels == 1) {
+        sample_encode(format, src[0], dst, frames);
+        return;
+    }
+
+    float chunk[PLANAR_CHUNK];
+    size_t chunk_frames = PLANAR_CHUNK / channels;
+    for (size_t pos = 0; pos < frames; pos += chunk_frames) {
+        size_t n = MIN(chunk_frames, frames - pos);
+        for (uint16_t ch = 0; ch < channels; ch++) {
+            const float* plane = src[ch] + pos;
+            for (size_t i = 0; i < n; i++) {
+                chunk[i * channels + ch] = plane[i];
+            }
+        }
+        sample_encode(format, chunk, out + pos * frame_bytes, n * channels);
+    }
+}
@@ -0,0 +1,34 @@
+#ifndef SAMPLE_CONVERT_H
+#define SAMPLE_CONVERT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// On-disk sample formats. Float samples are nominally in [-1, 1).
+typedef enum {
+    SAMPLE_FORMAT_INVALID = 0,
+    SAMPLE_U8,      // Unsigned 8-bit, 128 = silence
+    SAMPLE_S16,
+    SAMPLE_S24,     // Packed 3-byte little-endian
+    SAMPLE_S32,
+    SAMPLE_F32
+} SampleFormat;
+
+SampleFormat sample_format_from_wav(uint16_t wav_format, uint16_t bits_per_sample);
+SampleFormat sample_format_parse(const char* name, SampleFormat fallback);
+const char* sample_format_name(SampleFormat format);
+size_t sample_format_bytes(SampleFormat format);
+uint16_t sample_format_wav_tag(SampleFormat format);
+
+// Convert count samples (not frames). Encoding clamps to the format's range.
+// SSE2/AVX2 kernels are picked at runtime where the CPU has them.
+void sample_decode(SampleFormat format, const void* src, float* dst, size_t count);
+void sample_encode(SampleFormat format, const float* src, void* dst, size_t count);
+
+// Interleaved file/device layout <-> one float plane per channel
+void sample_decode_planar(SampleFormat format, const void* src, uint16_t channels,
+                          size_t frames, float* const* dst);
+void sample_encode_planar(SampleFormat format, const float* const* src, uint16_t channels,
+                          size_t frames, void* dst);
+
+#endif
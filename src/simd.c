@@ -0,0 +1,35 @@
+#include "simd.h"
+
+#ifdef HAVE_X86_SIMD
+
+// -1 = not probed yet
+static gint have_avx2 = -1;
+static gint have_fma = -1;
+
+static void probe_cpu(void) {
+    __builtin_cpu_init();
+    g_atomic_int_set(&have_fma, __builtin_cpu_supports("fma") ? 1 : 0);
+    g_atomic_int_set(&have_avx2, __builtin_cpu_supports("avx2") ? 1 : 0);
+}
+
+gboolean simd_have_avx2(void) {
+    if (g_atomic_int_get(&have_avx2) < 0) probe_cpu();
+    return g_atomic_int_get(&have_avx2);
+}
+
+gboolean simd_have_fma(void) {
+    if (g_atomic_int_get(&have_fma) < 0) probe_cpu();
+    return g_atomic_int_get(&have_fma);
+}
+
+#else
+
+gboolean simd_have_avx2(void) {
+    return FALSE;
+}
+
+gboolean simd_have_fma(void) {
+    return FALSE;
+}
+
+#endif
@@ -0,0 +1,16 @@
+#ifndef SIMD_H
+#define SIMD_H
+
+#include <glib.h>
+
+// x86 builds always have SSE2; wider kernels are compiled with target
+// attributes and chosen at runtime with these checks
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__SSE2__)
+#define HAVE_X86_SIMD 1
+#include <immintrin.h>
+#endif
+
+gboolean simd_have_avx2(void);
+gboolean simd_have_fma(void);
+
+#endif
@@ -0,0 +1,381 @@
+#include <math.h>
+#include "spectral.h"
+#include "simd.h"
+
+// atan on |t| <= tan(pi/8) by its Taylor series through t^17; the first
+// dropped term bounds the error at 0.4143^19 / 19 < 3e-9
+#define ATAN_C3  (-1.0 / 3.0)
+#define ATAN_C5  (1.0 / 5.0)
+#define ATAN_C7  (-1.0 / 7.0)
+#define ATAN_C9  (1.0 / 9.0)
+#define ATAN_C11 (-1.0 / 11.0)
+#define ATAN_C13 (1.0 / 13.0)
+#define ATAN_C15 (-1.0 / 15.0)
+#define ATAN_C17 (1.0 / 17.0)
+#define TAN_PI_8 0.41421356237309503
+
+// sin and cos on |r| <= pi/4 through r^11 and r^12 (errors < 1e-11 and
+// < 1e-12), after reducing by pi/2 in two parts so the reduction stays exact
+// for the arguments a vocoder produces
+#define SIN_C3  (-1.0 / 6.0)
+#define SIN_C5  (1.0 / 120.0)
+#define SIN_C7  (-1.0 / 5040.0)
+#define SIN_C9  (1.0 / 362880.0)
+#define SIN_C11 (-1.0 / 39916800.0)
+#define COS_C2  (-1.0 / 2.0)
+#define COS_C4  (1.0 / 24.0)
+#define COS_C6  (-1.0 / 720.0)
+#define COS_C8  (1.0 / 40320.0)
+#define COS_C10 (-1.0 / 3628800.0)
+#define COS_C12 (1.0 / 479001600.0)
+#define PIO2_HI 1.5707963267341256      // pi/2 with the low 33 bits cleared
+#define PIO2_LO 6.077100506506192e-11   // pi/2 - PIO2_HI
+#define TWO_OVER_PI 0.6366197723675814
+
+static inline double atan2_scalar(double y, double x) {
+    double ax = fabs(x);
+    double ay = fabs(y);
+    double hi = ax > ay ? ax : ay;
+    double lo = ax > ay ? ay : ax;
+    double a = hi > 0.0 ? lo / hi : 0.0;
+
+    gboolean big = a > TAN_PI_8;
+    double t = big ? (a - 1.0) / (a + 1.0) : a;
+    double s = t * t;
+    double p = ATAN_C17;
+    p = p * s + ATAN_C15;
+    p = p * s + ATAN_C13;
+    p = p * s + ATAN_C11;
+    p = p * s + ATAN_C9;
+    p = p * s + ATAN_C7;
+    p = p * s + ATAN_C5;
+    p = p * s + ATAN_C3;
+    double r = t + t * s * p;
+    if (big) r += M_PI_4;
+
+    if (ay > ax) r = M_PI_2 - r;
+    if (x < 0.0) r = M_PI - r;
+    return copysign(r, y);
+}
+
+static inline void sincos_scalar(double theta, double* sine, double* cosine) {
+    double k = nearbyint(theta * TWO_OVER_PI);
+    double r = (theta - k * PIO2_HI) - k * PIO2_LO;
+    double z = r * r;
+
+    double sp = SIN_C11;
+    sp = sp * z + SIN_C9;
+    sp = sp * z + SIN_C7;
+    sp = sp * z + SIN_C5;
+    sp = sp * z + SIN_C3;
+    double s = r + r * z * sp;
+
+    double cp = COS_C12;
+    cp = cp * z + COS_C10;
+    cp = cp * z + COS_C8;
+    cp = cp * z + COS_C6;
+    cp = cp * z + COS_C4;
+    cp = cp * z + COS_C2;
+    double c = 1.0 + z * cp;
+
+    // Quadrant: swap on odd, sin negative in 2 and 3, cos in 1 and 2
+    long q = (long)k & 3;
+    double qs = (q & 1) ? c : s;
+    double qc = (q & 1) ? s : c;
+    *sine = (q & 2) ? -qs : qs;
+    *cosine = ((q + 1) & 2) ? -qc : qc;
+}
+
+static inline double wrap_scalar(double d) {
+    double y = d + M_PI;
+    return y - 2.0 * M_PI * trunc(y / (2.0 * M_PI)) - M_PI;
+}
+
+#ifdef HAVE_X86_SIMD
+
+// ---- SSE2, two bins at a time ----
+
+static inline __m128d blend_sse2(__m128d a, __m128d b, __m128d mask) {
+    return _mm_or_pd(_mm_andnot_pd(mask, a), _mm_and_pd(mask, b));
+}
+
+static inline __m128d atan2_sse2(__m128d y, __m128d x) {
+    const __m128d sign = _mm_set1_pd(-0.0);
+    const __m128d one = _mm_set1_pd(1.0);
+    __m128d ax = _mm_andnot_pd(sign, x);
+    __m128d ay = _mm_andnot_pd(sign, y);
+    __m128d hi = _mm_max_pd(ax, ay);
+    __m128d lo = _mm_min_pd(ax, ay);
+    __m128d nonzero = _mm_cmpgt_pd(hi, _mm_setzero_pd());
+    __m128d a = _mm_and_pd(nonzero, _mm_div_pd(lo, blend_sse2(one, hi, nonzero)));
+
+    __m128d big = _mm_cmpgt_pd(a, _mm_set1_pd(TAN_PI_8));
+    __m128d t = blend_sse2(a, _mm_div_pd(_mm_sub_pd(a, one), _mm_add_pd(a, one)), big);
+    __m128d s = _mm_mul_pd(t, t);
+    __m128d p = _mm_set1_pd(ATAN_C17);
+    p = _mm_add_pd(_mm_mul_pd(p, s), _mm_set1_pd(ATAN_C15));
+    p = _mm_add_pd(_mm_mul_pd(p, s), _mm_set1_pd(ATAN_C13));
+    p = _mm_add_pd(_mm_mul_pd(p, s), _mm_set1_pd(ATAN_C11));
+    p = _mm_add_pd(_mm_mul_pd(p, s), _mm_set1_pd(ATAN_C9));
+    p = _mm_add_pd(_mm_mul_pd(p, s), _mm_set1_pd(ATAN_C7));
+    p = _mm_add_pd(_mm_mul_pd(p, s), _mm_set1_pd(ATAN_C5));
+    p = _mm_add_pd(_mm_mul_pd(p, s), _mm_set1_pd(ATAN_C3));
+    __m128d r = _mm_add_pd(t, _mm_mul_pd(_mm_mul_pd(t, s), p));
+    r = _mm_add_pd(r, _mm_and_pd(big, _mm_set1_pd(M_PI_4)));
+
+    r = blend_sse2(r, _mm_sub_pd(_mm_set1_pd(M_PI_2), r), _mm_cmpgt_pd(ay, ax));
+    r = blend_sse2(r, _mm_sub_pd(_mm_set1_pd(M_PI), r), _mm_cmplt_pd(x, _mm_setzero_pd()));
+    return _mm_or_pd(r, _mm_and_pd(sign, y));
+}
+
+static inline void sincos_sse2(__m128d theta, __m128d* sine, __m128d* cosine) {
+    const __m128d sign = _mm_set1_pd(-0.0);
+    // Rounds to nearest under the default MXCSR, like nearbyint()
+    __m128i ki = _mm_cvtpd_epi32(_mm_mul_pd(theta, _mm_set1_pd(TWO_OVER_PI)));
+    __m128d k = _mm_cvtepi32_pd(ki);
+    __m128d r = _mm_sub_pd(_mm_sub_pd(theta, _mm_mul_pd(k, _mm_set1_pd(PIO2_HI))),
+                           _mm_mul_pd(k, _mm_set1_pd(PIO2_LO)));
+    __m128d z = _mm_mul_pd(r, r);
+
+    __m128d sp = _mm_set1_pd(SIN_C11);
+    sp = _mm_add_pd(_mm_mul_pd(sp, z), _mm_set1_pd(SIN_C9));
+    sp = _mm_add_pd(_mm_mul_pd(sp, z), _mm_set1_pd(SIN_C7));
+    sp = _mm_add_pd(_mm_mul_pd(sp, z), _mm_set1_pd(SIN_C5));
+    sp = _mm_add_pd(_mm_mul_pd(sp, z), _mm_set1_pd(SIN_C3));
+    __m128d s = _mm_add_pd(r, _mm_mul_pd(_mm_mul_pd(r, z), sp));
+
+    __m128d cp = _mm_set1_pd(COS_C12);
+    cp = _mm_add_pd(_mm_mul_pd(cp, z), _mm_set1_pd(COS_C10));
+    cp = _mm_add_pd(_mm_mul_pd(cp, z), _mm_set1_pd(COS_C8));
+    cp = _mm_add_pd(_mm_mul_pd(cp, z), _mm_set1_pd(COS_C6));
+    cp = _mm_add_pd(_mm_mul_pd(cp, z), _mm_set1_pd(COS_C4));
+    cp = _mm_add_pd(_mm_mul_pd(cp, z), _mm_set1_pd(COS_C2));
+    __m128d c = _mm_add_pd(_mm_set1_pd(1.0), _mm_mul_pd(z, cp));
+
+    // Spread each 32-bit quadrant over its 64-bit lane to get whole-lane masks
+    __m128i q = _mm_shuffle_epi32(ki, _MM_SHUFFLE(1, 1, 0, 0));
+    __m128d odd = _mm_castsi128_pd(_mm_cmpeq_epi32(_mm_and_si128(q, _mm_set1_epi32(1)), _mm_set1_epi32(1)));
+    __m128d sin_neg = _mm_castsi128_pd(_mm_cmpeq_epi32(_mm_and_si128(q, _mm_set1_epi32(2)), _mm_set1_epi32(2)));
+    __m128i q1 = _mm_add_epi32(q, _mm_set1_epi32(1));
+    __m128d cos_neg = _mm_castsi128_pd(_mm_cmpeq_epi32(_mm_and_si128(q1, _mm_set1_epi32(2)), _mm_set1_epi32(2)));
+
+    __m128d qs = blend_sse2(s, c, odd);
+    __m128d qc = blend_sse2(c, s, odd);
+    *sine = _mm_xor_pd(qs, _mm_and_pd(sin_neg, sign));
+    *cosine = _mm_xor_pd(qc, _mm_and_pd(cos_neg, sign));
+}
+
+static inline __m128d wrap_sse2(__m128d d) {
+    const __m128d two_pi = _mm_set1_pd(2.0 * M_PI);
+    __m128d y = _mm_add_pd(d, _mm_set1_pd(M_PI));
+    __m128d k = _mm_cvtepi32_pd(_mm_cvttpd_epi32(_mm_div_pd(y, two_pi)));
+    return _mm_sub_pd(_mm_sub_pd(y, _mm_mul_pd(two_pi, k)), _mm_set1_pd(M_PI));
+}
+
+static size_t to_polar_sse2(const double (*bins)[2], double* magnitude, double* phase, size_t count) {
+    size_t i = 0;
+    for (; i + 2 <= count; i += 2) {
+        __m128d a = _mm_loadu_pd(bins[i]);
+        __m128d b = _mm_loadu_pd(bins[i + 1]);
+        __m128d re = _mm_unpacklo_pd(a, b);
+        __m128d im = _mm_unpackhi_pd(a, b);
+        _mm_storeu_pd(magnitude + i, _mm_sqrt_pd(_mm_add_pd(_mm_mul_pd(re, re), _mm_mul_pd(im, im))));
+        _mm_storeu_pd(phase + i, atan2_sse2(im, re));
+    }
+    return i;
+}
+
+static size_t from_polar_sse2(const double* magnitude, const double* phase, double (*bins)[2], size_t count) {
+    size_t i = 0;
+    for (; i + 2 <= count; i += 2) {
+        __m128d s, c;
+        sincos_sse2(_mm_loadu_pd(phase + i), &s, &c);
+        __m128d m = _mm_loadu_pd(magnitude + i);
+        __m128d re = _mm_mul_pd(m, c);
+        __m128d im = _mm_mul_pd(m, s);
+        _mm_storeu_pd(bins[i], _mm_unpacklo_pd(re, im));
+        _mm_storeu_pd(bins[i + 1], _mm_unpackhi_pd(re, im));
+    }
+    return i;
+}
+
+static size_t phase_advance_sse2(const double* phase, double* previous, const double* expected,
+                                 double* advance, size_t count) {
+    size_t i = 0;
+    for (; i + 2 <= count; i += 2) {
+        __m128d now = _mm_loadu_pd(phase + i);
+        __m128d e = _mm_loadu_pd(expected + i);
+        __m128d d = _mm_sub_pd(_mm_sub_pd(now, _mm_loadu_pd(previous + i)), e);
+        _mm_storeu_pd(previous + i, now);
+        _mm_storeu_pd(advance + i, _mm_add_pd(e, wrap_sse2(d)));
+    }
+    return i;
+}
+
+// ---- AVX2 + FMA, four bins at a time; only called after the CPU check ----
+
+__attribute__((target("avx2,fma")))
+static inline __m256d atan2_avx2(__m256d y, __m256d x) {
+    const __m256d sign = _mm256_set1_pd(-0.0);
+    const __m256d one = _mm256_set1_pd(1.0);
+    __m256d ax = _mm256_andnot_pd(sign, x);
+    __m256d ay = _mm256_andnot_pd(sign, y);
+    __m256d hi = _mm256_max_pd(ax, ay);
+    __m256d lo = _mm256_min_pd(ax, ay);
+    __m256d nonzero = _mm256_cmp_pd(hi, _mm256_setzero_pd(), _CMP_GT_OQ);
+    __m256d a = _mm256_and_pd(nonzero, _mm256_div_pd(lo, _mm256_blendv_pd(one, hi, nonzero)));
+
+    __m256d big = _mm256_cmp_pd(a, _mm256_set1_pd(TAN_PI_8), _CMP_GT_OQ);
+    __m256d t = _mm256_blendv_pd(a, _mm256_div_pd(_mm256_sub_pd(a, one), _mm256_add_pd(a, one)), big);
+    __m256d s = _mm256_mul_pd(t, t);
+    __m256d p = _mm256_set1_pd(ATAN_C17);
+    p = _mm256_fmadd_pd(p, s, _mm256_set1_pd(ATAN_C15));
+    p = _mm256_fmadd_pd(p, s, _mm256_set1_pd(ATAN_C13));
+    p = _mm256_fmadd_pd(p, s, _mm256_set1_pd(ATAN_C11));
+    p = _mm256_fmadd_pd(p, s, _mm256_set1_pd(ATAN_C9));
+    p = _mm256_fmadd_pd(p, s, _mm256_set1_pd(ATAN_C7));
+    p = _mm256_fmadd_pd(p, s, _mm256_set1_pd(ATAN_C5));
+    p = _mm256_fmadd_pd(p, s, _mm256_set1_pd(ATAN_C3));
+    __m256d r = _mm256_fmadd_pd(_mm256_mul_pd(t, s), p, t);
+    r = _mm256_add_pd(r, _mm256_and_pd(big, _mm256_set1_pd(M_PI_4)));
+
+    r = _mm256_blendv_pd(r, _mm256_sub_pd(_mm256_set1_pd(M_PI_2), r), _mm256_cmp_pd(ay, ax, _CMP_GT_OQ));
+    r = _mm256_blendv_pd(r, _mm256_sub_pd(_mm256_set1_pd(M_PI), r),
+                         _mm256_cmp_pd(x, _mm256_setzero_pd(), _CMP_LT_OQ));
+    return _mm256_or_pd(r, _mm256_and_pd(sign, y));
+}
+
+__attribute__((target("avx2,fma")))
+static inline void sincos_avx2(__m256d theta, __m256d* sine, __m256d* cosine) {
+    const __m256d sign = _mm256_set1_pd(-0.0);
+    __m256d k = _mm256_round_pd(_mm256_mul_pd(theta, _mm256_set1_pd(TWO_OVER_PI)),
+                                _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    __m256d r = _mm256_fnmadd_pd(k, _mm256_set1_pd(PIO2_LO), _mm256_fnmadd_pd(k, _mm256_set1_pd(PIO2_HI), theta));
+    __m256d z = _mm256_mul_pd(r, r);
+
+    __m256d sp = _mm256_set1_pd(SIN_C11);
+    sp = _mm256_fmadd_pd(sp, z, _mm256_set1_pd(SIN_C9));
+    sp = _mm256_fmadd_pd(sp, z, _mm256_set1_pd(SIN_C7));
+    sp = _mm256_fmadd_pd(sp, z, _mm256_set1_pd(SIN_C5));
+    sp = _mm256_fmadd_pd(sp, z, _mm256_set1_pd(SIN_C3));
+    __m256d s = _mm256_fmadd_pd(_mm256_mul_pd(r, z), sp, r);
+
+    __m256d cp = _mm256_set1_pd(COS_C12);
+    cp = _mm256_fmadd_pd(cp, z, _mm256_set1_pd(COS_C10));
+    cp = _mm256_fmadd_pd(cp, z, _mm256_set1_pd(COS_C8));
+    cp = _mm256_fmadd_pd(cp, z, _mm256_set1_pd(COS_C6));
+    cp = _mm256_fmadd_pd(cp, z, _mm256_set1_pd(COS_C4));
+    cp = _mm256_fmadd_pd(cp, z, _mm256_set1_pd(COS_C2));
+    __m256d c = _mm256_fmadd_pd(z, cp, _mm256_set1_pd(1.0));
+
+    __m256i q = _mm256_cvtepi32_epi64(_mm256_cvtpd_epi32(k));
+    __m256d odd = _mm256_castsi256_pd(_mm256_cmpeq_epi64(_mm256_and_si256(q, _mm256_set1_epi64x(1)),
+                                                         _mm256_set1_epi64x(1)));
+    __m256d sin_neg = _mm256_castsi256_pd(_mm256_cmpeq_epi64(_mm256_and_si256(q, _mm256_set1_epi64x(2)),
+                                                             _mm256_set1_epi64x(2)));
+    __m256i q1 = _mm256_add_epi64(q, _mm256_set1_epi64x(1));
+    __m256d cos_neg = _mm256_castsi256_pd(_mm256_cmpeq_epi64(_mm256_and_si256(q1, _mm256_set1_epi64x(2)),
+                                                             _mm256_set1_epi64x(2)));
+
+    __m256d qs = _mm256_blendv_pd(s, c, odd);
+    __m256d qc = _mm256_blendv_pd(c, s, odd);
+    *sine = _mm256_xor_pd(qs, _mm256_and_pd(sin_neg, sign));
+    *cosine = _mm256_xor_pd(qc, _mm256_and_pd(cos_neg, sign));
+}
+
+__attribute__((target("avx2,fma")))
+static inline __m256d wrap_avx2(__m256d d) {
+    const __m256d two_pi = _mm256_set1_pd(2.0 * M_PI);
+    __m256d y = _mm256_add_pd(d, _mm256_set1_pd(M_PI));
+    __m256d k = _mm256_round_pd(_mm256_div_pd(y, two_pi), _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC);
+    return _mm256_sub_pd(_mm256_fnmadd_pd(two_pi, k, y), _mm256_set1_pd(M_PI));
+}
+
+__attribute__((target("avx2,fma")))
+static size_t to_polar_avx2(const double (*bins)[2], double* magnitude, double* phase, size_t count) {
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m256d a = _mm256_loadu_pd(bins[i]);       // r0 i0 r1 i1
+        __m256d b = _mm256_loadu_pd(bins[i + 2]);   // r2 i2 r3 i3
+        // unpack works per 128-bit lane; restore bin order afterwards
+        __m256d re = _mm256_permute4x64_pd(_mm256_unpacklo_pd(a, b), _MM_SHUFFLE(3, 1, 2, 0));
+        __m256d im = _mm256_permute4x64_pd(_mm256_unpackhi_pd(a, b), _MM_SHUFFLE(3, 1, 2, 0));
+        _mm256_storeu_pd(magnitude + i, _mm256_sqrt_pd(_mm256_fmadd_pd(re, re, _mm256_mul_pd(im, im))));
+        _mm256_storeu_pd(phase + i, atan2_avx2(im, re));
+    }
+    return i;
+}
+
+__attribute__((target("avx2,fma")))
+static size_t from_polar_avx2(const double* magnitude, const double* phase, double (*bins)[2], size_t count) {
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m256d s, c;
+        sincos_avx2(_mm256_loadu_pd(phase + i), &s, &c);
+        __m256d m = _mm256_loadu_pd(magnitude + i);
+        __m256d re = _mm256_permute4x64_pd(_mm256_mul_pd(m, c), _MM_SHUFFLE(3, 1, 2, 0));
+        __m256d im = _mm256_permute4x64_pd(_mm256_mul_pd(m, s), _MM_SHUFFLE(3, 1, 2, 0));
+        _mm256_storeu_pd(bins[i], _mm256_unpacklo_pd(re, im));
+        _mm256_storeu_pd(bins[i + 2], _mm256_unpackhi_pd(re, im));
+    }
+    return i;
+}
+
+__attribute__((target("avx2,fma")))
+static size_t phase_advance_avx2(const double* phase, double* previous, const double* expected,
+                                 double* advance, size_t count) {
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m256d now = _mm256_loadu_pd(phase + i);
+        __m256d e = _mm256_loadu_pd(expected + i);
+        __m256d d = _mm256_sub_pd(_mm256_sub_pd(now, _mm256_loadu_pd(previous + i)), e);
+        _mm256_storeu_pd(previous + i, now);
+        _mm256_storeu_pd(advance + i, _mm256_add_pd(e, wrap_avx2(d)));
+    }
+    return i;
+}
+
+#endif
+
+void spectral_to_polar(const double (*bins)[2], double* magnitude, double* phase, size_t count) {
+    size_t i = 0;
+#ifdef HAVE_X86_SIMD
+    i = simd_have_avx2() && simd_have_fma() ? to_polar_avx2(bins, magnitude, phase, count)
+                                            : to_polar_sse2(bins, magnitude, phase, count);
+#endif
+    for (; i < count; i++) {
+        double re = bins[i][0];
+        double im = bins[i][1];
+        magnitude[i] = sqrt(re * re + im * im);
+        phase[i] = atan2_scalar(im, re);
+    }
+}
+
+void spectral_from_polar(const double* magnitude, const double* phase, double (*bins)[2], size_t count) {
+    size_t i = 0;
+#ifdef HAVE_X86_SIMD
+    i = simd_have_avx2() && simd_have_fma() ? from_polar_avx2(magnitude, phase, bins, count)
+                                            : from_polar_sse2(magnitude, phase, bins, count);
+#endif
+    for (; i < count; i++) {
+        double s, c;
+        sincos_scalar(phase[i], &s, &c);
+        bins[i][0] = magnitude[i] * c;
+        bins[i][1] = magnitude[i] * s;
+    }
+}
+
+void spectral_phase_advance(const double* phase, double* previous, const double* expected,
+                            double* advance, size_t count) {
+    size_t i = 0;
+#ifdef HAVE_X86_SIMD
+    i = simd_have_avx2() && simd_have_fma() ? phase_advance_avx2(phase, previous, expected, advance, count)
+                                            : phase_advance_sse2(phase, previous, expected, advance, count);
+#endif
+    for (; i < count; i++) {
+        double now = phase[i];
+        double d = now - previous[i] - expected[i];
+        previous[i] = now;
+        advance[i] = expected[i] + wrap_scalar(d);
+    }
+}
@@ -0,0 +1,27 @@
+#ifndef SPECTRAL_H
+#define SPECTRAL_H
+
+#include <stddef.h>
+
+// Vector kernels for frequency-domain effects. Spectra use FFTW's layout,
+// interleaved (re, im) doubles, so an fftw_complex* can be passed as is.
+//
+// The transcendentals are polynomials rather than libm calls: phases are
+// within 3e-9 rad of atan2() and sines/cosines within 1e-11 of sin()/cos()
+// for arguments up to a few thousand radians. SSE2 and AVX2+FMA versions are
+// picked at runtime; the scalar fallback keeps the same bounds.
+
+// Magnitude and phase (-pi..pi] of each bin
+void spectral_to_polar(const double (*bins)[2], double* magnitude, double* phase, size_t count);
+
+// Back to rectangular form. Any phase is fine, it doesn't need wrapping.
+void spectral_from_polar(const double* magnitude, const double* phase, double (*bins)[2], size_t count);
+
+// Phase vocoder frequency estimate: how far each bin's phase moved since the
+// previous frame, as expected + wrap(phase - previous - expected), wrapped
+// the way pitch_shift() always has with fmod(d + pi, 2 pi) - pi. previous
+// is then set to phase. advance may alias phase.
+void spectral_phase_advance(const double* phase, double* previous, const double* expected,
+                            double* advance, size_t count);
+
+#endif
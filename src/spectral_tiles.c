@@ -0,0 +1,264 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <fftw3.h>
+#include "spectral_tiles.h"
+#include "audio.h"
+#include "fft_plans.h"
+#include "thread_pool.h"
+
+#define TILE_WINDOWS 4              // Most FFTs a coarse column takes the loudest of
+#define TILE_GRAIN 16               // Columns per piece of a tile on the pool
+#define TILE_BYTES (SPECTRAL_TILE_COLUMNS * SPECTRUM_BINS)
+
+typedef enum {
+    TILE_QUEUED,
+    TILE_BUSY,                      // Being made; the worker owns the pixels
+    TILE_READY
+} TileState;
+
+typedef struct {
+    gint64 key;                     // See tile_key()
+    int level;
+    size_t index;
+    TileState state;
+    guint64 frame;                  // Last frame it was asked for
+    GList lru_link;                 // In SpectralTiles.lru
+    GList pending_link;             // In SpectralTiles.pending while queued
+    guint8 levels[TILE_BYTES];
+} Tile;
+
+struct SpectralTiles {
+    AudioData* audio;               // Snapshot sharing the chunks of the mix it came from
+    fftw_plan plan;
+    const double* window;
+    GThread* worker;
+    gint cancel;                    // Atomic: set when freeing, to give up on the tile being made
+
+    // Everything below is under lock
+    GMutex lock;
+    GCond wake;                     // Worker: a tile is queued, or quit
+    GHashTable* tiles;              // &Tile.key -> Tile
+    GQueue lru;                     // Every tile, most recently asked for first
+    GQueue pending;                 // Queued tiles, most wanted first
+    guint64 frame;
+    gboolean quit;
+};
+
+static gint64 tile_key(int level, size_t index) {
+    return (gint64)level << 48 | (gint64)index;
+}
+
+size_t spectral_tiles_hop(int level) {
+    return (size_t)SPECTRAL_TILES_HOP << CLAMP(level, 0, SPECTRAL_TILES_LEVELS - 1);
+}
+
+// Windowed first channel around `centre`, silence outside the track
+static void read_window(SpectralTiles* tiles, size_t centre, double* input) {
+    const AudioData* audio = tiles->audio;
+    for (int i = 0; i < SPECTRUM_FFT_SIZE; i++) {
+        size_t frame = centre + i - SPECTRUM_FFT_SIZE / 2;
+        float sample = 0.0f;
+        if (centre + i >= SPECTRUM_FFT_SIZE / 2 && frame < audio->frames) {
+            sample = audio_data_chunk(audio, 0, frame / AUDIO_CHUNK_FRAMES)[frame % AUDIO_CHUNK_FRAMES];
+        }
+        input[i] = sample * tiles->window[i];
+    }
+}
+
+typedef struct {
+    SpectralTiles* tiles;
+    Tile* tile;
+} TileJob;
+
+// Columns [begin, end) of a tile whose levels start out zeroed
+static void make_columns(gpointer data, size_t begin, size_t end) {
+    TileJob* job = data;
+    SpectralTiles* tiles = job->tiles;
+    Tile* tile = job->tile;
+    size_t hop = spectral_tiles_hop(tile->level);
+    size_t windows = MIN(hop / SPECTRAL_TILES_HOP, TILE_WINDOWS);
+
+    double* input = fftw_alloc_real(SPECTRUM_FFT_SIZE);
+    fftw_complex* output = fftw_alloc_complex(SPECTRUM_FFT_SIZE / 2 + 1);
+    if (!input || !output) {
+        // Shown as silence rather than asked for forever
+        fprintf(stderr, "spectral tiles: out of memory\n");
+        end = begin;
+    }
+
+    for (size_t c = begin; c < end; c++) {
+        // Checked per column so freeing never waits for a whole tile
+        if (g_atomic_int_get(&tiles->cancel)) break;
+        size_t start = (tile->index * SPECTRAL_TILE_COLUMNS + c) * hop;
+        if (start >= tiles->audio->frames) break;
+
+        guint8* column = tile->levels + c * SPECTRUM_BINS;
+        for (size_t w = 0; w < windows; w++) {
+            // Spread evenly over the column's span
+            read_window(tiles, start + hop * (2 * w + 1) / (2 * windows), input);
+            fftw_execute_dft_r2c(tiles->plan, input, output);
+
+            // Same scale and colour mapping as the live spectrogram
+            for (int y = 0; y < SPECTRUM_BINS; y++) {
+                double magnitude = sqrt(output[y][0] * output[y][0] + output[y][1] * output[y][1]) *
+                                   2.0 / SPECTRUM_FFT_SIZE;
+                guint8 level = (guint8)fmin(magnitude * 5.0 * 255.0 + 0.5, 255.0);
+                column[y] = MAX(column[y], level);
+            }
+        }
+    }
+
+    fftw_free(input);
+    fftw_free(output);
+}
+
+static gpointer worker_main(gpointer data) {
+    SpectralTiles* tiles = data;
+
+    g_mutex_lock(&tiles->lock);
+    while (!tiles->quit) {
+        if (g_queue_is_empty(&tiles->pending)) {
+            g_cond_wait(&tiles->wake, &tiles->lock);
+            continue;
+        }
+
+        Tile* tile = g_queue_pop_head_link(&tiles->pending)->data;
+        tile->state = TILE_BUSY;
+        g_mutex_unlock(&tiles->lock);
+
+        // One tile per job, its columns split over the pool. The pool runs
+        // one job at a time, so this keeps mixer_render() from waiting
+        // behind more than a single tile.
+        TileJob job = { tiles, tile };
+        memset(tile->levels, 0, TILE_BYTES);
+        parallel_for(SPECTRAL_TILE_COLUMNS, TILE_GRAIN, make_columns, &job);
+
+        g_mutex_lock(&tiles->lock);
+        tile->state = TILE_READY;
+    }
+    g_mutex_unlock(&tiles->lock);
+    return NULL;
+}
+
+SpectralTiles* spectral_tiles_new(const AudioData* audio) {
+    if (!audio || !audio->chunks || audio->frames == 0) return NULL;
+
+    SpectralTiles* tiles = calloc(1, sizeof(SpectralTiles));
+    if (!tiles) return NULL;
+
+    tiles->audio = audio_data_clone(audio);
+    tiles->plan = fft_plan_get(SPECTRUM_FFT_SIZE, FFT_R2C);
+    tiles->window = fft_hann_window(SPECTRUM_FFT_SIZE);
+    if (!tiles->audio || !tiles->plan || !tiles->window) {
+        fprintf(stderr, "Could not set up the track spectrogram\n");
+        free_audio_data(tiles->audio);
+        free(tiles);
+        return NULL;
+    }
+
+    g_mutex_init(&tiles->lock);
+    g_cond_init(&tiles->wake);
+    tiles->tiles = g_hash_table_new(g_int64_hash, g_int64_equal);
+    g_queue_init(&tiles->lru);
+    g_queue_init(&tiles->pending);
+    tiles->worker = g_thread_new("spectral tiles", worker_main, tiles);
+    return tiles;
+}
+
+void spectral_tiles_free(SpectralTiles* tiles) {
+    if (!tiles) return;
+
+    g_atomic_int_set(&tiles->cancel, TRUE);
+    g_mutex_lock(&tiles->lock);
+    tiles->quit = TRUE;
+    g_cond_signal(&tiles->wake);
+    g_mutex_unlock(&tiles->lock);
+    g_thread_join(tiles->worker);
+
+    GList* link;
+    while ((link = g_queue_pop_head_link(&tiles->lru)) != NULL) {
+        free(link->data);
+    }
+    g_hash_table_destroy(tiles->tiles);
+    g_cond_clear(&tiles->wake);
+    g_mutex_clear(&tiles->lock);
+    free_audio_data(tiles->audio);
+    free(tiles);
+}
+
+gboolean spectral_tiles_matches(SpectralTiles* tiles, const AudioData* audio) {
+    return tiles && audio_data_shares_channel(tiles->audio, audio, 0);
+}
+
+void spectral_tiles_begin_frame(SpectralTiles* tiles) {
+    if (!tiles) return;
+    g_mutex_lock(&tiles->lock);
+    tiles->frame++;
+    g_mutex_unlock(&tiles->lock);
+}
+
+// Under lock. Tiles asked for this frame and tiles being made stay, even
+// if that means going over budget for a while.
+static void evict(SpectralTiles* tiles) {
+    GList* link = g_queue_peek_tail_link(&tiles->lru);
+    while (link && g_queue_get_length(&tiles->lru) > SPECTRAL_TILES_CACHE) {
+        Tile* tile = link->data;
+        link = link->prev;
+        if (tile->frame == tiles->frame || tile->state == TILE_BUSY) continue;
+
+        if (tile->state == TILE_QUEUED) g_queue_unlink(&tiles->pending, &tile->pending_link);
+        g_queue_unlink(&tiles->lru, &tile->lru_link);
+        g_hash_table_remove(tiles->tiles, &tile->key);
+        free(tile);
+    }
+}
+
+// Under lock
+static Tile* add_tile(SpectralTiles* tiles, int level, size_t index) {
+    Tile* tile = malloc(sizeof(Tile));
+    if (!tile) return NULL;
+
+    tile->key = tile_key(level, index);
+    tile->level = level;
+    tile->index = index;
+    tile->state = TILE_QUEUED;
+    tile->frame = tiles->frame;
+    tile->lru_link.data = tile;
+    tile->pending_link.data = tile;
+    g_hash_table_insert(tiles->tiles, &tile->key, tile);
+    g_queue_push_head_link(&tiles->lru, &tile->lru_link);
+    g_queue_push_head_link(&tiles->pending, &tile->pending_link);
+    g_cond_signal(&tiles->wake);
+
+    evict(tiles);
+    return tile;
+}
+
+const guint8* spectral_tiles_get(SpectralTiles* tiles, int level, size_t index, gboolean request) {
+    if (!tiles || level < 0 || level >= SPECTRAL_TILES_LEVELS) return NULL;
+    // Tiles past the end would only be silence
+    if (index * SPECTRAL_TILE_COLUMNS * spectral_tiles_hop(level) >= tiles->audio->frames) return NULL;
+
+    const guint8* levels = NULL;
+    gint64 key = tile_key(level, index);
+    g_mutex_lock(&tiles->lock);
+    Tile* tile = g_hash_table_lookup(tiles->tiles, &key);
+    if (tile) {
+        tile->frame = tiles->frame;
+        g_queue_unlink(&tiles->lru, &tile->lru_link);
+        g_queue_push_head_link(&tiles->lru, &tile->lru_link);
+        if (tile->state == TILE_READY) {
+            levels = tile->levels;
+        } else if (request && tile->state == TILE_QUEUED) {
+            // Still wanted: ahead of whatever the view has moved away from
+            g_queue_unlink(&tiles->pending, &tile->pending_link);
+            g_queue_push_head_link(&tiles->pending, &tile->pending_link);
+        }
+    } else if (request) {
+        add_tile(tiles, level, index);
+    }
+    g_mutex_unlock(&tiles->lock);
+    return levels;
+}
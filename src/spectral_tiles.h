@@ -0,0 +1,49 @@
+#ifndef SPECTRAL_TILES_H
+#define SPECTRAL_TILES_H
+
+#include <stddef.h>
+#include <glib.h>
+#include "types.h"
+#include "spectrum_analyzer.h"
+
+// Spectrogram of a whole track as a pyramid of tiles, for the zoomable view.
+// It shows the mix itself, before live effects.
+// Level L has one column every SPECTRAL_TILES_HOP << L frames; a tile is
+// SPECTRAL_TILE_COLUMNS columns of SPECTRUM_BINS colour indices (0..255, as
+// the live spectrogram maps magnitudes), column-major. A coarse column takes
+// the loudest of a few FFTs spread over its span, so every tile costs about
+// the same however far out it is.
+//
+// Tiles are made on request by a worker, one at a time with its columns
+// spread over the thread pool, and kept in a cache of at most
+// SPECTRAL_TILES_CACHE of them, least recently used going first. The track
+// is snapshotted when the pyramid is made, so edits after that are not seen;
+// make a new one when the mix changes.
+
+#define SPECTRAL_TILES_HOP 256
+#define SPECTRAL_TILES_LEVELS 16
+#define SPECTRAL_TILE_COLUMNS 256
+#define SPECTRAL_TILES_CACHE 256        // 32 MB of tiles
+
+typedef struct SpectralTiles SpectralTiles;
+
+// The first channel of `audio`, which must be in memory. UI thread.
+SpectralTiles* spectral_tiles_new(const AudioData* audio);
+// Stops the worker part way through a tile if need be, so it returns promptly
+void spectral_tiles_free(SpectralTiles* tiles);
+
+// Whether the pyramid shows exactly this audio: nothing written since
+gboolean spectral_tiles_matches(SpectralTiles* tiles, const AudioData* audio);
+
+// Everything below is UI thread only. Tiles returned since the last
+// spectral_tiles_begin_frame() stay valid until the next one.
+void spectral_tiles_begin_frame(SpectralTiles* tiles);
+
+// A finished tile, or NULL. With `request` a missing tile is queued, so it
+// turns up on a later frame.
+const guint8* spectral_tiles_get(SpectralTiles* tiles, int level, size_t index, gboolean request);
+
+// Frames per column at a level
+size_t spectral_tiles_hop(int level);
+
+#endif
@@ -0,0 +1,153 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <fftw3.h>
+#include "spectrum_analyzer.h"
+#include "audio.h"
+#include "playback.h"
+#include "fft_plans.h"
+#include "ringbuffer.h"
+
+// Two seconds of columns; also as far back as a stalled worker catches up
+#define SPECTRUM_QUEUE_COLUMNS 64
+
+struct SpectrumAnalyzer {
+    AudioPlayer* player;
+    RingBuffer* columns;        // Worker -> UI
+    GThread* thread;
+    gint quit;                  // Tells the worker to exit
+    GMutex wake_lock;           // Lets the worker sleep between hops
+    GCond wake_cond;            // and still stop promptly
+
+    // Worker only
+    const double* window;
+    fftw_plan plan;
+    double* input;
+    fftw_complex* output;
+    float* planes[AUDIO_MAX_CHANNELS];     // The window, every channel played
+    PlaybackEngine* engine;     // Engine being followed; only compared
+    size_t position;            // End of the last window analysed, in its history
+};
+
+static void analyze_window(SpectrumAnalyzer* analyzer, SpectrumColumn* column) {
+    // The first channel, as the waveform view shows
+    const float* samples = analyzer->planes[0];
+    for (int i = 0; i < SPECTRUM_FFT_SIZE; i++) {
+        analyzer->input[i] = samples[i] * analyzer->window[i];
+    }
+    fftw_execute_dft_r2c(analyzer->plan, analyzer->input, analyzer->output);
+
+    // The window halves a sine's peak, so scale by 2 / size rather than 1 / size
+    const fftw_complex* bins = analyzer->output;
+    for (int y = 0; y < SPECTRUM_BINS; y++) {
+        double magnitude = sqrt(bins[y][0] * bins[y][0] + bins[y][1] * bins[y][1]);
+        column->magnitude[y] = (float)(magnitude * 2.0 / SPECTRUM_FFT_SIZE);
+    }
+}
+
+// Analyse the next hop if it has been heard; FALSE once caught up
+static gboolean analyze_next(SpectrumAnalyzer* analyzer) {
+    PlaybackEngine* engine = __atomic_load_n(&analyzer->player->playback, __ATOMIC_ACQUIRE);
+    uint32_t rate = playback_sample_rate(engine);
+    if (!engine || rate == 0) {
+        analyzer->engine = NULL;
+        return FALSE;
+    }
+
+    size_t heard = playback_history_heard(engine);
+    size_t hop = MAX(rate / SPECTRUM_COLUMN_RATE, 1);
+    if (engine != analyzer->engine) {
+        // A new engine: start from wherever it is playing
+        analyzer->engine = engine;
+        analyzer->position = heard;
+    }
+    if (heard < analyzer->position + hop) return FALSE;
+    if (heard - analyzer->position > SPECTRUM_QUEUE_COLUMNS * hop) {
+        // After a stall only the latest columns are worth having
+        analyzer->position = heard - SPECTRUM_QUEUE_COLUMNS * hop;
+    }
+    analyzer->position += hop;
+
+    // Nobody is drawing when the queue is full; the column is dropped. So is
+    // one whose window starts before playback did.
+    SpectrumColumn* column = ring_buffer_write_slot(analyzer->columns);
+    if (column && playback_read_history(engine, analyzer->position, analyzer->planes, SPECTRUM_FFT_SIZE)) {
+        analyze_window(analyzer, column);
+        ring_buffer_commit_write(analyzer->columns);
+    }
+    return TRUE;
+}
+
+static gpointer analysis_thread_func(gpointer data) {
+    SpectrumAnalyzer* analyzer = data;
+    gint64 idle_usec = G_USEC_PER_SEC / SPECTRUM_COLUMN_RATE / 2;
+
+    while (!g_atomic_int_get(&analyzer->quit)) {
+        if (analyze_next(analyzer)) continue;
+
+        g_mutex_lock(&analyzer->wake_lock);
+        if (!g_atomic_int_get(&analyzer->quit)) {
+            g_cond_wait_until(&analyzer->wake_cond, &analyzer->wake_lock,
+                              g_get_monotonic_time() + idle_usec);
+        }
+        g_mutex_unlock(&analyzer->wake_lock);
+    }
+    return NULL;
+}
+
+static void free_buffers(SpectrumAnalyzer* analyzer) {
+    ring_buffer_free(analyzer->columns);
+    fftw_free(analyzer->input);
+    fftw_free(analyzer->output);
+    free(analyzer->planes[0]);
+}
+
+SpectrumAnalyzer* spectrum_analyzer_new(AudioPlayer* player) {
+    if (!player) return NULL;
+
+    SpectrumAnalyzer* analyzer = calloc(1, sizeof(SpectrumAnalyzer));
+    if (!analyzer) return NULL;
+    analyzer->player = player;
+
+    // Plans come from the UI thread, like every other plan lookup
+    analyzer->plan = fft_plan_get(SPECTRUM_FFT_SIZE, FFT_R2C);
+    analyzer->window = fft_hann_window(SPECTRUM_FFT_SIZE);
+    analyzer->input = fftw_alloc_real(SPECTRUM_FFT_SIZE);
+    analyzer->output = fftw_alloc_complex(SPECTRUM_FFT_SIZE / 2 + 1);
+    analyzer->planes[0] = malloc((size_t)AUDIO_MAX_CHANNELS * SPECTRUM_FFT_SIZE * sizeof(float));
+    analyzer->columns = ring_buffer_new(sizeof(SpectrumColumn), SPECTRUM_QUEUE_COLUMNS);
+    if (!analyzer->plan || !analyzer->window || !analyzer->input || !analyzer->output ||
+        !analyzer->planes[0] || !analyzer->columns) {
+        fprintf(stderr, "Could not set up spectrum analysis\n");
+        free_buffers(analyzer);
+        free(analyzer);
+        return NULL;
+    }
+    for (int ch = 1; ch < AUDIO_MAX_CHANNELS; ch++) {
+        analyzer->planes[ch] = analyzer->planes[0] + (size_t)ch * SPECTRUM_FFT_SIZE;
+    }
+
+    g_mutex_init(&analyzer->wake_lock);
+    g_cond_init(&analyzer->wake_cond);
+    analyzer->thread = g_thread_new("spectrum", analysis_thread_func, analyzer);
+    return analyzer;
+}
+
+void spectrum_analyzer_free(SpectrumAnalyzer* analyzer) {
+    if (!analyzer) return;
+
+    g_mutex_lock(&analyzer->wake_lock);
+    g_atomic_int_set(&analyzer->quit, TRUE);
+    g_cond_broadcast(&analyzer->wake_cond);
+    g_mutex_unlock(&analyzer->wake_lock);
+    g_thread_join(analyzer->thread);
+
+    g_cond_clear(&analyzer->wake_cond);
+    g_mutex_clear(&analyzer->wake_lock);
+    free_buffers(analyzer);
+    free(analyzer);
+}
+
+gboolean spectrum_analyzer_pop(SpectrumAnalyzer* analyzer, SpectrumColumn* column) {
+    return analyzer && ring_buffer_pop(analyzer->columns, column);
+}
@@ -0,0 +1,35 @@
+#ifndef SPECTRUM_ANALYZER_H
+#define SPECTRUM_ANALYZER_H
+
+#include <glib.h>
+#include "types.h"
+
+// Spectral analysis for the visualizer, off the GTK thread. A worker follows
+// what the speaker is playing and, for every hop of it, runs a Hann-windowed
+// FFT over the window ending there, read from the playback engine's history
+// so effects are included, and pushes the magnitudes into a lock-free SPSC
+// queue. The UI only pops finished columns, so the column rate follows the
+// audio rather than repaints: nothing is analysed while paused, and a window
+// that stops drawing just lets the queue fill, after which new columns are
+// dropped.
+
+#define SPECTRUM_FFT_SIZE 2048
+#define SPECTRUM_BINS (SPECTRUM_FFT_SIZE / 4)     // Lowest quarter of the spectrum
+#define SPECTRUM_COLUMN_RATE 30                   // Columns per second of playback
+
+typedef struct {
+    // Scaled so a sine of amplitude A reads A / 2 in its bin
+    float magnitude[SPECTRUM_BINS];
+} SpectrumColumn;
+
+typedef struct SpectrumAnalyzer SpectrumAnalyzer;
+
+// Starts the worker; it reads the player's playback engine, so the player and
+// its engine must outlive the analyzer. NULL if the FFT can't be set up.
+SpectrumAnalyzer* spectrum_analyzer_new(AudioPlayer* player);
+void spectrum_analyzer_free(SpectrumAnalyzer* analyzer);
+
+// UI thread: take the oldest column not yet drawn; FALSE when there is none
+gboolean spectrum_analyzer_pop(SpectrumAnalyzer* analyzer, SpectrumColumn* column);
+
+#endif
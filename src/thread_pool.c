@@ -0,0 +1,144 @@
+#include "thread_pool.h"
+
+#define THREAD_POOL_MAX_WORKERS 63
+
+typedef struct {
+    GMutex lock;
+    GCond wake;                 // Workers: a new job or quit
+    GCond done;                 // Caller: the last worker has finished
+    GThread* threads[THREAD_POOL_MAX_WORKERS];
+    guint thread_count;
+    gboolean started;
+    gboolean quit;
+    guint64 generation;         // Bumped for every job
+    guint64 start_generation;   // When the current workers were started
+
+    // The job being run, under lock except next_piece
+    ParallelForFunc func;
+    gpointer data;
+    size_t count;
+    size_t grain;
+    gint pieces;
+    gint next_piece;            // Atomic
+    guint busy;                 // Workers not finished with it yet
+} ThreadPool;
+
+static ThreadPool pool;
+G_LOCK_DEFINE_STATIC(submit);   // One job at a time
+static GPrivate in_piece;       // Set while this thread runs a piece
+
+static void run_pieces(void) {
+    g_private_set(&in_piece, GINT_TO_POINTER(TRUE));
+    gint piece;
+    while ((piece = g_atomic_int_add(&pool.next_piece, 1)) < pool.pieces) {
+        size_t begin = (size_t)piece * pool.grain;
+        pool.func(pool.data, begin, MIN(begin + pool.grain, pool.count));
+    }
+    g_private_set(&in_piece, NULL);
+}
+
+static gpointer worker_main(gpointer data) {
+    (void)data;
+    g_mutex_lock(&pool.lock);
+    // Not pool.generation: a job may already have been posted
+    guint64 seen = pool.start_generation;
+    for (;;) {
+        while (pool.generation == seen && !pool.quit) {
+            g_cond_wait(&pool.wake, &pool.lock);
+        }
+        if (pool.quit) break;
+        seen = pool.generation;
+        g_mutex_unlock(&pool.lock);
+
+        run_pieces();
+
+        g_mutex_lock(&pool.lock);
+        if (--pool.busy == 0) g_cond_signal(&pool.done);
+    }
+    g_mutex_unlock(&pool.lock);
+    return NULL;
+}
+
+// Under submit
+static void ensure_started(void) {
+    if (pool.started) return;
+
+    g_mutex_init(&pool.lock);
+    g_cond_init(&pool.wake);
+    g_cond_init(&pool.done);
+    pool.quit = FALSE;
+    pool.thread_count = 0;
+    pool.start_generation = pool.generation;
+
+    guint wanted = MIN(MAX(g_get_num_processors(), 1) - 1, THREAD_POOL_MAX_WORKERS);
+    for (guint i = 0; i < wanted; i++) {
+        pool.threads[pool.thread_count++] = g_thread_new("worker", worker_main, NULL);
+    }
+    pool.started = TRUE;
+}
+
+void parallel_for(size_t count, size_t grain, ParallelForFunc func, gpointer data) {
+    if (count == 0 || !func) return;
+    // Piece numbers are gints
+    grain = MAX(grain, MAX(1, (count + G_MAXINT - 1) / G_MAXINT));
+    size_t pieces = (count + grain - 1) / grain;
+
+    // Nested calls, and work too small to share, run right here
+    if (g_private_get(&in_piece) || pieces == 1) {
+        for (size_t begin = 0; begin < count; begin += grain) {
+            func(data, begin, MIN(begin + grain, count));
+        }
+        return;
+    }
+
+    G_LOCK(submit);
+    ensure_started();
+
+    g_mutex_lock(&pool.lock);
+    pool.func = func;
+    pool.data = data;
+    pool.count = count;
+    pool.grain = grain;
+    pool.pieces = (gint)pieces;
+    g_atomic_int_set(&pool.next_piece, 0);
+    pool.busy = pool.thread_count;
+    pool.generation++;
+    g_cond_broadcast(&pool.wake);
+    g_mutex_unlock(&pool.lock);
+
+    run_pieces();
+
+    g_mutex_lock(&pool.lock);
+    while (pool.busy > 0) {
+        g_cond_wait(&pool.done, &pool.lock);
+    }
+    g_mutex_unlock(&pool.lock);
+    G_UNLOCK(submit);
+}
+
+guint thread_pool_size(void) {
+    G_LOCK(submit);
+    ensure_started();
+    guint size = pool.thread_count + 1;
+    G_UNLOCK(submit);
+    return size;
+}
+
+void thread_pool_shutdown(void) {
+    G_LOCK(submit);
+    if (pool.started) {
+        g_mutex_lock(&pool.lock);
+        pool.quit = TRUE;
+        g_cond_broadcast(&pool.wake);
+        g_mutex_unlock(&pool.lock);
+        for (guint i = 0; i < pool.thread_count; i++) {
+            g_thread_join(pool.threads[i]);
+        }
+        g_cond_clear(&pool.wake);
+        g_cond_clear(&pool.done);
+        g_mutex_clear(&pool.lock);
+        pool.thread_count = 0;
+        pool.started = FALSE;
+    }
+    G_UNLOCK(submit);
+}
@@ -0,0 +1,25 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <stddef.h>
+#include <glib.h>
+
+// Persistent worker threads for data-parallel loops, one per core besides
+// the caller, started on first use. Offline effects and the mixer split their
+// work into whole audio chunks, which are separately allocated and aligned,
+// so no two pieces ever share a cache line.
+
+// Runs func on [begin, end) pieces of [0, count), each `grain` long except
+// possibly the last, and returns once all are done. The caller takes pieces
+// too. Calls from inside a piece run inline; calls from other threads wait
+// their turn.
+typedef void (*ParallelForFunc)(gpointer data, size_t begin, size_t end);
+void parallel_for(size_t count, size_t grain, ParallelForFunc func, gpointer data);
+
+// Threads that take part in a parallel_for(), the caller included
+guint thread_pool_size(void);
+
+// Stop and join the workers; a later parallel_for() starts them again
+void thread_pool_shutdown(void);
+
+#endif
@@ -0,0 +1,322 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "time_stretch.h"
+#include "simd.h"
+
+#define WINDOW_SECONDS 0.025
+#define SEARCH_STEP 4           // Coarse search stride; the best coarse offset is refined by ±(step - 1)
+
+struct TimeStretch {
+    uint16_t channels;
+    size_t window;          // Frames per grain, multiple of 16
+    size_t hop;             // Output frames per grain (half a window)
+    size_t tolerance;       // Furthest a grain may move from its nominal position, multiple of SEARCH_STEP
+    float* fade;            // Periodic Hann, so 50%-overlapped grains sum to one
+
+    float** input;          // Per channel: buffered input, oldest first
+    float* mono;            // Downmix of input, for the similarity search
+    size_t input_len;
+    size_t input_cap;
+    size_t input_base;      // Input frame number of input[ch][0]
+    double* energy;         // Running sum of mono^2 over the search range
+
+    double nominal;         // Where the next grain would start without the search
+    size_t previous;        // Where the last grain started
+    gboolean first;         // No grain yet, so nothing to match
+
+    float** overlap;        // Per channel: one window of overlap-add
+    float** ready;          // Per channel: finished hop being handed out
+    size_t ready_pos;
+    size_t ready_len;
+};
+
+static float dot_scalar(const float* a, const float* b, size_t n) {
+    float sum = 0.0f;
+    for (size_t i = 0; i < n; i++) {
+        sum += a[i] * b[i];
+    }
+    return sum;
+}
+
+#ifdef HAVE_X86_SIMD
+
+static float dot_sse(const float* a, const float* b, size_t n) {
+    __m128 acc0 = _mm_setzero_ps();
+    __m128 acc1 = _mm_setzero_ps();
+    for (size_t i = 0; i < n; i += 8) {
+        acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+        acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(a + i + 4), _mm_loadu_ps(b + i + 4)));
+    }
+    __m128 acc = _mm_add_ps(acc0, acc1);
+    acc = _mm_add_ps(acc, _mm_movehl_ps(acc, acc));
+    acc = _mm_add_ss(acc, _mm_shuffle_ps(acc, acc, 1));
+    return _mm_cvtss_f32(acc);
+}
+
+__attribute__((target("avx2,fma")))
+static float dot_fma(const float* a, const float* b, size_t n) {
+    __m256 acc0 = _mm256_setzero_ps();
+    __m256 acc1 = _mm256_setzero_ps();
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), acc0);
+        acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8), acc1);
+    }
+    if (i < n) {
+        acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), acc0);
+    }
+    __m256 acc = _mm256_add_ps(acc0, acc1);
+    __m128 sum = _mm_add_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1));
+    sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+    sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+    return _mm_cvtss_f32(sum);
+}
+
+#endif
+
+// n is a multiple of 8
+typedef float (*DotFunc)(const float* a, const float* b, size_t n);
+
+static DotFunc pick_dot(void) {
+#ifdef HAVE_X86_SIMD
+    if (simd_have_avx2() && simd_have_fma()) return dot_fma;
+    return dot_sse;
+#else
+    return dot_scalar;
+#endif
+}
+
+static float** planes_new(uint16_t channels, size_t frames) {
+    float** planes = calloc(channels, sizeof(float*));
+    if (!planes) return NULL;
+    for (uint16_t ch = 0; ch < channels; ch++) {
+        planes[ch] = calloc(frames, sizeof(float));
+        if (!planes[ch]) {
+            for (uint16_t i = 0; i < ch; i++) free(planes[i]);
+            free(planes);
+            return NULL;
+        }
+    }
+    return planes;
+}
+
+static void planes_free(float** planes, uint16_t channels) {
+    if (!planes) return;
+    for (uint16_t ch = 0; ch < channels; ch++) {
+        free(planes[ch]);
+    }
+    free(planes);
+}
+
+TimeStretch* time_stretch_new(uint32_t sample_rate, uint16_t channels) {
+    if (sample_rate == 0 || channels == 0) return NULL;
+
+    TimeStretch* ts = calloc(1, sizeof(TimeStretch));
+    if (!ts) return NULL;
+
+    ts->channels = channels;
+    ts->window = MAX((size_t)(sample_rate * WINDOW_SECONDS) & ~(size_t)15, 64);
+    ts->hop = ts->window / 2;
+    ts->tolerance = (ts->window / 4) & ~(size_t)(SEARCH_STEP - 1);
+
+    // Enough for the search range and window, the furthest one grain can
+    // move the nominal position, and one pull
+    ts->input_cap = 2 * (ts->window + 2 * ts->tolerance) +
+                    (size_t)ceil(ts->hop * TIME_STRETCH_MAX_SPEED) + TIME_STRETCH_MAX_PULL;
+
+    ts->fade = malloc(ts->window * sizeof(float));
+    ts->mono = malloc(ts->input_cap * sizeof(float));
+    ts->energy = malloc((2 * ts->tolerance + ts->hop + 1) * sizeof(double));
+    ts->input = planes_new(channels, ts->input_cap);
+    ts->overlap = planes_new(channels, ts->window);
+    ts->ready = planes_new(channels, ts->hop);
+    if (!ts->fade || !ts->mono || !ts->energy || !ts->input || !ts->overlap || !ts->ready) {
+        time_stretch_free(ts);
+        return NULL;
+    }
+
+    for (size_t i = 0; i < ts->window; i++) {
+        ts->fade[i] = (float)(0.5 - 0.5 * cos(2.0 * M_PI * i / ts->window));
+    }
+
+    time_stretch_reset(ts);
+    return ts;
+}
+
+void time_stretch_free(TimeStretch* ts) {
+    if (!ts) return;
+
+    planes_free(ts->input, ts->channels);
+    planes_free(ts->overlap, ts->channels);
+    planes_free(ts->ready, ts->channels);
+    free(ts->fade);
+    free(ts->mono);
+    free(ts->energy);
+    free(ts);
+}
+
+void time_stretch_reset(TimeStretch* ts) {
+    if (!ts) return;
+
+    ts->input_len = 0;
+    ts->input_base = 0;
+    // Start one search radius in, so no candidate falls before the input
+    ts->nominal = ts->tolerance;
+    ts->previous = 0;
+    ts->first = TRUE;
+    ts->ready_pos = 0;
+    ts->ready_len = 0;
+    for (uint16_t ch = 0; ch < ts->channels; ch++) {
+        memset(ts->overlap[ch], 0, ts->window * sizeof(float));
+    }
+}
+
+size_t time_stretch_lead(const TimeStretch* ts) {
+    // The first grain only fades in, so output starts at its middle
+    return ts->tolerance + ts->hop;
+}
+
+// Buffer input up to (not including) frame `end`
+static void fill_input(TimeStretch* ts, size_t end, TimeStretchSource source, gpointer data) {
+    while (ts->input_base + ts->input_len < end) {
+        size_t n = MIN(end - ts->input_base - ts->input_len, TIME_STRETCH_MAX_PULL);
+        if (ts->input_len + n > ts->input_cap) {
+            // Can't happen with the capacity from time_stretch_new(); never overrun
+            fprintf(stderr, "time_stretch: input buffer overflow\n");
+            n = ts->input_cap - ts->input_len;
+            if (n == 0) return;
+        }
+
+        float* tail[ts->channels];
+        for (uint16_t ch = 0; ch < ts->channels; ch++) {
+            tail[ch] = ts->input[ch] + ts->input_len;
+        }
+        source(data, tail, n);
+
+        float scale = 1.0f / ts->channels;
+        float* mono = ts->mono + ts->input_len;
+        memcpy(mono, tail[0], n * sizeof(float));
+        for (uint16_t ch = 1; ch < ts->channels; ch++) {
+            for (size_t i = 0; i < n; i++) {
+                mono[i] += tail[ch][i];
+            }
+        }
+        for (size_t i = 0; i < n; i++) {
+            mono[i] *= scale;
+        }
+        ts->input_len += n;
+    }
+}
+
+// Correlation of target with the hop at search[offset], over that hop's energy
+static double similarity(const TimeStretch* ts, const float* target, const float* search, long offset,
+                         DotFunc dot) {
+    size_t at = (size_t)(offset + (long)ts->tolerance);
+    double energy = ts->energy[at + ts->hop] - ts->energy[at];
+    if (energy < 1e-12) return 0.0;
+    return dot(target, search + at, ts->hop) / sqrt(energy);
+}
+
+// Offset from `nominal` whose next hop of input looks most like the hop that
+// followed the previous grain, by normalised cross-correlation
+static long find_offset(TimeStretch* ts, size_t nominal, DotFunc dot) {
+    long tolerance = (long)ts->tolerance;
+    const float* target = ts->mono + (ts->previous + ts->hop - ts->input_base);
+    const float* search = ts->mono + (nominal - ts->tolerance - ts->input_base);
+
+    // energy[k] = sum of search[0..k)^2, so any candidate's energy is one subtraction
+    ts->energy[0] = 0.0;
+    for (size_t k = 0; k < 2 * ts->tolerance + ts->hop; k++) {
+        ts->energy[k + 1] = ts->energy[k] + (double)search[k] * search[k];
+    }
+
+    // Staying put wins ties, so silence doesn't wander
+    long best = 0;
+    double best_score = similarity(ts, target, search, 0, dot);
+    for (long offset = -tolerance; offset <= tolerance; offset += SEARCH_STEP) {
+        double score = similarity(ts, target, search, offset, dot);
+        if (score > best_score) {
+            best_score = score;
+            best = offset;
+        }
+    }
+
+    long coarse = best;
+    long lo = MAX(coarse - (SEARCH_STEP - 1), -tolerance);
+    long hi = MIN(coarse + (SEARCH_STEP - 1), tolerance);
+    for (long offset = lo; offset <= hi; offset++) {
+        double score = similarity(ts, target, search, offset, dot);
+        if (score > best_score) {
+            best_score = score;
+            best = offset;
+        }
+    }
+    return best;
+}
+
+// Place one grain and hand out the hop it completes
+static void next_grain(TimeStretch* ts, double speed, TimeStretchSource source, gpointer data,
+                       DotFunc dot) {
+    size_t nominal = (size_t)llround(ts->nominal);
+    fill_input(ts, nominal + ts->tolerance + ts->window, source, data);
+
+    size_t start = ts->first ? nominal : (size_t)((long)nominal + find_offset(ts, nominal, dot));
+    for (uint16_t ch = 0; ch < ts->channels; ch++) {
+        const float* grain = ts->input[ch] + (start - ts->input_base);
+        float* overlap = ts->overlap[ch];
+        for (size_t i = 0; i < ts->window; i++) {
+            overlap[i] += grain[i] * ts->fade[i];
+        }
+    }
+
+    // The first hop has had both of its grains; the very first one, only a
+    // fade-in, is dropped
+    for (uint16_t ch = 0; ch < ts->channels; ch++) {
+        float* overlap = ts->overlap[ch];
+        if (!ts->first) {
+            memcpy(ts->ready[ch], overlap, ts->hop * sizeof(float));
+        }
+        memmove(overlap, overlap + ts->hop, (ts->window - ts->hop) * sizeof(float));
+        memset(overlap + ts->window - ts->hop, 0, ts->hop * sizeof(float));
+    }
+    ts->ready_pos = 0;
+    ts->ready_len = ts->first ? 0 : ts->hop;
+
+    ts->previous = start;
+    ts->first = FALSE;
+    ts->nominal += ts->hop * speed;
+
+    // Drop input that neither the next match target nor the next search can reach
+    size_t keep_from = MIN(start + ts->hop, (size_t)floor(ts->nominal) - ts->tolerance);
+    size_t drop = MIN(keep_from - ts->input_base, ts->input_len);
+    if (drop > 0) {
+        ts->input_len -= drop;
+        for (uint16_t ch = 0; ch < ts->channels; ch++) {
+            memmove(ts->input[ch], ts->input[ch] + drop, ts->input_len * sizeof(float));
+        }
+        memmove(ts->mono, ts->mono + drop, ts->input_len * sizeof(float));
+        ts->input_base += drop;
+    }
+}
+
+void time_stretch_process(TimeStretch* ts, double speed, TimeStretchSource source, gpointer data,
+                          float* const* out, size_t frames) {
+    speed = CLAMP(speed, TIME_STRETCH_MIN_SPEED, TIME_STRETCH_MAX_SPEED);
+    DotFunc dot = pick_dot();
+
+    size_t done = 0;
+    while (done < frames) {
+        if (ts->ready_pos == ts->ready_len) {
+            next_grain(ts, speed, source, data, dot);
+            continue;
+        }
+        size_t n = MIN(frames - done, ts->ready_len - ts->ready_pos);
+        for (uint16_t ch = 0; ch < ts->channels; ch++) {
+            memcpy(out[ch] + done, ts->ready[ch] + ts->ready_pos, n * sizeof(float));
+        }
+        ts->ready_pos += n;
+        done += n;
+    }
+}
@@ -0,0 +1,40 @@
+#ifndef TIME_STRETCH_H
+#define TIME_STRETCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <glib.h>
+
+// Streaming WSOLA (waveform-similarity overlap-add) time stretcher for planar
+// float audio: changes tempo without changing pitch. Output is built from
+// ~25 ms windows of the input, 50% overlapped; each window is taken from
+// wherever within a few ms of its nominal position best continues the
+// previous one, found by normalised cross-correlation on a mono downmix.
+// Every channel uses the same offsets, so the stereo image stays put.
+
+#define TIME_STRETCH_MIN_SPEED 0.25
+#define TIME_STRETCH_MAX_SPEED 4.0
+#define TIME_STRETCH_MAX_PULL 1024  // Most frames asked of the source at once
+
+// Fills exactly `frames` frames of every plane with the next input
+typedef void (*TimeStretchSource)(gpointer data, float* const* planes, size_t frames);
+
+typedef struct TimeStretch TimeStretch;
+
+TimeStretch* time_stretch_new(uint32_t sample_rate, uint16_t channels);
+void time_stretch_free(TimeStretch* ts);
+
+// Forget all buffered input and output, as if freshly created
+void time_stretch_reset(TimeStretch* ts);
+
+// Input frames the output trails by from a reset: output frame m comes from
+// around input frame lead + m * speed
+size_t time_stretch_lead(const TimeStretch* ts);
+
+// Write exactly `frames` frames, pulling input from source as needed. speed
+// (input frames per output frame) is clamped to the range above and may
+// change from call to call.
+void time_stretch_process(TimeStretch* ts, double speed, TimeStretchSource source, gpointer data,
+                          float* const* out, size_t frames);
+
+#endif
@@ -7,17 +7,26 @@
 
 // Only keep AudioPlayer definition here
 typedef struct AudioData AudioData;  // Forward declare AudioData
+typedef struct PlaybackEngine PlaybackEngine;
+typedef struct EffectChain EffectChain;
 
 typedef struct AudioPlayer {
     GList* audio_files;
-    AudioData* active_mix;
-    AudioData* original_mix;
-    size_t ring_buffer_pos;
+    AudioData* active_mix;           // Replaced under mix_lock, which the render thread holds
+    AudioData* original_mix;         // The mix as first loaded, sharing chunks until they change
+    size_t ring_buffer_pos;          // Frame being played, written by the audio side
+    guint64 output_latency_usec;     // Measured device latency, written by the audio side
+    guint output_xruns;              // Device underruns so far, written by the audio side
     size_t last_60_seconds_samples;
     uint32_t target_sample_rate;
     time_t last_effect_time;
-    gboolean effect_active;
     void* ui_ptr;
+    PlaybackEngine* playback;        // Set atomically; the spectrum analyser reads it
+    EffectChain* effects;            // Live effects, applied by the render thread
+    GList* undo_stack;               // History entries, newest first
+    GList* redo_stack;
+    GMutex mix_lock;
+    int mix_policy;                  // MixPolicy for sources of different lengths
 } AudioPlayer;
 
 #endif 
\ No newline at end of file
@@ -1,5 +1,7 @@
 #include "ui.h"
 #include "effects.h"
+#include "effect_chain.h"
+#include "history.h"
 
 // Forward declarations of static functions
 static void create_menu(UI* ui);
@@ -49,10 +51,13 @@ void create_ui(UI* ui, AudioPlayer* player) {
     ui->random_effect_button = gtk_button_new_with_label("Random");
     ui->echo_button = gtk_button_new_with_label("Echo");
     ui->robot_button = gtk_button_new_with_label("Robot");
+    ui->gain_up_button = gtk_button_new_with_label("Gain +");
+    ui->gain_down_button = gtk_button_new_with_label("Gain -");
     ui->export_button = gtk_button_new_with_label("Export");
     ui->color_button = gtk_button_new_with_label("Color");
     ui->clear_button = gtk_button_new_with_label("Clear Drawing");
     ui->save_visuals_button = gtk_button_new_with_label("Save Visuals");
+    ui->track_view_button = gtk_toggle_button_new_with_label("Whole Track");
     
     // Add buttons to toolbar
     gtk_box_pack_start(GTK_BOX(toolbar), ui->bit_mash_button, TRUE, TRUE, 2);
@@ -64,10 +69,13 @@ void create_ui(UI* ui, AudioPlayer* player) {
     gtk_box_pack_start(GTK_BOX(toolbar), ui->random_effect_button, TRUE, TRUE, 2);
     gtk_box_pack_start(GTK_BOX(toolbar), ui->echo_button, TRUE, TRUE, 2);
     gtk_box_pack_start(GTK_BOX(toolbar), ui->robot_button, TRUE, TRUE, 2);
+    gtk_box_pack_start(GTK_BOX(toolbar), ui->gain_up_button, TRUE, TRUE, 2);
+    gtk_box_pack_start(GTK_BOX(toolbar), ui->gain_down_button, TRUE, TRUE, 2);
     gtk_box_pack_start(GTK_BOX(toolbar), ui->export_button, TRUE, TRUE, 2);
     gtk_box_pack_start(GTK_BOX(toolbar), ui->color_button, TRUE, TRUE, 2);
     gtk_box_pack_start(GTK_BOX(toolbar), ui->clear_button, TRUE, TRUE, 2);
     gtk_box_pack_start(GTK_BOX(toolbar), ui->save_visuals_button, TRUE, TRUE, 2);
+    gtk_box_pack_start(GTK_BOX(toolbar), ui->track_view_button, TRUE, TRUE, 2);
     
     // Add pen thickness control
     GtkWidget* thickness_box = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 5);
@@ -94,10 +102,13 @@ void create_ui(UI* ui, AudioPlayer* player) {
     g_signal_connect(ui->random_effect_button, "clicked", G_CALLBACK(on_random_effect_clicked), player);
     g_signal_connect(ui->echo_button, "clicked", G_CALLBACK(on_echo_clicked), player);
     g_signal_connect(ui->robot_button, "clicked", G_CALLBACK(on_robot_clicked), player);
+    g_signal_connect(ui->gain_up_button, "clicked", G_CALLBACK(on_gain_up_clicked), player);
+    g_signal_connect(ui->gain_down_button, "clicked", G_CALLBACK(on_gain_down_clicked), player);
     g_signal_connect(ui->export_button, "clicked", G_CALLBACK(on_export_clicked), player);
     g_signal_connect(ui->color_button, "clicked", G_CALLBACK(on_color_clicked), &ui->visualizer);
     g_signal_connect(ui->clear_button, "clicked", G_CALLBACK(on_clear_clicked), &ui->visualizer);
     g_signal_connect(ui->save_visuals_button, "clicked", G_CALLBACK(on_save_visuals_clicked), &ui->visualizer);
+    g_signal_connect(ui->track_view_button, "toggled", G_CALLBACK(on_track_view_toggled), &ui->visualizer);
     
     // Show all widgets
     gtk_widget_show_all(ui->window);
@@ -134,73 +145,94 @@ void cleanup_ui(UI* ui) {
     cleanup_visualizer(&ui->visualizer);
 }
 
-// Button callback implementations
+// Button callback implementations. Effects go on the live chain, so they
+// are heard within a block and the volume sliders keep working.
 void on_bit_mash_clicked(GtkButton* button, gpointer data) {
     (void)button;
     AudioPlayer* player = (AudioPlayer*)data;
-    if (!player || !player->active_mix) return;
-    
-    // Apply effect directly to active mix
-    bit_mash(player, player->active_mix, 0.5f);
+    if (!player) return;
+    history_record(player);
+    effect_chain_add(player->effects, EFFECT_BIT_MASH, 0.5f, 0.0f);
 }
 
 void on_bit_drop_clicked(GtkButton* button, gpointer data) {
     (void)button;
     AudioPlayer* player = (AudioPlayer*)data;
-    if (!player || !player->active_mix) return;
-    bit_drop(player, player->active_mix, 0.2f);
-    mix_audio_files(player);
+    if (!player) return;
+    history_record(player);
+    effect_chain_add(player->effects, EFFECT_BIT_DROP, 0.2f, 0.0f);
 }
 
 void on_tempo_up_clicked(GtkButton* button, gpointer data) {
     (void)button;
     AudioPlayer* player = (AudioPlayer*)data;
-    tempo_shift(player, player->active_mix, 1.2f);
-    mix_audio_files(player);
+    if (!player) return;
+    history_record(player);
+    effect_chain_add(player->effects, EFFECT_TEMPO, 1.2f, 0.0f);
 }
 
 void on_tempo_down_clicked(GtkButton* button, gpointer data) {
     (void)button;
     AudioPlayer* player = (AudioPlayer*)data;
-    tempo_shift(player, player->active_mix, 0.8f);
-    mix_audio_files(player);
+    if (!player) return;
+    history_record(player);
+    effect_chain_add(player->effects, EFFECT_TEMPO, 0.8f, 0.0f);
 }
 
 void on_pitch_up_clicked(GtkButton* button, gpointer data) {
     (void)button;
     AudioPlayer* player = (AudioPlayer*)data;
-    pitch_shift(player, player->active_mix, 2.0f);
-    mix_audio_files(player);
+    if (!player) return;
+    history_record(player);
+    effect_chain_add(player->effects, EFFECT_PITCH, 2.0f, 0.0f);
 }
 
 void on_pitch_down_clicked(GtkButton* button, gpointer data) {
     (void)button;
     AudioPlayer* player = (AudioPlayer*)data;
-    if (!player || !player->active_mix) return;
-    
-    // Apply effect directly to active mix
-    pitch_shift(player, player->active_mix, -2.0f);
+    if (!player) return;
+    history_record(player);
+    effect_chain_add(player->effects, EFFECT_PITCH, -2.0f, 0.0f);
 }
 
 void on_random_effect_clicked(GtkButton* button, gpointer data) {
     (void)button;
     AudioPlayer* player = (AudioPlayer*)data;
-    random_effect(player, player->active_mix);
-    mix_audio_files(player);
+    if (!player) return;
+    history_record(player);
+    effect_chain_add_random(player->effects);
 }
 
 void on_echo_clicked(GtkButton* button, gpointer data) {
     (void)button;
     AudioPlayer* player = (AudioPlayer*)data;
-    add_echo(player, player->active_mix, 200.0f, 0.5f);
-    mix_audio_files(player);
+    if (!player) return;
+    history_record(player);
+    effect_chain_add(player->effects, EFFECT_ECHO, 200.0f, 0.5f);
 }
 
 void on_robot_clicked(GtkButton* button, gpointer data) {
     (void)button;
     AudioPlayer* player = (AudioPlayer*)data;
-    add_robot(player, player->active_mix, 5.0f);
-    mix_audio_files(player);
+    if (!player) return;
+    history_record(player);
+    effect_chain_add(player->effects, EFFECT_ROBOT, 5.0f, 0.0f);
+}
+
+void on_gain_up_clicked(GtkButton* button, gpointer data) {
+    (void)button;
+    AudioPlayer* player = (AudioPlayer*)data;
+    if (!player) return;
+    history_record(player);
+    effect_chain_add(player->effects, EFFECT_GAIN, 3.0f, 0.0f);
+}
+
+void on_gain_down_clicked(GtkButton* button, gpointer data) {
+    (void)button;
+    AudioPlayer* player = (AudioPlayer*)data;
+    if (!player) return;
+    history_record(player);
+    effect_chain_add(player->effects, EFFECT_GAIN, -3.0f, 0.0f);
 }
 
 void on_export_clicked(GtkButton* button, gpointer data) {
@@ -234,9 +266,23 @@ static void create_menu(UI* ui) {
     
     gtk_menu_shell_append(GTK_MENU_SHELL(ui->menubar), file_menu_item);
     
+    // Edit menu
+    GtkWidget* edit_menu_item = gtk_menu_item_new_with_label("Edit");
+    GtkWidget* edit_menu = gtk_menu_new();
+    gtk_menu_item_set_submenu(GTK_MENU_ITEM(edit_menu_item), edit_menu);
+    
+    GtkWidget* undo_item = gtk_menu_item_new_with_label("Undo");
+    GtkWidget* redo_item = gtk_menu_item_new_with_label("Redo");
+    gtk_menu_shell_append(GTK_MENU_SHELL(edit_menu), undo_item);
+    gtk_menu_shell_append(GTK_MENU_SHELL(edit_menu), redo_item);
+    
+    gtk_menu_shell_append(GTK_MENU_SHELL(ui->menubar), edit_menu_item);
+    
     // Connect signals
     g_signal_connect(G_OBJECT(open_item), "activate", G_CALLBACK(on_open_file), ui);
     g_signal_connect(G_OBJECT(reset_item), "activate", G_CALLBACK(on_reset), ui);
+    g_signal_connect(G_OBJECT(undo_item), "activate", G_CALLBACK(on_undo), ui);
+    g_signal_connect(G_OBJECT(redo_item), "activate", G_CALLBACK(on_redo), ui);
     
     // Add Import Image item after Open WAV
     GtkWidget* import_image_item = gtk_menu_item_new_with_label("Import Image...");
@@ -324,6 +370,22 @@ void on_reset(GtkMenuItem* item, gpointer data) {
     update_mix_controls(ui);
 }
 
+void on_undo(GtkMenuItem* item, gpointer data) {
+    (void)item;
+    UI* ui = (UI*)data;
+    if (!history_undo(ui->player)) {
+        printf("Nothing to undo\n");
+    }
+}
+
+void on_redo(GtkMenuItem* item, gpointer data) {
+    (void)item;
+    UI* ui = (UI*)data;
+    if (!history_redo(ui->player)) {
+        printf("Nothing to redo\n");
+    }
+}
+
 void on_volume_changed(GtkRange* range, gpointer data) {
     AudioData* audio = (AudioData*)data;
     audio->mix_volume = gtk_range_get_value(range);
@@ -413,15 +475,13 @@ static void on_recent_export_clicked(GtkMenuItem* item, gpointer data) {
     if (ui->player) {
         reset_to_original(ui->player);
         
-        // Add the new file
+        // Add the new file; it shares the mapping we just opened
         add_audio_file(ui->player, filename);
         update_mix_controls(ui);
     } else {
         printf("Error: Player not initialized\n");
-        free(audio->buffer);
-        free(audio->filename);
-        free(audio);
     }
+    free_audio_data(audio);
 }
 
 void on_color_clicked(GtkButton* button, gpointer data) {
@@ -438,12 +498,12 @@ static gboolean on_window_delete_event(GtkWidget* widget G_GNUC_UNUSED,
     // Stop audio playback
     stop_audio(ui->player);
     
+    // Clean up visualizer first; its analysis thread reads the player
+    cleanup_visualizer(&ui->visualizer);
+    
     // Clean up audio player
     cleanup_audio_player(ui->player);
     
-    // Clean up visualizer
-    cleanup_visualizer(&ui->visualizer);
-    
     // Allow window to close
     gtk_main_quit();
     return FALSE;
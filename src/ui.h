@@ -22,10 +22,14 @@ void on_pitch_down_clicked(GtkButton* button, gpointer data);
 void on_random_effect_clicked(GtkButton* button, gpointer data);
 void on_echo_clicked(GtkButton* button, gpointer data);
 void on_robot_clicked(GtkButton* button, gpointer data);
+void on_gain_up_clicked(GtkButton* button, gpointer data);
+void on_gain_down_clicked(GtkButton* button, gpointer data);
 void on_export_clicked(GtkButton* button, gpointer data);
 void on_color_clicked(GtkButton* button, gpointer data);
 void on_open_file(GtkMenuItem* item, gpointer data);
 void on_reset(GtkMenuItem* item, gpointer data);
+void on_undo(GtkMenuItem* item, gpointer data);
+void on_redo(GtkMenuItem* item, gpointer data);
 void on_volume_changed(GtkRange* range, gpointer data);
 void on_remove_file(GtkButton* button, gpointer data);
 void on_import_image(GtkMenuItem* item, gpointer data);
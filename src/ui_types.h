@@ -19,6 +19,8 @@ typedef struct UI {
     GtkWidget* random_effect_button;
     GtkWidget* echo_button;
     GtkWidget* robot_button;
+    GtkWidget* gain_up_button;
+    GtkWidget* gain_down_button;
     GtkWidget* export_button;
     GtkWidget* color_button;
     GtkWidget* reset_button;
@@ -30,6 +32,7 @@ typedef struct UI {
     int export_counter;     // For auto-incrementing export names
     GtkWidget* clear_button;
     GtkWidget* save_visuals_button;
+    GtkWidget* track_view_button;    // Whole-track spectrogram on/off
     GtkWidget* pen_thickness_scale;  // Pen thickness slider
 } UI;
 
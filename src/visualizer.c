@@ -1,52 +1,23 @@
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
-#include <fftw3.h>
 #include "effects.h"
+#include "effect_chain.h"
+#include "history.h"
+#include "rng.h"
 #include "visualizer.h"
 #include "ui.h"
 
-#define FFT_SIZE 2048
 #define SPECTROGRAM_HEIGHT 256
 #define EFFECT_DELAY_MS 2000  // Wait 2 seconds after last input
+#define TRACK_MIN_FRAMES_PER_PIXEL 16.0   // Furthest the track view zooms in
+#define TRACK_ZOOM_STEP 1.25              // Zoom per scroll step
 
 // Add these function declarations at the top with other forward declarations
-static void init_fft();
-static void cleanup_fft();
 double calculate_line_width(double dx, double dy, double dt, double base_thickness);
 void detect_and_apply_shape(Visualizer* vis);
 static gboolean process_deferred_effects(gpointer data);
 
-typedef struct {
-    double* input;
-    fftw_complex* output;
-    fftw_plan plan;
-} FFTContext;
-
-static FFTContext* fft_context = NULL;
-
-static void init_fft() {
-    if (!fft_context) {
-        fft_context = malloc(sizeof(FFTContext));
-        fft_context->input = fftw_alloc_real(FFT_SIZE);
-        fft_context->output = fftw_alloc_complex(FFT_SIZE / 2 + 1);
-        fft_context->plan = fftw_plan_dft_r2c_1d(FFT_SIZE, 
-                                                fft_context->input,
-                                                fft_context->output,
-                                                FFTW_MEASURE);
-    }
-}
-
-static void cleanup_fft() {
-    if (fft_context) {
-        fftw_destroy_plan(fft_context->plan);
-        fftw_free(fft_context->input);
-        fftw_free(fft_context->output);
-        free(fft_context);
-        fft_context = NULL;
-    }
-}
-
 void init_visualizer(Visualizer* vis, AudioPlayer* player) {
     vis->player = player;
     vis->color_scheme = 0;
@@ -54,6 +25,14 @@ void init_visualizer(Visualizer* vis, AudioPlayer* player) {
     vis->last_x = 0;
     vis->last_y = 0;
     vis->draw_surface = NULL;
+    vis->spectrogram_surface = NULL;
+    vis->spectrogram_levels = NULL;
+    vis->analyzer = spectrum_analyzer_new(player);
+    vis->track_view = FALSE;
+    vis->track_tiles = NULL;
+    vis->track_surface = NULL;
+    vis->track_frames = 0;
+    vis->panning = FALSE;
     vis->erase_mode = FALSE;
     vis->effect_timer_id = 0;
     vis->needs_processing = FALSE;
@@ -73,6 +52,7 @@ void init_visualizer(Visualizer* vis, AudioPlayer* player) {
                          GDK_BUTTON_PRESS_MASK |
                          GDK_BUTTON_RELEASE_MASK |
                          GDK_POINTER_MOTION_MASK |
+                         GDK_SCROLL_MASK |
                          GDK_KEY_PRESS_MASK |
                          GDK_KEY_RELEASE_MASK);
     
@@ -91,12 +71,12 @@ void init_visualizer(Visualizer* vis, AudioPlayer* player) {
                     G_CALLBACK(on_spectrogram_draw_end), vis);
     g_signal_connect(vis->spectrogram_drawing_area, "motion-notify-event",
                     G_CALLBACK(on_spectrogram_draw_motion), vis);
+    g_signal_connect(vis->spectrogram_drawing_area, "scroll-event",
+                    G_CALLBACK(on_spectrogram_scroll), vis);
     g_signal_connect(vis->spectrogram_drawing_area, "key-press-event",
                     G_CALLBACK(on_key_press), vis);
     g_signal_connect(vis->spectrogram_drawing_area, "key-release-event",
                     G_CALLBACK(on_key_release), vis);
-    
-    init_fft();
 }
 
 void cleanup_visualizer(Visualizer* vis) {
@@ -104,7 +84,20 @@ void cleanup_visualizer(Visualizer* vis) {
         cairo_surface_destroy(vis->draw_surface);
         vis->draw_surface = NULL;
     }
-    cleanup_fft();
+    if (vis->spectrogram_surface) {
+        cairo_surface_destroy(vis->spectrogram_surface);
+        vis->spectrogram_surface = NULL;
+    }
+    g_free(vis->spectrogram_levels);
+    vis->spectrogram_levels = NULL;
+    spectrum_analyzer_free(vis->analyzer);
+    vis->analyzer = NULL;
+    if (vis->track_surface) {
+        cairo_surface_destroy(vis->track_surface);
+        vis->track_surface = NULL;
+    }
+    spectral_tiles_free(vis->track_tiles);
+    vis->track_tiles = NULL;
     if (vis->effect_timer_id > 0) {
         g_source_remove(vis->effect_timer_id);
         vis->effect_timer_id = 0;
@@ -121,63 +114,90 @@ gboolean update_visualizer(Visualizer* vis) {
 }
 
 // Color schemes
-static void set_color_by_intensity(cairo_t* cr, double intensity, int scheme) {
+static void scheme_rgb(int scheme, double intensity, double rgb[3]) {
     switch (scheme) {
         case COLOR_CLASSIC:  // Original green
-            cairo_set_source_rgb(cr, 0.0, intensity, 0.0);
+            rgb[0] = 0.0;
+            rgb[1] = intensity;
+            rgb[2] = 0.0;
             break;
             
         case COLOR_WARM:  // Warm colors
-            cairo_set_source_rgb(cr, 
-                intensity,                    // Red
-                intensity * 0.6,              // Orange component
-                intensity * 0.2);             // Slight yellow
+            rgb[0] = intensity;                 // Red
+            rgb[1] = intensity * 0.6;           // Orange component
+            rgb[2] = intensity * 0.2;           // Slight yellow
             break;
             
         case COLOR_COOL:  // Cool colors
-            cairo_set_source_rgb(cr,
-                intensity * 0.2,              // Slight red
-                intensity * 0.8,              // Blue-green
-                intensity);                   // Full blue
+            rgb[0] = intensity * 0.2;           // Slight red
+            rgb[1] = intensity * 0.8;           // Blue-green
+            rgb[2] = intensity;                 // Full blue
             break;
             
         case COLOR_DARK:  // Dark theme
-            cairo_set_source_rgb(cr,
-                intensity * 0.3,              // Dark red
-                0,                           // No green
-                intensity * 0.4);             // Deep blue
+            rgb[0] = intensity * 0.3;           // Dark red
+            rgb[1] = 0;                         // No green
+            rgb[2] = intensity * 0.4;           // Deep blue
             break;
             
         case COLOR_LIGHT:  // Light theme
-            cairo_set_source_rgb(cr,
-                0.7 + (intensity * 0.3),      // High base red
-                0.7 + (intensity * 0.3),      // High base green
-                0.8 + (intensity * 0.2));     // High base blue
+            rgb[0] = 0.7 + (intensity * 0.3);   // High base red
+            rgb[1] = 0.7 + (intensity * 0.3);   // High base green
+            rgb[2] = 0.8 + (intensity * 0.2);   // High base blue
             break;
             
         case COLOR_GOTH:  // Gothic theme
-            cairo_set_source_rgb(cr,
-                intensity * 0.8,              // Deep red
-                intensity * 0.1,              // Almost no green
-                intensity * 0.1);             // Almost no blue
+            rgb[0] = intensity * 0.8;           // Deep red
+            rgb[1] = intensity * 0.1;           // Almost no green
+            rgb[2] = intensity * 0.1;           // Almost no blue
             break;
             
         case COLOR_BAROQUE:  // Rich baroque
-            cairo_set_source_rgb(cr,
-                0.6 + (intensity * 0.4),      // Gold base
-                0.4 * intensity,              // Rich middle
-                0.1 + (intensity * 0.3));     // Deep undertones
+            rgb[0] = 0.6 + (intensity * 0.4);   // Gold base
+            rgb[1] = 0.4 * intensity;           // Rich middle
+            rgb[2] = 0.1 + (intensity * 0.3);   // Deep undertones
             break;
             
         case COLOR_ROMANTIC:  // Romantic pastels
-            cairo_set_source_rgb(cr,
-                0.7 + (intensity * 0.3),      // Pink base
-                0.6 + (intensity * 0.3),      // Soft middle
-                0.8 + (intensity * 0.2));     // Lavender tint
+        default:
+            rgb[0] = 0.7 + (intensity * 0.3);   // Pink base
+            rgb[1] = 0.6 + (intensity * 0.3);   // Soft middle
+            rgb[2] = 0.8 + (intensity * 0.2);   // Lavender tint
             break;
     }
 }
 
+static void set_color_by_intensity(cairo_t* cr, double intensity, int scheme) {
+    double rgb[3];
+    scheme_rgb(scheme, intensity, rgb);
+    cairo_set_source_rgb(cr, rgb[0], rgb[1], rgb[2]);
+}
+
+// Cairo's 32-bit pixel layout, native-endian, fully opaque
+static uint32_t pack_pixel(double r, double g, double b) {
+    return 0xFF000000u | (uint32_t)lrint(r * 255.0) << 16 | (uint32_t)lrint(g * 255.0) << 8 |
+           (uint32_t)lrint(b * 255.0);
+}
+
+// Every scheme's colours at 256 intensities, so a spectrogram pixel is a
+// table lookup rather than a cairo fill
+static uint32_t color_luts[NUM_COLOR_SCHEMES][256];
+static gsize color_luts_ready = 0;
+
+static const uint32_t* color_lut(int scheme) {
+    if (g_once_init_enter(&color_luts_ready)) {
+        for (int s = 0; s < NUM_COLOR_SCHEMES; s++) {
+            for (int i = 0; i < 256; i++) {
+                double rgb[3];
+                scheme_rgb(s, i / 255.0, rgb);
+                color_luts[s][i] = pack_pixel(rgb[0], rgb[1], rgb[2]);
+            }
+        }
+        g_once_init_leave(&color_luts_ready, 1);
+    }
+    return color_luts[CLAMP(scheme, 0, NUM_COLOR_SCHEMES - 1)];
+}
+
 // Update pen color based on scheme
 static void set_pen_color(cairo_t* cr, int scheme) {
     switch (scheme) {
@@ -212,46 +232,50 @@ static void set_pen_color(cairo_t* cr, int scheme) {
 void apply_color_scheme_effects(AudioPlayer* player, int scheme) {
     if (!player || !player->active_mix) return;
     
+    history_record(player);
+    EffectNode* node;
     switch (scheme) {
         case COLOR_WARM:
             // Warm: Add harmonics and slight distortion
-            bit_mash(player, player->active_mix, 0.2);
-            pitch_shift(player, player->active_mix, 0.5);
+            effect_chain_add(player->effects, EFFECT_BIT_MASH, 0.2, 0.0f);
+            effect_chain_add(player->effects, EFFECT_PITCH, 0.5, 0.0f);
             break;
             
         case COLOR_COOL:
             // Cool: Add reverb and slight pitch down
-            add_echo(player, player->active_mix, 300, 0.3);
-            pitch_shift(player, player->active_mix, -0.5);
+            effect_chain_add(player->effects, EFFECT_ECHO, 300, 0.3);
+            effect_chain_add(player->effects, EFFECT_PITCH, -0.5, 0.0f);
             break;
             
         case COLOR_DARK:
             // Dark: Heavy reverb and pitch down
-            add_echo(player, player->active_mix, 500, 0.5);
-            pitch_shift(player, player->active_mix, -2.0);
+            node = effect_chain_add(player->effects, EFFECT_ECHO, 500, 0.5);
+            effect_node_set_param(node, 2, 4);
+            effect_node_set_param(node, 3, 0.6);
+            effect_chain_add(player->effects, EFFECT_PITCH, -2.0, 0.0f);
             break;
             
         case COLOR_LIGHT:
             // Light: Bright harmonics
-            pitch_shift(player, player->active_mix, 2.0);
+            effect_chain_add(player->effects, EFFECT_PITCH, 2.0, 0.0f);
             break;
             
         case COLOR_GOTH:
             // Gothic: Distortion and deep pitch
-            bit_mash(player, player->active_mix, 0.4);
-            pitch_shift(player, player->active_mix, -4.0);
+            effect_chain_add(player->effects, EFFECT_BIT_MASH, 0.4, 0.0f);
+            effect_chain_add(player->effects, EFFECT_PITCH, -4.0, 0.0f);
             break;
             
         case COLOR_BAROQUE:
             // Baroque: Rich harmonics
-            add_echo(player, player->active_mix, 200, 0.3);
-            pitch_shift(player, player->active_mix, 1.0);
+            effect_chain_add(player->effects, EFFECT_ECHO, 200, 0.3);
+            effect_chain_add(player->effects, EFFECT_PITCH, 1.0, 0.0f);
             break;
             
         case COLOR_ROMANTIC:
             // Romantic: Soft reverb and slight pitch up
-            add_echo(player, player->active_mix, 400, 0.2);
-            pitch_shift(player, player->active_mix, 0.5);
+            effect_chain_add(player->effects, EFFECT_ECHO, 400, 0.2);
+            effect_chain_add(player->effects, EFFECT_PITCH, 0.5, 0.0f);
             break;
     }
 }
@@ -272,26 +296,50 @@ gboolean draw_waveform(GtkWidget* widget, cairo_t* cr, gpointer data) {
     cairo_set_source_rgb(cr, 0.1, 0.1, 0.1);
     cairo_paint(cr);
     
-    // Draw waveform
-    set_color_by_intensity(cr, 1.0, vis->color_scheme);
-    cairo_set_line_width(cr, 1.0);
-    
-    size_t num_samples = vis->player->active_mix->buffer_size / sizeof(int16_t);
-    size_t step = num_samples / width;
-    if (step < 1) step = 1;
-    
-    cairo_move_to(cr, 0, height / 2);
-    
-    // Start drawing from current playback position
-    size_t start_pos = vis->player->ring_buffer_pos;
-    for (int x = 0; x < width; x++) {
-        size_t idx = (start_pos + x * step) % num_samples;
-        float sample = vis->player->active_mix->buffer[idx] / 32768.0f;
-        int y = (int)(height / 2 * (1.0 - sample));
-        cairo_line_to(cr, x, y);
+    const AudioData* mix = vis->player->active_mix;
+    size_t num_samples = mix->frames;
+    if (num_samples == 0 || width <= 0) return FALSE;
+    
+    // The whole mix across the width, starting from the playback position.
+    // It is the mix itself, before live effects: what they make only exists
+    // for what has been played. Each pixel shows the min..max of every sample
+    // it covers, with the RMS band inside it brighter, one lane per channel;
+    // audio_data_peak() keeps that a few dozen entries a pixel however long
+    // the mix is.
+    size_t start_pos = vis->player->ring_buffer_pos % num_samples;
+    double lane = (double)height / mix->channels;
+    AudioPeak* peaks = g_new(AudioPeak, width);
+    for (uint16_t ch = 0; ch < mix->channels; ch++) {
+        for (int x = 0; x < width; x++) {
+            size_t first = (size_t)x * num_samples / width;
+            size_t count = MAX((size_t)(x + 1) * num_samples / width, first + 1) - first;
+            
+            // Split where the span wraps past the end of the mix
+            size_t from = (start_pos + first) % num_samples;
+            size_t head = MIN(count, num_samples - from);
+            peaks[x] = audio_data_peak(mix, ch, from, head);
+            if (head < count) {
+                AudioPeak rest = audio_data_peak(mix, ch, 0, count - head);
+                peaks[x].min = MIN(peaks[x].min, rest.min);
+                peaks[x].max = MAX(peaks[x].max, rest.max);
+                peaks[x].rms = sqrtf((peaks[x].rms * peaks[x].rms * head +
+                                      rest.rms * rest.rms * (count - head)) / count);
+            }
+        }
+        
+        double middle = lane * (ch + 0.5);
+        double scale = lane / 2;
+        for (int pass = 0; pass < 2; pass++) {
+            set_color_by_intensity(cr, pass == 0 ? 0.6 : 1.0, vis->color_scheme);
+            for (int x = 0; x < width; x++) {
+                double top = pass == 0 ? CLAMP(peaks[x].max, -1.0f, 1.0f) : MIN(peaks[x].rms, 1.0f);
+                double bottom = pass == 0 ? CLAMP(peaks[x].min, -1.0f, 1.0f) : -MIN(peaks[x].rms, 1.0f);
+                cairo_rectangle(cr, x, middle - top * scale, 1, MAX((top - bottom) * scale, 1.0));
+            }
+            cairo_fill(cr);
+        }
     }
-    
-    cairo_stroke(cr);
+    g_free(peaks);
     
     // Add click handler if not already connected
     static gboolean handler_connected = FALSE;
@@ -304,6 +352,208 @@ gboolean draw_waveform(GtkWidget* widget, cairo_t* cr, gpointer data) {
     return FALSE;
 }
 
+// The spectrogram is kept as a ring of pixel columns the size of the widget.
+// Each analysed column is painted left of the previous one, and the
+// widget shows the ring from the newest column on, newest at the left, as two
+// blits split at the wrap point. Only a resize or a new colour scheme
+// repaints the whole image.
+
+static gboolean ensure_spectrogram_ring(Visualizer* vis, int width, int height) {
+    cairo_surface_t* surface = vis->spectrogram_surface;
+    if (surface && cairo_image_surface_get_width(surface) == width &&
+        cairo_image_surface_get_height(surface) == height) {
+        return TRUE;
+    }
+    
+    if (surface) cairo_surface_destroy(surface);
+    g_free(vis->spectrogram_levels);
+    vis->spectrogram_surface = NULL;
+    vis->spectrogram_levels = NULL;
+    if (width <= 0 || height <= 0) return FALSE;
+    
+    surface = cairo_image_surface_create(CAIRO_FORMAT_RGB24, width, height);
+    if (cairo_surface_status(surface) != CAIRO_STATUS_SUCCESS) {
+        cairo_surface_destroy(surface);
+        return FALSE;
+    }
+    vis->spectrogram_surface = surface;
+    vis->spectrogram_bins = MIN(SPECTRUM_BINS, height);
+    vis->spectrogram_levels = g_malloc0((size_t)width * vis->spectrogram_bins);
+    vis->spectrogram_head = 0;
+    vis->spectrogram_scheme = -1;
+    return TRUE;
+}
+
+// Bin y is row height - 1 - y
+static void paint_spectrogram_column(Visualizer* vis, int column, const uint32_t* lut) {
+    cairo_surface_t* surface = vis->spectrogram_surface;
+    unsigned char* pixels = cairo_image_surface_get_data(surface);
+    int stride = cairo_image_surface_get_stride(surface);
+    int height = cairo_image_surface_get_height(surface);
+    const guint8* levels = vis->spectrogram_levels + (size_t)column * vis->spectrogram_bins;
+    
+    unsigned char* pixel = pixels + (size_t)(height - 1) * stride + (size_t)column * sizeof(uint32_t);
+    for (int y = 0; y < vis->spectrogram_bins; y++) {
+        *(uint32_t*)pixel = lut[levels[y]];
+        pixel -= stride;
+    }
+}
+
+static void repaint_spectrogram(Visualizer* vis, const uint32_t* lut) {
+    cairo_surface_t* surface = vis->spectrogram_surface;
+    unsigned char* pixels = cairo_image_surface_get_data(surface);
+    int stride = cairo_image_surface_get_stride(surface);
+    int width = cairo_image_surface_get_width(surface);
+    int height = cairo_image_surface_get_height(surface);
+    
+    // Rows above the spectrum never change
+    const uint32_t background = pack_pixel(0.1, 0.1, 0.1);
+    for (int row = 0; row < height - vis->spectrogram_bins; row++) {
+        uint32_t* line = (uint32_t*)(pixels + (size_t)row * stride);
+        for (int x = 0; x < width; x++) {
+            line[x] = background;
+        }
+    }
+    for (int x = 0; x < width; x++) {
+        paint_spectrogram_column(vis, x, lut);
+    }
+}
+
+// Store one analysed column as the newest; returns where it went
+static int push_spectrogram_column(Visualizer* vis, const SpectrumColumn* spectrum, const uint32_t* lut) {
+    int width = cairo_image_surface_get_width(vis->spectrogram_surface);
+    vis->spectrogram_head = (vis->spectrogram_head + width - 1) % width;
+    
+    guint8* levels = vis->spectrogram_levels + (size_t)vis->spectrogram_head * vis->spectrogram_bins;
+    for (int y = 0; y < vis->spectrogram_bins; y++) {
+        // Colour index of intensity = min(1, magnitude * 5)
+        levels[y] = (guint8)fminf(spectrum->magnitude[y] * 5.0f * 255.0f + 0.5f, 255.0f);
+    }
+    paint_spectrogram_column(vis, vis->spectrogram_head, lut);
+    return vis->spectrogram_head;
+}
+
+// The whole-track view shows the mix from track_start on at
+// track_frames_per_pixel, repainted every frame from the spectral tiles.
+// Each pixel column takes the finest level with at most one tile column per
+// pixel; while a tile is still being made a coarser one already cached
+// stands in, so panning and zooming never wait for FFTs.
+
+// Keep the view on the track and no wider than all of it
+static void clamp_track_view(Visualizer* vis, int width) {
+    double frames = (double)vis->track_frames;
+    double widest = MAX(frames / MAX(width, 1), TRACK_MIN_FRAMES_PER_PIXEL);
+    vis->track_frames_per_pixel = CLAMP(vis->track_frames_per_pixel, TRACK_MIN_FRAMES_PER_PIXEL, widest);
+    vis->track_start = CLAMP(vis->track_start, 0.0, MAX(frames - width * vis->track_frames_per_pixel, 0.0));
+}
+
+// Tiles for the active mix, remade whenever it has changed
+static gboolean ensure_track_tiles(Visualizer* vis, int width) {
+    const AudioData* mix = vis->player ? vis->player->active_mix : NULL;
+    if (!mix || !mix->chunks || mix->frames == 0) {
+        spectral_tiles_free(vis->track_tiles);
+        vis->track_tiles = NULL;
+        return FALSE;
+    }
+    
+    if (!spectral_tiles_matches(vis->track_tiles, mix)) {
+        spectral_tiles_free(vis->track_tiles);
+        vis->track_tiles = spectral_tiles_new(mix);
+    }
+    if (mix->frames != vis->track_frames) {
+        // A new length: fit the whole track again
+        vis->track_frames = mix->frames;
+        vis->track_start = 0;
+        vis->track_frames_per_pixel = (double)mix->frames / MAX(width, 1);
+    }
+    clamp_track_view(vis, width);
+    return vis->track_tiles != NULL;
+}
+
+static gboolean ensure_track_surface(Visualizer* vis, int width, int height) {
+    cairo_surface_t* surface = vis->track_surface;
+    if (surface && cairo_image_surface_get_width(surface) == width &&
+        cairo_image_surface_get_height(surface) == height) {
+        return TRUE;
+    }
+    
+    if (surface) cairo_surface_destroy(surface);
+    vis->track_surface = NULL;
+    if (width <= 0 || height <= 0) return FALSE;
+    
+    surface = cairo_image_surface_create(CAIRO_FORMAT_RGB24, width, height);
+    if (cairo_surface_status(surface) != CAIRO_STATUS_SUCCESS) {
+        cairo_surface_destroy(surface);
+        return FALSE;
+    }
+    vis->track_surface = surface;
+    return TRUE;
+}
+
+// Finest level with no more than one column per pixel
+static int track_level(double frames_per_pixel) {
+    int level = 0;
+    while (level + 1 < SPECTRAL_TILES_LEVELS && spectral_tiles_hop(level + 1) <= frames_per_pixel) {
+        level++;
+    }
+    return level;
+}
+
+// Colour indices of the column covering `frame` at `level`, asking for its
+// tile if need be, else of the nearest coarser column already made; NULL if
+// there is none yet
+static const guint8* track_column(SpectralTiles* tiles, int level, size_t frame) {
+    for (int l = level; l < SPECTRAL_TILES_LEVELS; l++) {
+        size_t column = frame / spectral_tiles_hop(l);
+        const guint8* tile = spectral_tiles_get(tiles, l, column / SPECTRAL_TILE_COLUMNS, l == level);
+        if (tile) return tile + (column % SPECTRAL_TILE_COLUMNS) * SPECTRUM_BINS;
+    }
+    return NULL;
+}
+
+static void draw_track_spectrogram(Visualizer* vis, cairo_t* cr, int width, int height) {
+    if (!ensure_track_tiles(vis, width) || !ensure_track_surface(vis, width, height)) {
+        cairo_set_source_rgb(cr, 0.1, 0.1, 0.1);
+        cairo_paint(cr);
+        return;
+    }
+    
+    cairo_surface_t* surface = vis->track_surface;
+    unsigned char* pixels = cairo_image_surface_get_data(surface);
+    int stride = cairo_image_surface_get_stride(surface);
+    const uint32_t* lut = color_lut(vis->color_scheme);
+    const uint32_t background = pack_pixel(0.1, 0.1, 0.1);
+    int bins = MIN(SPECTRUM_BINS, height);
+    int level = track_level(vis->track_frames_per_pixel);
+    
+    // Bins from the bottom up, as in the live view
+    spectral_tiles_begin_frame(vis->track_tiles);
+    cairo_surface_flush(surface);
+    for (int x = 0; x < width; x++) {
+        size_t frame = (size_t)(vis->track_start + (x + 0.5) * vis->track_frames_per_pixel);
+        const guint8* levels = frame < vis->track_frames ? track_column(vis->track_tiles, level, frame) : NULL;
+        unsigned char* pixel = pixels + (size_t)(height - 1) * stride + (size_t)x * sizeof(uint32_t);
+        for (int y = 0; y < height; y++) {
+            *(uint32_t*)pixel = levels && y < bins ? lut[levels[y]] : background;
+            pixel -= stride;
+        }
+    }
+    cairo_surface_mark_dirty(surface);
+    cairo_set_source_surface(cr, surface, 0, 0);
+    cairo_paint(cr);
+    
+    // Playback position
+    double position = (double)(vis->player->ring_buffer_pos % vis->track_frames);
+    double x = (position - vis->track_start) / vis->track_frames_per_pixel;
+    if (x >= 0 && x < width) {
+        set_pen_color(cr, vis->color_scheme);
+        cairo_set_line_width(cr, 1.0);
+        cairo_move_to(cr, floor(x) + 0.5, 0);
+        cairo_line_to(cr, floor(x) + 0.5, height);
+        cairo_stroke(cr);
+    }
+}
+
 gboolean draw_spectrogram(GtkWidget* widget, cairo_t* cr, gpointer data) {
     Visualizer* vis = (Visualizer*)data;
     int width = gtk_widget_get_allocated_width(widget);
@@ -314,61 +564,44 @@ gboolean draw_spectrogram(GtkWidget* widget, cairo_t* cr, gpointer data) {
         vis->draw_surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, width, height);
     }
     
-    // Draw spectrogram
-    // Clear background
-    cairo_set_source_rgb(cr, 0.1, 0.1, 0.1);
-    cairo_paint(cr);
-    
-    // Prepare FFT data
-    size_t num_samples = vis->player->active_mix->buffer_size / sizeof(int16_t);
-    size_t start_idx = (vis->player->ring_buffer_pos + num_samples - FFT_SIZE) % num_samples;
-    
-    for (int i = 0; i < FFT_SIZE; i++) {
-        size_t idx = (start_idx + i) % num_samples;
-        fft_context->input[i] = vis->player->active_mix->buffer[idx] / 32768.0;
+    if (vis->track_view) {
+        draw_track_spectrogram(vis, cr, width, height);
+        return FALSE;
     }
     
-    // Use a sliding window for the spectrogram
-    static float* history = NULL;
-    static int history_pos = 0;
-    static const int HISTORY_WIDTH = 512;
-    
-    if (!history) {
-        history = calloc(HISTORY_WIDTH * FFT_SIZE, sizeof(float));
+    if (!vis->analyzer || !ensure_spectrogram_ring(vis, width, height)) {
+        cairo_set_source_rgb(cr, 0.1, 0.1, 0.1);
+        cairo_paint(cr);
+        return FALSE;
     }
     
-    // Perform FFT
-    fftw_execute(fft_context->plan);
-    
-    // Store current FFT results in history
-    int fft_height = FFT_SIZE / 4;  // Only show quarter of the spectrum
-    if (fft_height > height) fft_height = height;
-    
-    for (int y = 0; y < fft_height; y++) {
-        double magnitude = sqrt(
-            fft_context->output[y][0] * fft_context->output[y][0] +
-            fft_context->output[y][1] * fft_context->output[y][1]
-        ) / FFT_SIZE;
-        history[history_pos * fft_height + y] = magnitude;
+    // Paint just the columns analysed since the last frame, unless
+    // everything needs it. A backlog wider than the widget would only be
+    // painted over, so at most a widget's worth is taken.
+    cairo_surface_t* surface = vis->spectrogram_surface;
+    const uint32_t* lut = color_lut(vis->color_scheme);
+    SpectrumColumn spectrum;
+    cairo_surface_flush(surface);
+    for (int painted = 0; painted < width && spectrum_analyzer_pop(vis->analyzer, &spectrum); painted++) {
+        int column = push_spectrogram_column(vis, &spectrum, lut);
+        cairo_surface_mark_dirty_rectangle(surface, column, 0, 1, height);
     }
-    
-    // Draw spectrogram from history
-    for (int y = 0; y < fft_height; y++) {
-        for (int x = 0; x < width; x++) {
-            int hist_idx = ((history_pos - x + HISTORY_WIDTH) % HISTORY_WIDTH);
-            float magnitude = history[hist_idx * fft_height + y];
-            
-            // Convert magnitude to color (green intensity)
-            double intensity = fmin(1.0, magnitude * 5.0);
-            set_color_by_intensity(cr, intensity, vis->color_scheme);
-            
-            // Draw point
-            cairo_rectangle(cr, x, height - y, 1, 1);
-            cairo_fill(cr);
-        }
+    if (vis->spectrogram_scheme != vis->color_scheme) {
+        repaint_spectrogram(vis, lut);
+        vis->spectrogram_scheme = vis->color_scheme;
+        cairo_surface_mark_dirty(surface);
     }
     
-    history_pos = (history_pos + 1) % HISTORY_WIDTH;
+    // Newest column first: [head, width) then [0, head)
+    int head = vis->spectrogram_head;
+    cairo_set_source_surface(cr, surface, -head, 0);
+    cairo_rectangle(cr, 0, 0, width - head, height);
+    cairo_fill(cr);
+    if (head > 0) {
+        cairo_set_source_surface(cr, surface, width - head, 0);
+        cairo_rectangle(cr, width - head, 0, head, height);
+        cairo_fill(cr);
+    }
     
     // Draw edge visualization if it exists
     if (vis->edge_surface) {
@@ -392,23 +625,23 @@ gboolean on_waveform_click(GtkWidget* widget, GdkEventButton* event, gpointer da
     int width = gtk_widget_get_allocated_width(widget);
     
     // Apply random effect based on click position
-    switch (rand() % 4) {
+    history_record(vis->player);
+    switch (rng_below(rng_thread(), 4)) {
         case 0:
-            bit_mash(vis->player, vis->player->active_mix, event->x / width);
+            effect_chain_add(vis->player->effects, EFFECT_BIT_MASH, event->x / width, 0.0f);
             break;
         case 1:
-            bit_drop(vis->player, vis->player->active_mix, event->x / width * 0.5f);
+            effect_chain_add(vis->player->effects, EFFECT_BIT_DROP, event->x / width * 0.5f, 0.0f);
             break;
         case 2: {
             float tempo = 0.5f + (event->x / width) * 1.5f;
-            tempo_shift(vis->player, vis->player->active_mix, tempo);
+            effect_chain_add(vis->player->effects, EFFECT_TEMPO, tempo, 0.0f);
             break;
         }
         case 3:
-            add_robot(vis->player, vis->player->active_mix, 1.0f + (event->x / width) * 10.0f);
+            effect_chain_add(vis->player->effects, EFFECT_ROBOT, 1.0f + (event->x / width) * 10.0f, 0.0f);
             break;
     }
-    mix_audio_files(vis->player);
     
     return TRUE;
 }
@@ -428,6 +661,10 @@ gboolean on_spectrogram_draw_end(GtkWidget* widget G_GNUC_UNUSED,
                                 GdkEventButton* event G_GNUC_UNUSED, 
                                 gpointer data) {
     Visualizer* vis = (Visualizer*)data;
+    if (vis->panning) {
+        vis->panning = FALSE;
+        return TRUE;
+    }
     vis->drawing = FALSE;
     
     // Detect and apply shape effect
@@ -438,6 +675,12 @@ gboolean on_spectrogram_draw_end(GtkWidget* widget G_GNUC_UNUSED,
 
 gboolean on_spectrogram_draw_start(GtkWidget* widget, GdkEventButton* event, gpointer data) {
     Visualizer* vis = (Visualizer*)data;
+    if (vis->track_view) {
+        // Dragging pans the whole-track view instead of drawing
+        vis->panning = TRUE;
+        vis->pan_x = event->x;
+        return TRUE;
+    }
     vis->drawing = TRUE;
     vis->last_x = event->x;
     vis->last_y = event->y;
@@ -464,6 +707,13 @@ gboolean on_spectrogram_draw_start(GtkWidget* widget, GdkEventButton* event, gpo
 
 gboolean on_spectrogram_draw_motion(GtkWidget* widget, GdkEventMotion* event, gpointer data) {
     Visualizer* vis = (Visualizer*)data;
+    if (vis->panning) {
+        vis->track_start -= (event->x - vis->pan_x) * vis->track_frames_per_pixel;
+        vis->pan_x = event->x;
+        clamp_track_view(vis, gtk_widget_get_allocated_width(widget));
+        gtk_widget_queue_draw(widget);
+        return TRUE;
+    }
     if (!vis->drawing) return FALSE;
     
     // Update last input time
@@ -523,6 +773,47 @@ gboolean on_spectrogram_draw_motion(GtkWidget* widget, GdkEventMotion* event, gp
     return TRUE;
 }
 
+// Scrolling zooms the whole-track view about the pointer
+gboolean on_spectrogram_scroll(GtkWidget* widget, GdkEventScroll* event, gpointer data) {
+    Visualizer* vis = (Visualizer*)data;
+    if (!vis->track_view || vis->track_frames == 0) return FALSE;
+    
+    double zoom;
+    if (event->direction == GDK_SCROLL_UP) {
+        zoom = 1.0 / TRACK_ZOOM_STEP;
+    } else if (event->direction == GDK_SCROLL_DOWN) {
+        zoom = TRACK_ZOOM_STEP;
+    } else {
+        return FALSE;
+    }
+    
+    int width = gtk_widget_get_allocated_width(widget);
+    double anchor = vis->track_start + event->x * vis->track_frames_per_pixel;
+    vis->track_frames_per_pixel *= zoom;
+    clamp_track_view(vis, width);
+    vis->track_start = anchor - event->x * vis->track_frames_per_pixel;
+    clamp_track_view(vis, width);
+    gtk_widget_queue_draw(widget);
+    return TRUE;
+}
+
+void on_track_view_toggled(GtkToggleButton* button, gpointer data) {
+    Visualizer* vis = (Visualizer*)data;
+    vis->track_view = gtk_toggle_button_get_active(button);
+    vis->drawing = FALSE;
+    vis->panning = FALSE;
+    if (vis->track_view) {
+        // Start from the whole track
+        vis->track_frames = 0;
+    } else {
+        // The tiles hold a snapshot of the mix, which makes edits copy
+        // every chunk they touch, so don't keep them around unseen
+        spectral_tiles_free(vis->track_tiles);
+        vis->track_tiles = NULL;
+    }
+    gtk_widget_queue_draw(vis->spectrogram_drawing_area);
+}
+
 gboolean on_key_press(GtkWidget* widget G_GNUC_UNUSED, 
                      GdkEventKey* event, 
                      gpointer data) {
@@ -674,8 +965,9 @@ void detect_and_apply_shape(Visualizer* vis) {
     printf("- Bit mash intensity: %.2f\n", intensity);
     printf("- Pitch shift amount: %.1f semitones\n", pitch);
     
-    bit_mash(vis->player, vis->player->active_mix, intensity);
-    pitch_shift(vis->player, vis->player->active_mix, pitch);
+    history_record(vis->player);
+    effect_chain_add(vis->player->effects, EFFECT_BIT_MASH, intensity, 0.0f);
+    effect_chain_add(vis->player->effects, EFFECT_PITCH, pitch, 0.0f);
 }
 
 // Add this function to process effects after delay
@@ -14,6 +14,8 @@ void cycle_color_scheme(Visualizer* vis);
 gboolean on_spectrogram_draw_start(GtkWidget* widget, GdkEventButton* event, gpointer data);
 gboolean on_spectrogram_draw_end(GtkWidget* widget, GdkEventButton* event, gpointer data);
 gboolean on_spectrogram_draw_motion(GtkWidget* widget, GdkEventMotion* event, gpointer data);
+gboolean on_spectrogram_scroll(GtkWidget* widget, GdkEventScroll* event, gpointer data);
+void on_track_view_toggled(GtkToggleButton* button, gpointer data);
 gboolean on_waveform_click(GtkWidget* widget, GdkEventButton* event, gpointer data);
 gboolean on_spectrogram_click(GtkWidget* widget, GdkEventButton* event, gpointer data);
 gboolean on_key_press(GtkWidget* widget, GdkEventKey* event, gpointer data);
@@ -3,6 +3,8 @@
 
 #include <gtk/gtk.h>
 #include "types.h"
+#include "spectrum_analyzer.h"
+#include "spectral_tiles.h"
 
 typedef struct {
     GtkWidget* waveform_drawing_area;
@@ -15,6 +17,26 @@ typedef struct {
     gdouble last_time;
     cairo_surface_t* draw_surface;
     cairo_surface_t* edge_surface;
+    
+    // Spectrogram: columns from the analyzer, kept in a ring of pixel
+    // columns, see draw_spectrogram()
+    SpectrumAnalyzer* analyzer;
+    cairo_surface_t* spectrogram_surface;  // RGB24, written directly
+    guint8* spectrogram_levels;   // Colour index per column and bin, for repainting
+    int spectrogram_bins;         // Rows showing the spectrum, from the bottom
+    int spectrogram_head;         // Column holding the newest FFT
+    int spectrogram_scheme;       // Scheme the surface is painted in, -1 for none
+    
+    // Whole-track spectrogram, shown instead of the live one when on; see
+    // draw_track_spectrogram()
+    gboolean track_view;
+    SpectralTiles* track_tiles;   // For the mix being shown, made on demand
+    cairo_surface_t* track_surface;  // RGB24, repainted every frame
+    size_t track_frames;          // Length of the mix the view was fitted to
+    double track_start;           // Mix frame at the left edge
+    double track_frames_per_pixel;
+    gboolean panning;             // Dragging the track view
+    gdouble pan_x;
     gboolean erase_mode;
     GArray* stroke_points;
     
@@ -0,0 +1,251 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "wavfile.h"
+
+#define WAV_HEADER_MAX_BYTES 58     // RIFF, an 18-byte fmt chunk, fact and the data chunk header
+
+// Open mappings, so reloading a file shares its pages instead of mapping again
+static GList* open_files = NULL;
+G_LOCK_DEFINE_STATIC(open_files);
+
+static uint16_t read_u16(const uint8_t* p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t read_u32(const uint8_t* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void write_u16(uint8_t* p, uint16_t value) {
+    p[0] = value & 0xFF;
+    p[1] = value >> 8;
+}
+
+static void write_u32(uint8_t* p, uint32_t value) {
+    write_u16(p, value & 0xFFFF);
+    write_u16(p + 2, value >> 16);
+}
+
+static gint64 stat_mtime_ns(const struct stat* st) {
+#ifdef __APPLE__
+    return (gint64)st->st_mtimespec.tv_sec * 1000000000 + st->st_mtimespec.tv_nsec;
+#else
+    return (gint64)st->st_mtim.tv_sec * 1000000000 + st->st_mtim.tv_nsec;
+#endif
+}
+
+static gboolean parse_fmt(WavFile* wav, const uint8_t* p, uint32_t size) {
+    if (size < 16) return FALSE;
+
+    wav->format = read_u16(p);
+    wav->channels = read_u16(p + 2);
+    wav->sample_rate = read_u32(p + 4);
+    wav->block_align = read_u16(p + 12);
+    wav->bits_per_sample = read_u16(p + 14);
+    wav->valid_bits = wav->bits_per_sample;
+
+    // WAVE_FORMAT_EXTENSIBLE: the real format is the first two bytes of the GUID
+    if (wav->format == WAV_FORMAT_EXTENSIBLE) {
+        if (size < 40) return FALSE;
+        uint16_t valid = read_u16(p + 18);
+        if (valid > 0 && valid <= wav->bits_per_sample) wav->valid_bits = valid;
+        wav->channel_mask = read_u32(p + 20);
+        wav->format = read_u16(p + 24);
+    }
+
+    // A zero block_align would be divided by when trimming the data chunk
+    return wav->channels > 0 && wav->sample_rate > 0 &&
+           wav->bits_per_sample > 0 && wav->block_align > 0 &&
+           wav->block_align >= wav->channels * ((wav->bits_per_sample + 7) / 8);
+}
+
+// Walk the RIFF chunk list for "fmt " and "data", skipping LIST, fact, bext,
+// cue and anything else. Chunks are padded to even sizes.
+static gboolean parse_chunks(WavFile* wav) {
+    const uint8_t* p = wav->map;
+    size_t size = wav->map_size;
+
+    if (size < 12 || memcmp(p, "RIFF", 4) != 0 || memcmp(p + 8, "WAVE", 4) != 0) {
+        return FALSE;
+    }
+
+    // Trust the file size over the RIFF size; streaming writers often leave it wrong
+    size_t end = size;
+    size_t offset = 12;
+    gboolean have_fmt = FALSE;
+    const uint8_t* data = NULL;
+    size_t data_size = 0;
+
+    while (offset + 8 <= end && !(have_fmt && data)) {
+        const uint8_t* id = p + offset;
+        size_t chunk_size = read_u32(p + offset + 4);
+        size_t body = offset + 8;
+        size_t available = end - body;
+
+        if (memcmp(id, "fmt ", 4) == 0) {
+            if (chunk_size > available || !parse_fmt(wav, p + body, (uint32_t)chunk_size)) {
+                return FALSE;
+            }
+            have_fmt = TRUE;
+        } else if (memcmp(id, "data", 4) == 0) {
+            // Truncated or unfinalised (0 / 0xFFFFFFFF) data runs to the end of the file
+            if (chunk_size == 0 || chunk_size > available) chunk_size = available;
+            data = p + body;
+            data_size = chunk_size;
+        }
+
+        if (chunk_size > available) break;
+        offset = body + chunk_size + (chunk_size & 1);
+    }
+
+    if (!have_fmt || !data) return FALSE;
+
+    wav->data = data;
+    wav->data_bytes = data_size - data_size % wav->block_align;
+    return TRUE;
+}
+
+static WavFile* find_open_file(const struct stat* st) {
+    for (GList* l = open_files; l != NULL; l = l->next) {
+        WavFile* wav = (WavFile*)l->data;
+        if (wav->dev == st->st_dev && wav->ino == st->st_ino &&
+            wav->map_size == (size_t)st->st_size && wav->mtime_ns == stat_mtime_ns(st)) {
+            return wav;
+        }
+    }
+    return NULL;
+}
+
+WavFile* wav_file_open(const char* path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return NULL;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+        close(fd);
+        return NULL;
+    }
+
+    G_LOCK(open_files);
+
+    WavFile* wav = find_open_file(&st);
+    if (wav) {
+        wav->refcount++;
+        G_UNLOCK(open_files);
+        close(fd);
+        return wav;
+    }
+
+    wav = calloc(1, sizeof(WavFile));
+    if (!wav) {
+        G_UNLOCK(open_files);
+        close(fd);
+        return NULL;
+    }
+
+    void* map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        G_UNLOCK(open_files);
+        fprintf(stderr, "Could not map %s\n", path);
+        free(wav);
+        return NULL;
+    }
+
+    wav->map = map;
+    wav->map_size = (size_t)st.st_size;
+    wav->dev = st.st_dev;
+    wav->ino = st.st_ino;
+    wav->mtime_ns = stat_mtime_ns(&st);
+
+    if (!parse_chunks(wav)) {
+        G_UNLOCK(open_files);
+        fprintf(stderr, "Not a usable RIFF/WAVE file: %s\n", path);
+        munmap(map, wav->map_size);
+        free(wav);
+        return NULL;
+    }
+
+    // Sample data is read front to back; let the kernel read ahead
+    posix_madvise(map, wav->map_size, POSIX_MADV_SEQUENTIAL);
+
+    wav->path = strdup(path);
+    wav->refcount = 1;
+    open_files = g_list_prepend(open_files, wav);
+
+    G_UNLOCK(open_files);
+    return wav;
+}
+
+WavFile* wav_file_ref(WavFile* wav) {
+    if (!wav) return NULL;
+    G_LOCK(open_files);
+    wav->refcount++;
+    G_UNLOCK(open_files);
+    return wav;
+}
+
+void wav_file_unref(WavFile* wav) {
+    if (!wav) return;
+
+    G_LOCK(open_files);
+    gboolean last = --wav->refcount == 0;
+    if (last) open_files = g_list_remove(open_files, wav);
+    G_UNLOCK(open_files);
+
+    if (!last) return;
+
+    munmap((void*)wav->map, wav->map_size);
+    free(wav->path);
+    free(wav);
+}
+
+// Anything but PCM takes the 18-byte fmt chunk (cbSize = 0) and a fact
+// chunk with the frame count, as the spec asks of non-PCM formats
+static size_t header_bytes(uint16_t format) {
+    return format == WAV_FORMAT_PCM ? 44 : WAV_HEADER_MAX_BYTES;
+}
+
+uint32_t wav_max_data_bytes(uint16_t format, uint16_t block_align) {
+    // The RIFF size counts everything after its own 8 bytes
+    uint32_t max = UINT32_MAX - (uint32_t)(header_bytes(format) - 8);
+    return block_align ? max - max % block_align : 0;
+}
+
+gboolean wav_write_header(FILE* file, uint16_t format, uint16_t channels, uint32_t sample_rate,
+                          uint16_t bits_per_sample, uint32_t data_bytes) {
+    uint8_t header[WAV_HEADER_MAX_BYTES];
+    size_t size = header_bytes(format);
+    gboolean pcm = format == WAV_FORMAT_PCM;
+    uint16_t block_align = channels * (bits_per_sample / 8);
+
+    memcpy(header, "RIFF", 4);
+    write_u32(header + 4, (uint32_t)(size - 8) + data_bytes);
+    memcpy(header + 8, "WAVE", 4);
+    memcpy(header + 12, "fmt ", 4);
+    write_u32(header + 16, pcm ? 16 : 18);
+    write_u16(header + 20, format);
+    write_u16(header + 22, channels);
+    write_u32(header + 24, sample_rate);
+    write_u32(header + 28, sample_rate * block_align);
+    write_u16(header + 32, block_align);
+    write_u16(header + 34, bits_per_sample);
+
+    uint8_t* p = header + 36;
+    if (!pcm) {
+        write_u16(p, 0);                // cbSize: no extension
+        memcpy(p + 2, "fact", 4);
+        write_u32(p + 6, 4);
+        write_u32(p + 10, block_align ? data_bytes / block_align : 0);
+        p += 14;
+    }
+    memcpy(p, "data", 4);
+    write_u32(p + 4, data_bytes);
+
+    return fwrite(header, size, 1, file) == 1;
+}
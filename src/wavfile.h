@@ -0,0 +1,50 @@
+#ifndef WAVFILE_H
+#define WAVFILE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/types.h>
+#include <glib.h>
+
+#define WAV_FORMAT_PCM 0x0001
+#define WAV_FORMAT_IEEE_FLOAT 0x0003
+#define WAV_FORMAT_EXTENSIBLE 0xFFFE
+
+// A RIFF/WAVE file mapped read-only into memory. The sample data is used in
+// place, and opening the same file again (same device, inode, size and
+// mtime) returns the existing mapping with its refcount bumped.
+typedef struct WavFile {
+    char* path;
+    const uint8_t* map;         // Whole file
+    size_t map_size;
+    const void* data;           // Start of the "data" chunk inside map
+    size_t data_bytes;          // Whole frames only
+    uint16_t format;            // PCM or IEEE float, EXTENSIBLE resolved to its subformat
+    uint16_t channels;
+    uint32_t sample_rate;
+    uint16_t block_align;       // Bytes per frame
+    uint16_t bits_per_sample;   // Container size
+    uint16_t valid_bits;        // Significant bits, <= bits_per_sample
+    uint32_t channel_mask;      // Speaker positions, 0 if not given
+    gint refcount;
+    dev_t dev;
+    ino_t ino;
+    gint64 mtime_ns;
+} WavFile;
+
+WavFile* wav_file_open(const char* path);
+WavFile* wav_file_ref(WavFile* wav);
+void wav_file_unref(WavFile* wav);
+
+// Writing: a canonical header for data_bytes of interleaved samples, at the
+// file's current position; float files get the longer fmt chunk and a fact
+// chunk. Streaming writers write it once with a placeholder size and again
+// at offset 0 when done.
+gboolean wav_write_header(FILE* file, uint16_t format, uint16_t channels, uint32_t sample_rate,
+                          uint16_t bits_per_sample, uint32_t data_bytes);
+// The RIFF sizes are 32-bit, so this is all the sample data a file can hold,
+// in whole frames
+uint32_t wav_max_data_bytes(uint16_t format, uint16_t block_align);
+
+#endif